@@ -36,27 +36,27 @@ TriMesh::~TriMesh()
 
 }
 
-std::vector<glm::vec3> TriMesh::getVertexPositions()
+const std::vector<glm::vec3>& TriMesh::getVertexPositions() const
 {
 	return vertex_positions;
 }
 
-std::vector<glm::vec3> TriMesh::getVertexColors()
+const std::vector<glm::vec3>& TriMesh::getVertexColors() const
 {
 	return vertex_colors;
 }
 
-std::vector<vec3i> TriMesh::getFaces()
+const std::vector<vec3i>& TriMesh::getFaces() const
 {
 	return faces;
 }
 
-std::vector<glm::vec3> TriMesh::getPoints()
+const std::vector<glm::vec3>& TriMesh::getPoints() const
 {
 	return points;
 }
 
-std::vector<glm::vec3> TriMesh::getColors()
+const std::vector<glm::vec3>& TriMesh::getColors() const
 {
 	return colors;
 }
@@ -22,11 +22,11 @@ public:
 	TriMesh();
 	~TriMesh();
 
-	std::vector<glm::vec3> getVertexPositions();
-	std::vector<glm::vec3> getVertexColors();
-	std::vector<vec3i> getFaces();
-	std::vector<glm::vec3> getPoints();
-	std::vector<glm::vec3> getColors();
+	const std::vector<glm::vec3>& getVertexPositions() const;
+	const std::vector<glm::vec3>& getVertexColors() const;
+	const std::vector<vec3i>& getFaces() const;
+	const std::vector<glm::vec3>& getPoints() const;
+	const std::vector<glm::vec3>& getColors() const;
 
 	// 这里添加各种形状的、模型的读取顶点的函数
 	void generateCube();
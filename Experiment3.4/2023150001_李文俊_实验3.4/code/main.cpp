@@ -35,6 +35,17 @@ struct openGLObject
 
 	// 阴影变量
 	GLuint shadowLocation;
+
+	// 光照、材质变量，绑定着色器时查询一次，绘制时不再按名字查找
+	GLuint eyePositionLocation;
+	GLuint materialAmbientLocation;
+	GLuint materialDiffuseLocation;
+	GLuint materialSpecularLocation;
+	GLuint materialShininessLocation;
+	GLuint lightAmbientLocation;
+	GLuint lightDiffuseLocation;
+	GLuint lightSpecularLocation;
+	GLuint lightPositionLocation;
 	// 环境光反射、漫反射、镜面反射 控制变量
 	GLuint ambientOpen;
 	GLuint DiffuseOpen;
@@ -103,6 +114,16 @@ void bindObjectAndData(TriMesh *mesh, openGLObject &object, const std::string &v
 
 	object.shadowLocation = glGetUniformLocation(object.program, "isShadow");
 
+	object.eyePositionLocation = glGetUniformLocation(object.program, "eye_position");
+	object.materialAmbientLocation = glGetUniformLocation(object.program, "material.ambient");
+	object.materialDiffuseLocation = glGetUniformLocation(object.program, "material.diffuse");
+	object.materialSpecularLocation = glGetUniformLocation(object.program, "material.specular");
+	object.materialShininessLocation = glGetUniformLocation(object.program, "material.shininess");
+	object.lightAmbientLocation = glGetUniformLocation(object.program, "light.ambient");
+	object.lightDiffuseLocation = glGetUniformLocation(object.program, "light.diffuse");
+	object.lightSpecularLocation = glGetUniformLocation(object.program, "light.specular");
+	object.lightPositionLocation = glGetUniformLocation(object.program, "light.position");
+
 	object.ambientOpen = glGetUniformLocation(object.program, "ambientOpen");
 	object.DiffuseOpen = glGetUniformLocation(object.program, "DiffuseOpen");
 	object.SpecularOpen = glGetUniformLocation(object.program, "SpecularOpen");
@@ -112,17 +133,17 @@ void bindLightAndMaterial(TriMesh *mesh, openGLObject &object, Light *light, Cam
 {
 
 	// 传递相机的位置
-	glUniform3fv(glGetUniformLocation(object.program, "eye_position"), 1, &camera->eye[0]);
+	glUniform3fv(object.eyePositionLocation, 1, &camera->eye[0]);
 
 	// 传递物体的材质
 	glm::vec4 meshAmbient = mesh->getAmbient();
 	glm::vec4 meshDiffuse = mesh->getDiffuse();
 	glm::vec4 meshSpecular = mesh->getSpecular();
 	float meshShininess = mesh->getShininess();
-	glUniform4fv(glGetUniformLocation(object.program, "material.ambient"), 1, &meshAmbient[0]);
-	glUniform4fv(glGetUniformLocation(object.program, "material.diffuse"), 1, &meshDiffuse[0]);
-	glUniform4fv(glGetUniformLocation(object.program, "material.specular"), 1, &meshSpecular[0]);
-	glUniform1f(glGetUniformLocation(object.program, "material.shininess"), meshShininess);
+	glUniform4fv(object.materialAmbientLocation, 1, &meshAmbient[0]);
+	glUniform4fv(object.materialDiffuseLocation, 1, &meshDiffuse[0]);
+	glUniform4fv(object.materialSpecularLocation, 1, &meshSpecular[0]);
+	glUniform1f(object.materialShininessLocation, meshShininess);
 
 	// 传递光源信息
 	glm::vec4 lightAmbient = light->getAmbient();
@@ -130,10 +151,10 @@ void bindLightAndMaterial(TriMesh *mesh, openGLObject &object, Light *light, Cam
 	glm::vec4 lightSpecular = light->getSpecular();
 	glm::vec3 lightPosition = light->getTranslation();
 
-	glUniform4fv(glGetUniformLocation(object.program, "light.ambient"), 1, &lightAmbient[0]);
-	glUniform4fv(glGetUniformLocation(object.program, "light.diffuse"), 1, &lightDiffuse[0]);
-	glUniform4fv(glGetUniformLocation(object.program, "light.specular"), 1, &lightSpecular[0]);
-	glUniform3fv(glGetUniformLocation(object.program, "light.position"), 1, &lightPosition[0]);
+	glUniform4fv(object.lightAmbientLocation, 1, &lightAmbient[0]);
+	glUniform4fv(object.lightDiffuseLocation, 1, &lightDiffuse[0]);
+	glUniform4fv(object.lightSpecularLocation, 1, &lightSpecular[0]);
+	glUniform3fv(object.lightPositionLocation, 1, &lightPosition[0]);
 }
 
 void mouse_button_callback(GLFWwindow *window, int button, int action, int mods)
@@ -22,13 +22,13 @@ public:
 	TriMesh();
 	~TriMesh();
 
-	std::vector<glm::vec3> getVertexPositions();
-	std::vector<glm::vec3> getVertexColors();
-	std::vector<glm::vec3> getVertexNormals();
-	std::vector<vec3i> getFaces();
-	std::vector<glm::vec3> getPoints();
-	std::vector<glm::vec3> getColors();
-	std::vector<glm::vec3> getNormals();
+	const std::vector<glm::vec3>& getVertexPositions() const;
+	const std::vector<glm::vec3>& getVertexColors() const;
+	const std::vector<glm::vec3>& getVertexNormals() const;
+	const std::vector<vec3i>& getFaces() const;
+	const std::vector<glm::vec3>& getPoints() const;
+	const std::vector<glm::vec3>& getColors() const;
+	const std::vector<glm::vec3>& getNormals() const;
 
 	void computeTriangleNormals();
 	void computeVertexNormals();
@@ -6,17 +6,17 @@
 MeshPainter::MeshPainter(){};
 MeshPainter::~MeshPainter(){};
 
-std::vector<std::string> MeshPainter::getMeshNames(){ return mesh_names;};
-std::vector<TriMesh *> MeshPainter::getMeshes(){ return meshes;};
-std::vector<openGLObject> MeshPainter::getOpenGLObj(){ return opengl_objects;};
+const std::vector<std::string>& MeshPainter::getMeshNames() const { return mesh_names;};
+const std::vector<TriMesh *>& MeshPainter::getMeshes() const { return meshes;};
+const std::vector<openGLObject>& MeshPainter::getOpenGLObj() const { return opengl_objects;};
 
 void MeshPainter::bindObjectAndData(TriMesh *mesh, openGLObject &object, const std::string &texture_image, const std::string &vshader, const std::string &fshader){
     // 初始化各种对象
 
-    std::vector<glm::vec3> points = mesh->getPoints();
-    std::vector<glm::vec3> normals = mesh->getNormals();
-    std::vector<glm::vec3> colors = mesh->getColors();
-    std::vector<glm::vec2> textures = mesh->getTextures();
+    const std::vector<glm::vec3>& points = mesh->getPoints();
+    const std::vector<glm::vec3>& normals = mesh->getNormals();
+    const std::vector<glm::vec3>& colors = mesh->getColors();
+    const std::vector<glm::vec2>& textures = mesh->getTextures();
 
 	// 创建顶点数组对象
 	glGenVertexArrays(1, &object.vao);  	// 分配1个顶点数组对象
@@ -48,47 +48,47 @@ TriMesh::~TriMesh()
 {
 }
 
-std::vector<glm::vec3> TriMesh::getVertexPositions()
+const std::vector<glm::vec3>& TriMesh::getVertexPositions() const
 {
 	return vertex_positions;
 }
 
-std::vector<glm::vec3> TriMesh::getVertexColors()
+const std::vector<glm::vec3>& TriMesh::getVertexColors() const
 {
 	return vertex_colors;
 }
 
-std::vector<glm::vec3> TriMesh::getVertexNormals()
+const std::vector<glm::vec3>& TriMesh::getVertexNormals() const
 {
 	return vertex_normals;
 }
 
-std::vector<glm::vec2> TriMesh::getVertexTextures()
+const std::vector<glm::vec2>& TriMesh::getVertexTextures() const
 {
 	return vertex_textures;
 }
 
-std::vector<vec3i> TriMesh::getFaces()
+const std::vector<vec3i>& TriMesh::getFaces() const
 {
 	return faces;
 }
 
-std::vector<glm::vec3> TriMesh::getPoints()
+const std::vector<glm::vec3>& TriMesh::getPoints() const
 {
 	return points;
 }
 
-std::vector<glm::vec3> TriMesh::getColors()
+const std::vector<glm::vec3>& TriMesh::getColors() const
 {
 	return colors;
 }
 
-std::vector<glm::vec3> TriMesh::getNormals()
+const std::vector<glm::vec3>& TriMesh::getNormals() const
 {
 	return normals;
 }
 
-std::vector<glm::vec2> TriMesh::getTextures()
+const std::vector<glm::vec2>& TriMesh::getTextures() const
 {
 	return textures;
 }
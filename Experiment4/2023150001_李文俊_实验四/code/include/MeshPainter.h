@@ -48,10 +48,10 @@ public:
     MeshPainter();
     ~MeshPainter();
 
-    std::vector<std::string> getMeshNames();
+    const std::vector<std::string>& getMeshNames() const;
 
-    std::vector<TriMesh *> getMeshes();
-    std::vector<openGLObject> getOpenGLObj();
+    const std::vector<TriMesh *>& getMeshes() const;
+    const std::vector<openGLObject>& getOpenGLObj() const;
 
 	// 读取纹理文件
     void load_texture_STBImage(const std::string &file_name, GLuint& texture);
@@ -16,6 +16,7 @@
 
 #include <cmath>
 #include <iostream>
+#include <string>
 
 //  Define M_PI in the case it's not defined in the math header file
 #ifndef M_PI
@@ -51,10 +52,29 @@
 
 namespace Angel {
 
-//  Helper function to load vertex and fragment shader files
+//  Helper function to load vertex and fragment shader files.
+//    Returns 0 if a file cannot be read or the program fails to build.
 GLuint InitShader( const char* vertexShaderFile,
 		   const char* fragmentShaderFile );
 
+//  Build a program from shader source text; vertexName and fragmentName
+//    are only used in error messages.  retrievableBinary asks the driver
+//    to keep the linked binary so it can be read with glGetProgramBinary.
+GLuint InitShaderSource( const char* vertexSource,
+			 const char* fragmentSource,
+			 const char* vertexName,
+			 const char* fragmentName,
+			 bool retrievableBinary = false );
+
+//  Read a shader file and expand  #include "file"  lines, which are
+//    resolved relative to the including file.
+bool ReadShaderSource( const char* shaderFile, std::string& source );
+
+//  Turn the loading statistics (mesh parse/cache times, index compression,
+//    shader build times) on or off.  Off by default; errors always print.
+void SetVerbose( bool verbose );
+bool Verbose();
+
 //  Defined constant for when numbers are too small to be used in the
 //    denominator of a division operation.  This is only used if the
 //    DEBUG macro is defined.
@@ -32,9 +32,25 @@ public:
 	// 处理相机的键盘操作
 	void keyboard(int key, int action, int mode);
 
+	// 每帧开始时调用一次：相机参数改变过时才重新计算观察、投影矩阵和视锥平面，
+	// 返回这一帧矩阵是否有变化。直接修改 radius、aspect 等成员后需要调用 markDirty
+	bool beginFrame(bool isOrtho = false);
+	void markDirty() { dirty = true; }
+
+	// 视锥的六个平面 (a, b, c, d)，法向量指向视锥内部并已归一化，
+	// 点 p 在平面内侧时 dot(vec3(a, b, c), p) + d >= 0
+	enum FrustumPlane { PLANE_LEFT = 0, PLANE_RIGHT, PLANE_BOTTOM, PLANE_TOP, PLANE_NEAR, PLANE_FAR, PLANE_COUNT };
+	const glm::vec4* getFrustumPlanes() const { return frustumPlanes; }
+
+	// 屏幕上 (x, y) 处（窗口坐标，原点在左上角）对应的世界坐标射线，用于鼠标拾取
+	// 使用上一次 beginFrame 的矩阵，即当前屏幕上看到的画面；direction 为单位向量
+	void getPickRay(double x, double y, int width, int height, glm::vec3& origin, glm::vec3& direction) const;
+
 	// 模视矩阵
 	glm::mat4 viewMatrix;
 	glm::mat4 projMatrix;
+	// projMatrix * viewMatrix，由 beginFrame 计算
+	glm::mat4 viewProjMatrix;
 
 	// 相机位置参数
 	float radius;
@@ -53,5 +69,13 @@ public:
 	// 正交投影参数
 	float scale;
 
+private:
+	// 从 viewProjMatrix 中提取视锥平面
+	void updateFrustumPlanes();
+
+	glm::vec4 frustumPlanes[PLANE_COUNT];
+	bool dirty;
+	bool lastOrtho;
+
 };
 #endif
\ No newline at end of file
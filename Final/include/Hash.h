@@ -0,0 +1,27 @@
+#ifndef _HASH_H_
+#define _HASH_H_
+
+#include <cstddef>
+#include <cstring>
+#include <stdint.h>
+#include <string>
+
+// 64 位 FNV-1a 哈希，用于判断缓存文件对应的源文件内容是否发生变化
+// seed 可以传入上一段数据的哈希值，把多段数据串起来计算
+inline uint64_t hashBytes(const void* data, size_t size, uint64_t seed = 14695981039346656037ULL)
+{
+	const unsigned char* p = (const unsigned char*)data;
+	uint64_t hash = seed;
+	for (size_t i = 0; i < size; i++) {
+		hash ^= p[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+inline uint64_t hashString(const std::string& s, uint64_t seed = 14695981039346656037ULL)
+{
+	return hashBytes(s.data(), s.size(), seed);
+}
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef _MAPPED_FILE_H_
+#define _MAPPED_FILE_H_
+
+#include <string>
+#include <cstddef>
+#include <fstream>
+#include <stdint.h>
+
+// 只读内存映射文件
+// 打开后整个文件直接映射到进程地址空间，读取模型时不再经过
+// ifstream 的逐字符拷贝，析构时自动解除映射
+class MappedFile
+{
+public:
+	MappedFile();
+	explicit MappedFile(const std::string& filename);
+	~MappedFile();
+
+	bool open(const std::string& filename);
+	void close();
+
+	bool isOpen() const { return opened_; }
+	const char* data() const { return data_; }
+	const char* end() const { return data_ + size_; }
+	size_t size() const { return size_; }
+
+	// 读取文件大小和最后修改时间，文件不存在时返回 false
+	static bool getFileInfo(const std::string& filename, uint64_t& size, int64_t& modify_time);
+	// 映射整个文件计算内容哈希（hashBytes），用于判断缓存对应的源文件是否变化
+	static bool hashFile(const std::string& filename, uint64_t& hash);
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+private:
+	const char* data_;
+	size_t size_;
+	bool opened_;
+#ifdef _WIN32
+	void* file_handle_;
+	void* mapping_handle_;
+#endif
+};
+
+// 缓存文件的写入：数据先写到 path + ".tmp"，commit 时再替换目标文件，
+// 中途失败或没有 commit 时删除临时文件，不会留下半个缓存
+class AtomicFileWriter
+{
+public:
+	explicit AtomicFileWriter(const std::string& path);
+	~AtomicFileWriter();
+
+	bool isOpen() const { return out_.is_open(); }
+	uint64_t written() const { return written_; }
+
+	void write(const void* data, size_t size);
+	// 补 0 直到已写入的字节数是 alignment 的倍数
+	void align(size_t alignment);
+	// 关闭临时文件并替换目标文件，全部成功时返回 true
+	bool commit();
+
+	AtomicFileWriter(const AtomicFileWriter&) = delete;
+	AtomicFileWriter& operator=(const AtomicFileWriter&) = delete;
+
+private:
+	std::string path_;
+	std::string temp_path_;
+	std::ofstream out_;
+	uint64_t written_;
+	bool committed_;
+};
+
+#endif
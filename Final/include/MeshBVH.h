@@ -0,0 +1,104 @@
+#ifndef _MESH_BVH_H_
+#define _MESH_BVH_H_
+
+#include "Angel.h"
+#include "TriMesh.h"
+
+#include <vector>
+#include <cfloat>
+#include <cmath>
+
+// 射线，交点为 origin + t * direction
+// direction 不要求是单位向量：用模型矩阵的逆把射线变换到物体坐标系后 t 保持不变
+struct Ray
+{
+	glm::vec3 origin;
+	glm::vec3 direction;
+
+	Ray() : origin(0.0f), direction(0.0f, 0.0f, -1.0f) {}
+	Ray(const glm::vec3& origin, const glm::vec3& direction) : origin(origin), direction(direction) {}
+
+	// 方向的倒数，用于 slab 测试。为 0 的分量换成同号的极小值：直接取倒数得到无穷大，
+	// 起点恰好在包围盒的面上时 0 * 无穷大 为 NaN，min/max 的结果会随参数顺序变化
+	glm::vec3 inverseDirection() const
+	{
+		glm::vec3 inv;
+		for (int i = 0; i < 3; i++)
+		{
+			float d = direction[i];
+			inv[i] = 1.0f / (std::fabs(d) < 1e-30f ? std::copysign(1e-30f, d) : d);
+		}
+		return inv;
+	}
+};
+
+// 射线求交的结果
+struct RayHit
+{
+	float t;
+	int triangle;	// 面片在 TriMesh::getFaces() 中的下标，没有交点时为 -1
+	float u, v;		// 交点的重心坐标，交点 = (1 - u - v) * v0 + u * v1 + v * v2
+
+	RayHit() : t(FLT_MAX), triangle(-1), u(0.0f), v(0.0f) {}
+	bool hit() const { return triangle >= 0; }
+};
+
+// 三角面片的包围体层次（BVH），用于射线求交与鼠标拾取
+// 自顶向下用分桶的表面积启发式（SAH）建树。节点按深度优先顺序存放在一个连续数组中，
+// 左子节点紧跟在父节点之后，只需记录右子节点的下标，每个节点 32 字节。
+// 三角形按叶子顺序重新排列，直接保存 v0 和两条边，求交时不再经过面片下标间接访问
+class MeshBVH
+{
+public:
+	MeshBVH();
+
+	// 在物体坐标系下建树，使用绘制用的顶点坐标（已经过大小归一化）
+	void build(TriMesh* mesh);
+	void build(const std::vector<glm::vec3>& positions, const std::vector<vec3i>& faces);
+	void clear();
+
+	bool empty() const { return nodes.empty(); }
+	int getNodeCount() const { return (int)nodes.size(); }
+	int getTriangleCount() const { return (int)triangle_ids.size(); }
+	int getMaxDepth() const { return max_depth; }
+	glm::vec3 getBoundsMin() const;
+	glm::vec3 getBoundsMax() const;
+
+	// 最近交点：只接受 0 < t < min(t_max, hit.t) 的交点，找到时更新 hit 并返回 true
+	// hit 可以沿用上一个物体的结果，依次对多个物体求交就得到整个场景中最近的交点
+	bool intersect(const Ray& ray, RayHit& hit, float t_max = FLT_MAX) const;
+	// 只判断 0 < t < t_max 范围内有没有交点，找到任意一个就返回
+	bool occluded(const Ray& ray, float t_max = FLT_MAX) const;
+	// 批量求交：hits[i] 为 rays[i] 的最近交点，射线较多时切块交给 ThreadPool 并行
+	void intersect(const Ray* rays, size_t count, RayHit* hits) const;
+
+private:
+	struct Node
+	{
+		glm::vec3 bounds_min;
+		int right_or_first;	// 内部节点：右子节点的下标；叶子：第一个三角形在 triangles 中的位置
+		glm::vec3 bounds_max;
+		int count;			// 叶子中的三角形数，内部节点为 0
+	};
+
+	// 建树时每个三角形的包围盒与中心
+	struct BuildTriangle
+	{
+		glm::vec3 bounds_min;
+		glm::vec3 bounds_max;
+		glm::vec3 centroid;
+		int face;
+	};
+
+	// depth 为节点深度（根为 0），达到遍历栈的大小时强制做叶子
+	int buildNode(std::vector<BuildTriangle>& build_triangles, int begin, int end, int depth);
+	// any_hit 为 true 时找到任意交点即返回
+	bool traverse(const Ray& ray, RayHit& hit, float t_max, bool any_hit) const;
+
+	std::vector<Node> nodes;
+	std::vector<glm::vec3> triangles;	// 每个三角形三项：v0, v1 - v0, v2 - v0
+	std::vector<int> triangle_ids;		// 与 triangles 顺序对应的面片下标
+	int max_depth;						// 最深的叶子深度
+};
+
+#endif
@@ -5,20 +5,70 @@
 #include "Angel.h"
 
 #include "Camera.h"
+#include "VertexFormat.h"
+#include "RenderQueue.h"
+#include "ShadowMap.h"
+#include "MeshBVH.h"
 
 #include <vector>
 #include <algorithm>
 
 
+// 聚光灯与环境光参数，和光源一起在 beginFrame 中写入 main.fs 的 LightData
+struct SceneLighting
+{
+	glm::vec3 spotDirection;
+	// 内外锥角的余弦值，默认值让聚光灯退化为点光源
+	float cutOff;
+	float outerCutOff;
+	glm::vec3 fillLight;
+	float roomAmbient;
+	float ambientBoost;
+	bool lightEnabled;
+
+	SceneLighting() : spotDirection(0.0f, -1.0f, 0.0f), cutOff(-1.0f), outerCutOff(-2.0f),
+		fillLight(0.0f), roomAmbient(0.0f), ambientBoost(0.0f), lightEnabled(true) {}
+};
+
+// main.fs 的着色器变体，各位组合起来作为 openGLObject::variants 的下标
+enum ShaderVariantFlag
+{
+	SHADER_USE_TEXTURE = 1,		// #define USE_TEXTURE
+	SHADER_LIGHT_ENABLED = 2,	// #define LIGHT_ENABLED
+	SHADER_INSTANCED = 4,		// #define INSTANCED，模型矩阵来自实例属性
+	SHADER_VARIANT_COUNT = 8,
+};
+
+// 物体如何投射阴影。静态物体的深度缓存在 ShadowMap 中，只在光源或静态物体变化时重画，
+// 动态物体（机械臂各关节）每帧叠加在缓存之上
+enum ShadowCasterType
+{
+	SHADOW_CASTER_NONE = 0,		// 不投射阴影
+	SHADOW_CASTER_STATIC = 1,	// 房间、桌子等不动的物体
+	SHADOW_CASTER_DYNAMIC = 2,	// 每帧都可能移动的物体
+};
+
 struct openGLObject
 {
 	// 顶点数组对象
 	GLuint vao;
 	// 顶点缓存对象
 	GLuint vbo;
+	// 上传时记录的顶点数，绘制时不再访问网格数据
+	GLsizei vertexCount;
+	// 索引缓存对象，网格没有使用索引模式时为0
+	GLuint ebo;
+	GLsizei indexCount;
+	// GL_UNSIGNED_SHORT 或 GL_UNSIGNED_INT
+	GLenum indexType;
+	// 实例模型矩阵的缓存对象，第一次实例化绘制时才创建
+	GLuint instanceVbo;
 
-	// 着色器程序
+	// 着色器程序，当前使用的变体
 	GLuint program;
+	// 各个变体，第一次用到时才编译，未编译的为 0
+	GLuint variants[SHADER_VARIANT_COUNT];
+	int variant;
 	// 着色器文件
 	std::string vshader;
 	std::string fshader;
@@ -31,14 +81,33 @@ struct openGLObject
     // 纹理
     std::string texture_image;
     GLuint texture;
+    bool hasTexture;
+	// 纹理坐标的缩放，大于 1 时纹理重复平铺
+	glm::vec2 uvScale;
+	GLuint uvScaleLocation;
 
-	// 投影变换变量
+	// 投影变换变量，观察和投影矩阵在每帧更新一次的 uniform block 中
 	GLuint modelLocation;
-	GLuint viewLocation;
-	GLuint projectionLocation;
+	GLuint normalMatrixLocation;
+
+	// 材质变量
+	GLuint materialAmbientLocation;
+	GLuint materialDiffuseLocation;
+	GLuint materialSpecularLocation;
+	GLuint materialShininessLocation;
+
+	// 投射阴影的方式，默认为静态
+	ShadowCasterType shadowCaster;
+	// 上一次画进静态阴影缓存时物体的变换版本号（TriMesh::getTransformVersion），变化时缓存失效
+	unsigned int shadowTransformVersion;
 
-	// 阴影变量
-	GLuint shadowLocation;
+	// 是否使用压缩的交错顶点格式，以及坐标的解码参数
+	bool packedVertices;
+	glm::vec3 positionOffset;
+	glm::vec3 positionScale;
+	GLuint packedLocation;
+	GLuint positionOffsetLocation;
+	GLuint positionScaleLocation;
 };
 
 
@@ -49,30 +118,101 @@ public:
     MeshPainter();
     ~MeshPainter();
 
-    std::vector<std::string> getMeshNames();
+    const std::vector<std::string>& getMeshNames() const;
+
+    const std::vector<TriMesh *>& getMeshes() const;
+    const std::vector<openGLObject>& getOpenGLObj() const;
+
+	// 之后添加的物体是否使用压缩的交错顶点格式（见 VertexFormat.h），默认开启；
+	// 颜色超出 [0, 1] 的网格仍使用 float 格式
+	void setPackedVertices(bool packed);
+	bool getPackedVertices();
+
+	// 聚光灯与环境光参数
+	void setSceneLighting(const SceneLighting& lighting);
+	const SceneLighting& getSceneLighting() const;
+	// 阴影贴图使用的光源空间矩阵，设置了 ShadowMap 时以 ShadowMap 中的为准
+	void setLightSpaceMatrix(const glm::mat4& matrix);
+
+	// 使用的阴影贴图，为 NULL 时不计算阴影。beginFrame 时绑定到 1 号纹理单元，
+	// 过滤方式（ShadowMap::setFilter）改变后着色器变体自动重新编译
+	void setShadowMap(ShadowMap* shadow_map);
+	// 绘制阴影贴图的深度着色器，默认为 shaders/depth.vs、shaders/depth.fs
+	void setDepthShaders(const std::string &vshader, const std::string &fshader);
 
-    std::vector<TriMesh *> getMeshes();
-    std::vector<openGLObject> getOpenGLObj();
+	// 第 i 个物体投射阴影的方式，新添加的物体默认为 SHADOW_CASTER_STATIC
+	void setShadowCaster(int i, ShadowCasterType type);
+	ShadowCasterType getShadowCaster(int i) const;
 
-	// 读取纹理文件
-    void load_texture_STBImage(const std::string &file_name, GLuint& texture);
+	// 第 i 个物体纹理坐标的缩放，默认为 (1, 1)
+	void setTextureScale(int i, const glm::vec2 &scale);
 
-	// 传递光线材质数据的
-    // void bindLightAndMaterial( int mesh_id, int light_id, Camera* camera );
-    void bindLightAndMaterial(TriMesh* mesh, openGLObject& object, Light* light, Camera* camera);
+	// 绘制阴影贴图：beginShadowPass 先处理静态物体（静态缓存失效时用各自的模型矩阵重画），
+	// 之后在它与 endShadowPass 之间用 drawShadowCaster 绘制动态物体，模型矩阵可以自己指定
+	void beginShadowPass();
+	void drawShadowCaster(int i, const glm::mat4 &modelMatrix);
+	void endShadowPass();
+	// 用每个物体自身的模型矩阵绘制整张阴影贴图，静态物体只在缓存失效时重画
+	void drawShadowMap();
+
+	// 实例化绘制：同一个物体的所有实例合并为一次 glDrawArraysInstanced / glDrawElementsInstanced，
+	// 绘制次数只与物体种类有关，与实例数量无关
+	// queueInstance 收集本帧第 i 个物体的模型矩阵；drawInstanceShadows 在 beginShadowPass 与
+	// endShadowPass 之间把收集到的实例画进阴影贴图；flushInstances 正常绘制并清空
+	void queueInstance(int i, const glm::mat4 &modelMatrix);
+	void drawInstanceShadows();
+	void flushInstances();
+
+	// 从 TextureManager 获取纹理文件对应的纹理（相同图片共享），失败时返回 false 且 texture 为 0
+    bool load_texture_STBImage(const std::string &file_name, GLuint& texture);
+
+	// 每帧开始绘制前调用一次：计算相机矩阵，并把相机、光源数据写入 uniform buffer
+	// drawMeshes 会自动调用，单独使用 drawMesh / queueMesh 时需要先手动调用
+	void beginFrame(Light* light, Camera* camera);
+
+	// 传递物体材质数据
+    void bindMaterial(TriMesh* mesh, openGLObject& object);
 
     void bindObjectAndData(TriMesh *mesh, openGLObject &object, const std::string &texture_image, const std::string &vshader, const std::string &fshader);
 
 	// 添加物体
     void addMesh( TriMesh* mesh, const std::string &name, const std::string &texture_image, const std::string &vshader, const std::string &fshader );
 
-	// 绘制物体
-    void drawMesh(TriMesh* mesh, openGLObject &object, Light *light, Camera* camera);
-	void drawMesh(int i, glm::mat4 modelMatrix, Light *light, Camera* camera);
+	// 立即绘制单个物体。相机与光源来自 uniform buffer，本帧必须先调用过 beginFrame
+    void drawMesh(TriMesh* mesh, openGLObject &object);
+	void drawMesh(int i, const glm::mat4 &modelMatrix);
 
-	// 绘制多个物体
+	// 绘制多个物体，先全部加入绘制队列，按状态排序后再提交
     void drawMeshes(Light *light, Camera* camera);
 
+	// 把第 i 个物体加入本帧的绘制队列，调用 flushQueue 时才真正绘制
+	void queueMesh(int i, const glm::mat4 &modelMatrix);
+	// 排序并绘制队列中的物体，然后清空队列
+	void flushQueue();
+
+	// 视锥剔除：beginFrame 时记下相机的视锥平面，queueMesh 与 flushInstances 直接跳过
+	// 世界包围盒完全在视锥外的物体，不产生任何 GL 调用。阴影 pass 不剔除，
+	// 视锥外的物体仍可能把阴影投进画面。默认开启
+	void setFrustumCulling(bool enabled);
+	bool getFrustumCulling() const;
+	// 模型矩阵为 modelMatrix 的第 i 个物体是否与本帧的视锥相交，没有开启剔除时总是 true
+	bool isVisible(int i, const glm::mat4 &modelMatrix);
+
+	// 拾取：世界坐标的射线与模型矩阵为 modelMatrix 的第 i 个物体求交，比 hit 中已有的交点近时更新 hit
+	// 每个物体的 BVH 在第一次求交时建立；射线按模型矩阵的逆变换到物体坐标系，t 不变
+	bool intersectMesh(int i, const glm::mat4 &modelMatrix, const Ray &ray, RayHit &hit);
+	// 用每个物体自身的模型矩阵找射线碰到的最近物体，返回下标，没有时返回 -1
+	int pickMesh(const Ray &ray, RayHit &hit);
+	// 第 i 个物体的 BVH，需要时建立
+	const MeshBVH& getMeshBVH(int i);
+
+	// 本帧的状态切换次数、绘制次数与剔除的物体数，包括阴影 pass
+	const RenderStats& getFrameStats() const;
+	// 每帧最开始（阴影 pass 之前）调用一次，清零统计
+	void resetFrameStats();
+	// 在 MeshPainter 之外直接绑定过 VAO、纹理或着色器程序后调用，让下一次绘制重新绑定
+	void invalidateState();
+
 	// 清空数据
     void cleanMeshes();
 
@@ -84,6 +224,65 @@ private:
     std::vector<std::string> mesh_names;
     std::vector<TriMesh *> meshes;
     std::vector<openGLObject> opengl_objects;
+    // 拾取用的 BVH，与 meshes 一一对应，没有用到的为 NULL
+    std::vector<MeshBVH*> mesh_bvhs;
+
+    bool packed_vertices;
+
+    // 每帧更新一次的 uniform buffer
+    GLuint frame_ubo;
+    GLuint light_ubo;
+    SceneLighting scene_lighting;
+    glm::mat4 light_space_matrix;
+
+    // 绘制队列，以及当前绑定的 VAO 和 0 号纹理单元上的纹理，相同时跳过绑定
+    RenderQueue render_queue;
+    RenderStats frame_stats;
+    GLuint bound_vao;
+    GLuint bound_texture;
+
+    // 视锥剔除用的平面，beginFrame 之后才有效
+    bool frustum_culling;
+    bool frustum_valid;
+    glm::vec4 frustum_planes[Camera::PLANE_COUNT];
+
+    // 阴影贴图与深度绘制用的着色器
+    ShadowMap* shadow_map;
+    int variant_shadow_filter;		// 当前变体编译时使用的 SHADOW_FILTER
+    std::string depth_vshader;
+    std::string depth_fshader;
+    GLuint depth_program;
+    GLint depth_light_location;
+    GLint depth_model_location;
+    GLint depth_packed_location;
+    GLint depth_offset_location;
+    GLint depth_scale_location;
+    // 实例化绘制用的深度着色器，模型矩阵来自实例属性
+    GLuint depth_instanced_program;
+    GLint depth_instanced_light_location;
+    GLint depth_instanced_packed_location;
+    GLint depth_instanced_offset_location;
+    GLint depth_instanced_scale_location;
+
+    // 每个物体本帧收集到的实例模型矩阵，以及是否已经上传到各自的 instanceVbo
+    std::vector<std::vector<glm::mat4> > instance_lists;
+    bool instances_uploaded;
+    // 上传前把模型矩阵与法向量矩阵拼在一起的暂存数组，各帧复用
+    std::vector<InstanceData> instance_upload;
+
+    // instance_count 大于 0 时使用实例化变体，忽略 modelMatrix，一次画出 instance_count 个实例
+    void drawObject(TriMesh* mesh, openGLObject &object, const glm::mat4 &modelMatrix, GLsizei instance_count = 0);
+    // 按物体是否有纹理、当前光源开关以及是否实例化切换到对应的着色器变体（需要时编译），并更新 uniform 位置
+    void selectVariant(openGLObject &object, bool instanced = false);
+    // 阴影过滤方式改变时释放所有变体并按新的宏重新选择
+    void updateShadowFilter();
+    // 第一次绘制阴影时获取深度着色器，之后切换到它并上传光源空间矩阵
+    void useDepthProgram();
+    void useDepthInstancedProgram();
+    // 把收集到的实例矩阵上传到各物体的 instanceVbo，一帧只上传一次
+    void uploadInstances();
+    // 静态物体的模型矩阵变化或缓存失效时，把所有静态物体重画到 ShadowMap 的静态缓存中
+    void updateStaticShadows();
 
 };
 
@@ -0,0 +1,60 @@
+#ifndef _RENDER_QUEUE_H_
+#define _RENDER_QUEUE_H_
+
+#include "Angel.h"
+
+#include <vector>
+#include <stdint.h>
+
+// 每帧的状态切换统计，用来确认排序后 glUseProgram / glBindTexture / glBindVertexArray 的调用次数
+// 以及视锥剔除掉和实际绘制的物体数（实例化绘制时每个实例算一个）
+struct RenderStats
+{
+	unsigned int programChanges;
+	unsigned int textureChanges;
+	unsigned int vaoChanges;
+	unsigned int drawCalls;
+	unsigned int meshesDrawn;
+	unsigned int meshesCulled;
+
+	RenderStats() { reset(); }
+	void reset() { programChanges = textureChanges = vaoChanges = drawCalls = meshesDrawn = meshesCulled = 0; }
+	unsigned int stateChanges() const { return programChanges + textureChanges + vaoChanges; }
+};
+
+// 一次绘制需要的状态，object 是 MeshPainter 中物体的下标
+struct DrawItem
+{
+	uint64_t key;
+	GLuint program;
+	GLuint texture;
+	GLuint vao;
+	int object;
+	glm::mat4 modelMatrix;
+};
+
+// 绘制队列
+// 每帧先收集所有绘制记录，按 (程序, 纹理, VAO) 组成的键排序后再提交，
+// 使用相同状态的物体排在一起，切换代价最高的着色器程序放在键的最高位
+class RenderQueue
+{
+public:
+	void clear();
+	void push(GLuint program, GLuint texture, GLuint vao, int object, const glm::mat4& modelMatrix);
+	// 按键排序，键相同的记录保持加入的先后顺序
+	void sort();
+
+	size_t size() const { return items.size(); }
+	bool empty() const { return items.empty(); }
+	const DrawItem& operator[](size_t i) const { return items[order[i]]; }
+
+	// 程序 20 位、纹理 20 位、VAO 24 位拼成 64 位的键
+	static uint64_t makeKey(GLuint program, GLuint texture, GLuint vao);
+
+private:
+	std::vector<DrawItem> items;
+	// 排序只移动下标，不搬动矩阵
+	std::vector<uint32_t> order;
+};
+
+#endif
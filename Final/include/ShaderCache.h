@@ -0,0 +1,97 @@
+#ifndef _SHADER_CACHE_H_
+#define _SHADER_CACHE_H_
+
+#include "Angel.h"
+
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <stdint.h>
+
+// 一个着色器程序中所有 uniform 的位置
+// 链接后遍历 active uniform 查询一次，之后按名字查表，不再调用 glGetUniformLocation
+class UniformTable
+{
+public:
+	void build(GLuint program);
+	// 程序中没有这个 uniform（或被编译器优化掉）时返回 -1
+	GLint location(const std::string& name) const;
+	size_t size() const { return locations.size(); }
+
+private:
+	std::unordered_map<std::string, GLint> locations;
+};
+
+// 着色器程序缓存
+// 以着色器文件路径和 defines 为键，相同的 vshader/fshader 组合只编译链接一次，
+// 多个物体共享同一个程序对象，通过引用计数决定何时删除。
+// 命中缓存时不读取文件；调用 reloadSources 后才重新检查源码是否变化。
+// 链接后的程序二进制写入 <vshader>.<哈希>.glbin，之后的启动直接加载，
+// 源码或显卡驱动变化时自动回退为编译
+class ShaderCache
+{
+public:
+	static ShaderCache& shared();
+
+	// 获取 vshader/fshader 对应的程序，引用计数加一；读取或编译失败时返回 0
+	// defines 为若干行 "#define NAME"，插入到两个着色器的 #version 之后，不同的 defines 得到不同的变体
+	GLuint acquire(const std::string& vshader, const std::string& fshader, const std::string& defines = "");
+	// 引用计数减一，减到 0 时删除程序
+	void release(GLuint program);
+	// 让之后的 acquire 重新读取并比较源码（含 #include 的文件），内容变化的程序重新编译，
+	// 旧程序继续留给还在使用它的物体
+	void reloadSources() { source_generation++; }
+
+	// 程序的 uniform 位置表，program 不是由 ShaderCache 创建时返回空表
+	const UniformTable& getUniforms(GLuint program) const;
+
+	// 是否读写程序二进制缓存，默认开启（驱动不支持时自动跳过）
+	void setBinaryCacheEnabled(bool enabled) { binary_cache_enabled = enabled; }
+
+	// 当前缓存中的程序数
+	size_t size() const { return entries.size(); }
+
+	// 切换着色器程序，与当前程序相同时跳过 glUseProgram，返回是否真的切换了
+	bool useProgram(GLuint program);
+	// 在 ShaderCache 之外直接调用过 glUseProgram 后，需要调用它让下一次 useProgram 重新绑定
+	void invalidateBoundProgram() { bound_program = INVALID_PROGRAM; }
+
+	// 统计 glUseProgram 的实际调用次数和被跳过的次数
+	unsigned int getProgramSwitches() const { return program_switches; }
+	unsigned int getSkippedSwitches() const { return skipped_switches; }
+	void resetStats() { program_switches = skipped_switches = 0; }
+
+private:
+	ShaderCache();
+
+	ShaderCache(const ShaderCache&) = delete;
+	ShaderCache& operator=(const ShaderCache&) = delete;
+
+	struct Entry
+	{
+		GLuint program;
+		int ref_count;
+		uint64_t content_hash;		// 展开 #include 并插入 defines 后源码的哈希
+		unsigned int generation;	// 上次检查源码时的 source_generation
+		UniformTable uniforms;
+	};
+
+	// 把程序中声明的 uniform block 绑定到 UniformBlocks.h 中约定的绑定点
+	static void bindUniformBlocks(GLuint program);
+	// 驱动是否支持 glGetProgramBinary / glProgramBinary，第一次调用时查询
+	bool binaryCacheAvailable();
+
+	static const GLuint INVALID_PROGRAM = ~0u;
+
+	std::map<std::string, Entry> entries;		// 键 -> 程序
+	std::map<GLuint, std::string> program_keys;	// 程序 -> 键，release 时反查
+	UniformTable empty_uniforms;
+	bool binary_cache_enabled;
+	int binary_support;			// -1 表示还没有查询
+	unsigned int source_generation;
+	GLuint bound_program;
+	unsigned int program_switches;
+	unsigned int skipped_switches;
+};
+
+#endif
@@ -0,0 +1,90 @@
+#ifndef _SHADOW_MAP_H_
+#define _SHADOW_MAP_H_
+
+#include "Angel.h"
+
+// 阴影贴图的过滤方式，数值即 main.fs 中 SHADOW_FILTER 宏的值
+// 深度纹理开启了比较模式，每次采样由硬件完成深度比较和 2x2 双线性 PCF
+enum ShadowFilter
+{
+	SHADOW_FILTER_NONE = -1,	// 不计算阴影
+	SHADOW_PCF_1 = 0,			// 1 次采样
+	SHADOW_PCF_4 = 1,			// 2x2 次采样
+	SHADOW_PCF_9 = 2,			// 3x3 次采样
+	SHADOW_POISSON = 3,			// 按像素随机旋转的 12 点泊松圆盘
+};
+
+// 聚光灯的阴影贴图
+// 深度纹理以 GL_COMPARE_REF_TO_TEXTURE 模式绑定为 sampler2DShadow，
+// 分辨率可以在运行时修改，在画质与填充率之间取舍。
+// 静态物体（房间、桌子）的深度单独缓存在另一张纹理中，只在光源或静态物体变化时重画，
+// 每帧把缓存复制到阴影贴图后只需再画动态物体（机械臂）
+class ShadowMap
+{
+public:
+	explicit ShadowMap(int resolution = 1024);
+	~ShadowMap();
+
+	// 修改分辨率，下一次 begin 时重建深度纹理，超过显卡上限时取上限
+	void setResolution(int resolution);
+	int getResolution() const { return resolution; }
+
+	void setFilter(ShadowFilter filter) { this->filter = filter; }
+	ShadowFilter getFilter() const { return filter; }
+
+	// 光源空间矩阵变化时静态缓存失效
+	void setLightSpaceMatrix(const glm::mat4& matrix);
+	const glm::mat4& getLightSpaceMatrix() const { return light_space_matrix; }
+
+	// 聚光灯的光源空间矩阵，视锥张角比外锥角略大，保证光照范围都在阴影贴图内
+	static glm::mat4 spotLightMatrix(const glm::vec3& position, const glm::vec3& direction,
+		float outerCutOffDegrees, float nearPlane, float farPlane);
+
+	// 是否缓存静态物体的深度，默认开启；关闭后 begin 每次清空深度，所有物体都要在 begin/end 之间绘制
+	void setStaticCacheEnabled(bool enabled);
+	bool getStaticCacheEnabled() const { return static_cache_enabled; }
+	// 静态物体移动、增删后调用，下一帧重画静态缓存
+	void invalidateStatic() { static_dirty = true; }
+	bool isStaticDirty() const { return static_dirty; }
+
+	// 静态缓存需要重画时绑定它的帧缓冲、清空深度并返回 true，
+	// 此时在 beginStatic 与 endStatic 之间绘制静态物体；缓存有效时什么也不做并返回 false
+	bool beginStatic();
+	void endStatic();
+
+	// 绑定阴影贴图的帧缓冲，开启静态缓存时先复制缓存的深度，否则清空深度；
+	// end 时恢复原来的帧缓冲和视口
+	void begin();
+	void end();
+
+	GLuint getTexture() const { return depth_texture; }
+	GLuint getFramebuffer() const { return framebuffer; }
+
+	ShadowMap(const ShadowMap&) = delete;
+	ShadowMap& operator=(const ShadowMap&) = delete;
+
+private:
+	void create();
+	void destroy();
+	// 创建一个只有深度附件的帧缓冲，compare 为 true 时深度纹理开启比较模式
+	void createTarget(GLuint& target_framebuffer, GLuint& target_texture, bool compare);
+	void bindTarget(GLuint target_framebuffer);
+	void restoreTarget();
+
+	int resolution;
+	int created_resolution;
+	ShadowFilter filter;
+	glm::mat4 light_space_matrix;
+	bool static_cache_enabled;
+	bool static_dirty;
+
+	GLuint framebuffer;
+	GLuint depth_texture;
+	GLuint static_framebuffer;		// 静态物体深度缓存
+	GLuint static_texture;
+
+	GLint saved_framebuffer;
+	GLint saved_viewport[4];
+};
+
+#endif
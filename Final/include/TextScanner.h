@@ -0,0 +1,206 @@
+#ifndef _TEXT_SCANNER_H_
+#define _TEXT_SCANNER_H_
+
+#include <cstdlib>
+#include <cstring>
+#include <stdint.h>
+
+// 在一段只读内存（通常是 MappedFile 的内容）上顺序解析数字
+// 与 from_chars 的思路一致：不依赖 locale、不分配内存、不要求以'\0'结尾，
+// 解析成功后游标停在数字后面
+class TextScanner
+{
+public:
+	TextScanner(const char* begin, const char* end) : cur(begin), last(end) {}
+
+	bool atEnd() const { return cur >= last; }
+	const char* position() const { return cur; }
+
+	// 跳过空白（含换行）
+	void skipSpace()
+	{
+		while (cur < last && isSpace(*cur)) ++cur;
+	}
+
+	// 跳过空白以及 '#' 开头的注释行
+	void skipSpaceAndComments()
+	{
+		for (;;) {
+			skipSpace();
+			if (cur < last && *cur == '#') skipLine();
+			else return;
+		}
+	}
+
+	// 只跳过行内空白，不跨行
+	void skipBlank()
+	{
+		while (cur < last && (*cur == ' ' || *cur == '\t' || *cur == '\r')) ++cur;
+	}
+
+	// 跳到下一行行首
+	void skipLine()
+	{
+		const char* nl = (const char*)memchr(cur, '\n', last - cur);
+		cur = nl ? nl + 1 : last;
+	}
+
+	bool atLineEnd() const { return cur >= last || *cur == '\n'; }
+
+	// 下一个字符是 c 时跳过它并返回 true
+	bool consume(char c)
+	{
+		if (cur < last && *cur == c) {
+			++cur;
+			return true;
+		}
+		return false;
+	}
+
+	// 读取一个不含空白的单词，返回其起止位置
+	bool readToken(const char*& token_begin, const char*& token_end)
+	{
+		skipSpace();
+		token_begin = cur;
+		while (cur < last && !isSpace(*cur)) ++cur;
+		token_end = cur;
+		return token_end > token_begin;
+	}
+
+	bool readInt(int& value)
+	{
+		skipSpace();
+		return parseInt(value);
+	}
+
+	bool readFloat(float& value)
+	{
+		skipSpace();
+		return parseFloat(value);
+	}
+
+	// 从游标处直接解析整数，不跳过前导空白
+	bool parseInt(int& value)
+	{
+		const char* p = cur;
+		bool negative = false;
+		if (p < last && (*p == '-' || *p == '+')) {
+			negative = (*p == '-');
+			++p;
+		}
+		const char* digits = p;
+		long long v = 0;
+		while (p < last && isDigit(*p)) {
+			v = v * 10 + (*p - '0');
+			++p;
+		}
+		if (p == digits)
+			return false;
+		value = (int)(negative ? -v : v);
+		cur = p;
+		return true;
+	}
+
+	// 从游标处直接解析浮点数，不跳过前导空白
+	// 绝大多数模型里的坐标有效位数不超过 15 位、指数很小，
+	// 这时尾数和 10 的幂都能被 double 精确表示，一次乘除即可得到正确舍入的结果；
+	// 其余少见情况交给 strtod 兜底
+	bool parseFloat(float& value)
+	{
+		const char* begin = cur;
+		const char* p = cur;
+		bool negative = false;
+		if (p < last && (*p == '-' || *p == '+')) {
+			negative = (*p == '-');
+			++p;
+		}
+
+		uint64_t mantissa = 0;
+		int significant = 0;
+		int exponent = 0;
+		bool any_digit = false;
+		bool truncated = false;
+
+		while (p < last && isDigit(*p)) {
+			any_digit = true;
+			if (significant < 19) {
+				mantissa = mantissa * 10 + (*p - '0');
+				if (mantissa != 0) ++significant;
+			}
+			else {
+				++exponent;
+				truncated = true;
+			}
+			++p;
+		}
+		if (p < last && *p == '.') {
+			++p;
+			while (p < last && isDigit(*p)) {
+				any_digit = true;
+				if (significant < 19) {
+					mantissa = mantissa * 10 + (*p - '0');
+					if (mantissa != 0) ++significant;
+					--exponent;
+				}
+				else {
+					truncated = true;
+				}
+				++p;
+			}
+		}
+		if (!any_digit)
+			return false;
+
+		if (p < last && (*p == 'e' || *p == 'E')) {
+			const char* q = p + 1;
+			bool exp_negative = false;
+			if (q < last && (*q == '-' || *q == '+')) {
+				exp_negative = (*q == '-');
+				++q;
+			}
+			if (q < last && isDigit(*q)) {
+				int e = 0;
+				while (q < last && isDigit(*q)) {
+					if (e < 10000) e = e * 10 + (*q - '0');
+					++q;
+				}
+				exponent += exp_negative ? -e : e;
+				p = q;
+			}
+		}
+
+		static const double powers_of_ten[23] = {
+			1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+			1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+		};
+
+		double d;
+		if (!truncated && mantissa <= (uint64_t(1) << 53) && exponent >= -22 && exponent <= 22) {
+			d = (double)mantissa;
+			d = exponent < 0 ? d / powers_of_ten[-exponent] : d * powers_of_ten[exponent];
+			if (negative) d = -d;
+		}
+		else {
+			// 慢速路径：拷贝到以'\0'结尾的小缓冲区后交给 strtod
+			char buffer[128];
+			size_t len = (size_t)(p - begin);
+			if (len >= sizeof(buffer)) len = sizeof(buffer) - 1;
+			memcpy(buffer, begin, len);
+			buffer[len] = '\0';
+			d = strtod(buffer, NULL);
+		}
+
+		value = (float)d;
+		cur = p;
+		return true;
+	}
+
+private:
+	static bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v'; }
+	static bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+	const char* cur;
+	const char* last;
+};
+
+#endif
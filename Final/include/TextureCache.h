@@ -0,0 +1,54 @@
+#ifndef _TEXTURE_CACHE_H_
+#define _TEXTURE_CACHE_H_
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+// 预处理后的纹理数据
+// 第一次读取图片时在 CPU 上生成完整的多级渐远纹理并压缩为 BC1（DXT1），写入图片旁边的
+// <图片文件名>.tmtex 缓存，之后的启动直接读取缓存，逐级上传，不再解码 JPG/PPM。
+// 带透明通道的图片和不支持 S3TC 的驱动使用未压缩的 RGBA8 多级纹理
+enum TextureDataFormat
+{
+	TEXTURE_DATA_RAW = 0,	// 解码得到的原始像素，只有第 0 级，不写入缓存
+	TEXTURE_DATA_RGBA8 = 1,
+	TEXTURE_DATA_BC1 = 2,
+};
+
+struct TextureLevel
+{
+	uint32_t width;
+	uint32_t height;
+	uint64_t offset;	// 在 TextureData::data 中的偏移
+	uint64_t size;
+};
+
+struct TextureData
+{
+	uint32_t format;
+	uint32_t channels;	// 只对 TEXTURE_DATA_RAW 有意义
+	uint32_t width;
+	uint32_t height;
+	std::vector<TextureLevel> levels;
+	std::vector<unsigned char> data;
+};
+
+// 是否读写纹理缓存，默认开启
+void setTextureCacheEnabled(bool enabled);
+bool getTextureCacheEnabled();
+
+std::string textureCachePath(const std::string& filename);
+
+// 读取 filename 对应的缓存，缓存不存在、已过期或是 BC1 格式但 allow_bc1 为 false 时返回 false
+bool loadTextureCache(const std::string& filename, bool allow_bc1, TextureData& out);
+// 把预处理好的数据写入缓存，TEXTURE_DATA_RAW 不会写入
+bool saveTextureCache(const std::string& filename, const TextureData& texture);
+
+// 由解码后的像素生成多级渐远纹理；compress 为 true 且图片不透明时压缩为 BC1
+void buildTextureData(const unsigned char* pixels, int width, int height, int channels, bool compress, TextureData& out);
+
+// 压缩一个 4x4 的 RGBA 块（按行排列的 16 个像素），输出 8 字节
+void encodeBC1Block(const unsigned char* rgba, unsigned char* out);
+
+#endif
@@ -0,0 +1,101 @@
+#ifndef _TEXTURE_MANAGER_H_
+#define _TEXTURE_MANAGER_H_
+
+#include "Angel.h"
+#include "TextureCache.h"
+
+#include <map>
+#include <string>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+// 纹理缓存
+// 纹理文件名只在第一次使用时按搜索路径解析一次，并以规范化后的绝对路径去重，
+// 引用同一张图片的物体共享同一个纹理对象，通过引用计数决定何时删除。
+// 上传时生成完整的多级渐远纹理，远处的地面和墙面采样更小的层级
+//
+// 默认异步加载：acquire 立即返回一个绑定了 1x1 占位图的纹理对象，图片在线程池中解码，
+// 主线程每帧调用 processUploads 在时间预算内通过像素缓冲对象（PBO）上传解码好的图片，
+// 启动时间不再随纹理数量增长。
+// 解码后的图片会预先生成多级渐远纹理并尽量压缩为 BC1，写入缓存（见 TextureCache.h）
+class TextureManager
+{
+public:
+	static TextureManager& shared();
+	~TextureManager();
+
+	// 获取图片对应的纹理，引用计数加一；找不到或解码失败时返回 0
+	// 异步模式下解码在后台进行，解码失败时纹理保持占位图
+	GLuint acquire(const std::string& file_name);
+	// 引用计数减一，减到 0 时删除纹理
+	void release(GLuint texture);
+
+	// 按搜索路径找到图片，返回规范化的路径，找不到时返回空字符串
+	std::string resolvePath(const std::string& file_name);
+
+	// 之后获取的纹理是否在后台解码，关闭时 acquire 直接解码上传，默认开启
+	void setAsyncLoading(bool async);
+	bool getAsyncLoading() const { return async_loading; }
+
+	// 每帧上传的时间预算（毫秒），至少会上传一张
+	void setUploadBudget(double milliseconds) { upload_budget_ms = milliseconds; }
+
+	// 在主线程上传已经解码好的图片，返回本次上传的数量
+	int processUploads();
+	// 等待所有图片解码并上传完成
+	void finishUploads();
+	// 还没有上传的图片数
+	size_t pendingCount() const { return pending_count; }
+
+	// 当前缓存中的纹理数
+	size_t size() const { return entries.size(); }
+
+private:
+	TextureManager();
+
+	TextureManager(const TextureManager&) = delete;
+	TextureManager& operator=(const TextureManager&) = delete;
+
+	struct Entry
+	{
+		GLuint texture;
+		int ref_count;
+	};
+
+	// 工作线程解码完成的图片
+	struct DecodedImage
+	{
+		GLuint texture;
+		std::string path;
+		bool ok;
+		TextureData data;
+	};
+
+	// 读取缓存或解码图片，可以在任意线程调用；allow_bc1 表示驱动支持 S3TC 压缩纹理
+	static void decodeImage(const std::string& path, bool allow_bc1, DecodedImage& image);
+	// 上传到 texture，pbo 不为 0 时经由像素缓冲对象上传
+	static void uploadImage(const DecodedImage& image, GLuint pbo);
+	// 查询驱动是否支持 GL_EXT_texture_compression_s3tc，需要在 OpenGL 线程调用
+	static bool queryS3TCSupport();
+	// 给新建的纹理放一张 1x1 的占位图
+	static void uploadPlaceholder(GLuint texture);
+
+	std::map<std::string, std::string> resolved_paths;	// 文件名 -> 规范路径，找不到时为空
+	std::map<std::string, Entry> entries;				// 规范路径 -> 纹理
+	std::map<GLuint, std::string> texture_paths;		// 纹理 -> 规范路径，release 时反查
+
+	bool async_loading;
+	double upload_budget_ms;
+	GLuint upload_pbo;
+	int s3tc_supported;			// -1 表示还没有查询
+	size_t pending_count;		// 已投递但还没有上传的图片数，只在主线程访问
+
+	// 工作线程与主线程之间的交接队列
+	std::mutex decoded_mutex;
+	std::condition_variable decoded_condition;
+	std::deque<DecodedImage> decoded;
+	size_t decoding_count;		// 正在解码的图片数，析构时等待其归零
+};
+
+#endif
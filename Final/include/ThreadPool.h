@@ -0,0 +1,46 @@
+#ifndef _THREAD_POOL_H_
+#define _THREAD_POOL_H_
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+// 固定大小的线程池
+// 模型解析、法向量计算等可以切块并行的工作都交给它，
+// 避免每次调用都重新创建线程
+class ThreadPool
+{
+public:
+	// num_threads 为 0 时按硬件线程数创建
+	explicit ThreadPool(unsigned int num_threads = 0);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	unsigned int size() const { return (unsigned int)workers.size(); }
+
+	// 投递一个异步任务，不等待其完成
+	void enqueue(const std::function<void()>& task);
+
+	// 并行执行 fn(0) ... fn(count-1)，全部完成后才返回
+	// 调用线程自己也会参与执行，所以在工作线程里嵌套调用也不会死锁
+	void parallelFor(size_t count, const std::function<void(size_t)>& fn);
+
+	// 全局共享的线程池
+	static ThreadPool& shared();
+
+private:
+	void workerLoop();
+
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()> > tasks;
+	std::mutex mutex;
+	std::condition_variable condition;
+	bool stopping;
+};
+
+#endif
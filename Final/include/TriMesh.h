@@ -16,6 +16,14 @@ typedef struct vIndex {
 	vIndex(int ix, int iy, int iz) : x(ix), y(iy), z(iz) {}
 } vec3i;
 
+// 由面片法向量累加顶点法向量时每个面片的权重
+enum NormalWeighting
+{
+	NORMAL_WEIGHT_UNIFORM = 0,	// 相邻面片权重相同（默认，与原来的结果一致）
+	NORMAL_WEIGHT_AREA = 1,		// 按面片面积加权，细碎的小面片影响更小
+	NORMAL_WEIGHT_ANGLE = 2,	// 按面片在该顶点处的内角加权，结果与网格的三角划分方式无关
+};
+
 class TriMesh
 {
 public:
@@ -25,20 +33,29 @@ public:
 	glm::vec3 getConnectPosition();
 	void setConnectPosition(glm::vec3 _connect_position);
 
-	std::vector<glm::vec3> getVertexPositions();
-	std::vector<glm::vec3> getVertexColors();
-	std::vector<glm::vec3> getVertexNormals();
-	std::vector<glm::vec2> getVertexTextures();
+	const std::vector<glm::vec3>& getVertexPositions() const;
+	const std::vector<glm::vec3>& getVertexColors() const;
+	const std::vector<glm::vec3>& getVertexNormals() const;
+	const std::vector<glm::vec2>& getVertexTextures() const;
 
-	std::vector<vec3i> getFaces();
-	std::vector<glm::vec3> getPoints();
-	std::vector<glm::vec3> getColors();
-	std::vector<glm::vec3> getNormals();
-	std::vector<glm::vec2> getTextures();
+	const std::vector<vec3i>& getFaces() const;
+	const std::vector<glm::vec3>& getPoints() const;
+	const std::vector<glm::vec3>& getColors() const;
+	const std::vector<glm::vec3>& getNormals() const;
+	const std::vector<glm::vec2>& getTextures() const;
+	// 索引模式下三角形的顶点下标，非索引模式下为空
+	const std::vector<unsigned int>& getIndices() const;
 
+	// 面片法向量：每 4 个面片一批用 SIMD 计算叉积与长度，面片较多时切块交给线程池
 	void computeTriangleNormals();
+	// 顶点法向量：先建立顶点到相邻面片的 CSR 邻接表，再按顶点切块并行累加，
+	// 每个顶点只由一个线程写入，不需要加锁；权重见 setNormalWeighting
 	void computeVertexNormals();
 
+	// 计算顶点法向量使用的权重，需要在读取/生成模型之前设置
+	void setNormalWeighting(NormalWeighting weighting);
+	NormalWeighting getNormalWeighting();
+
 	// 获取和设置物体的旋转平移变化
 	glm::vec3 getTranslation();
 	glm::vec3 getRotation();
@@ -48,11 +65,28 @@ public:
 	void setTranslation(glm::vec3 translation);
 	void setRotation(glm::vec3 rotation);
 	void setScale(glm::vec3 scale);
+	// 平移、旋转、缩放每次被修改时加一，用于判断按模型矩阵缓存的结果是否过期
+	unsigned int getTransformVersion();
 
 	void setNormalize(bool do_norm);
 	bool getNormalize();
+
+	// 索引模式：storeFacesPoints 不再把每个面片展开成三份顶点，
+	// 而是把（坐标, 颜色, 法向量, 纹理）下标组合相同的顶点合并，
+	// points 等数组只保存不重复的顶点，另外生成 indices 供 glDrawElements 使用。
+	// 需要在读取/生成模型之前设置
+	void setIndexed(bool indexed);
+	bool getIndexed();
 	float getDiagonalLength();
 
+	// 物体坐标系下的包围盒，已经考虑了大小归一化，即绘制用的顶点坐标的范围
+	glm::vec3 getLocalBoundsMin();
+	glm::vec3 getLocalBoundsMax();
+	// 世界坐标系下的轴对齐包围盒：把物体包围盒的中心和半边长用模型矩阵变换后重新取轴对齐范围
+	void getWorldAABB(const glm::mat4& model, glm::vec3& world_min, glm::vec3& world_max);
+	// 世界坐标系下的包围球，半径按模型矩阵三个轴中最大的缩放放大
+	void getWorldBoundingSphere(const glm::mat4& model, glm::vec3& world_center, float& world_radius);
+
 	// 设置物体旋转位移动画的参数
 	// void setTranslateTheta(float x, float y, float z);
 	// void setRotateTheta(float x, float y, float z);
@@ -81,21 +115,38 @@ public:
 	void generateTriangle(glm::vec3 color);
 	void generateSquare(glm::vec3 color);
 
-	void generateCylinder(int num_division, float radius, float height);
-	void generateDisk(int num_division, float radius);
+	// 不指定颜色时用法向量作为颜色
+	void generateCylinder(int num_division, float radius, float height, glm::vec3 _color = glm::vec3(-1,-1,-1));
+	void generateDisk(int num_division, float radius, glm::vec3 _color = glm::vec3(-1,-1,-1));
+	void generateSphere(int num_division, float radius, glm::vec3 _color = glm::vec3(-1,-1,-1));
 	void generateCone(int num_division, float radius, float height);
 
 	void readOff(const std::string& filename);
 	void readObj(const std::string& filename);
 
+	// 设置解析 OBJ 时使用的线程数，0 表示自动（默认），1 表示单线程，可用于对比耗时
+	static void setObjParseThreads(unsigned int num_threads);
+	// 设置计算法向量使用的线程数，0 表示自动（默认），1 表示单线程，可用于对比耗时
+	static void setNormalThreads(unsigned int num_threads);
+
+	// 读取 OFF/OBJ 后会在模型旁写一个 .tmbin 二进制缓存，下次直接映射加载；
+	// 源文件内容变化时缓存自动失效。默认开启
+	static void setMeshCacheEnabled(bool enabled);
+
 	// 将读取的顶点根据三角面片上的顶点下标逐个加入
 	// 要传递给GPU的points等容器内
 	void storeFacesPoints();
+	// 索引模式下由 storeFacesPoints 调用，合并重复顶点并生成 indices
+	void storeIndexedPoints();
 
 	// 清除数据
 	void cleanData();
 
 protected:
+	// 从 filename 对应的 .tmbin 缓存恢复数据，缓存不存在或已过期时返回 false
+	bool loadMeshCache(const std::string& filename);
+	// 把当前数据写入 filename 对应的 .tmbin 缓存
+	void saveMeshCache(const std::string& filename);
 
 	std::vector<glm::vec3> vertex_positions;	// 顶点坐标
 	std::vector<glm::vec3> vertex_colors;	// 顶点颜色
@@ -108,11 +159,16 @@ protected:
 	std::vector<vec3i> texture_index;	// 每个三角面片的顶点对应纹理坐标的下标
 
 	std::vector<glm::vec3> face_normals;	// 每个三角面片的法向量
+	std::vector<float> face_areas;			// 每个三角面片的面积，面积加权时使用
 
 	std::vector<glm::vec3> points;	// 传入着色器的绘制点
 	std::vector<glm::vec3> colors;	// 传入着色器的颜色
 	std::vector<glm::vec3> normals;	// 传入着色器的法向量
 	std::vector<glm::vec2> textures;	// 传入着色器的纹理坐标，注意是vec2
+	std::vector<unsigned int> indices;	// 索引模式下传入着色器的顶点下标
+
+	bool use_indices;			// 是否使用索引模式
+	NormalWeighting normal_weighting;	// 顶点法向量的加权方式
 
 	bool do_normalize_size;        // 是否将物体大小归一化
 	float diagonal_length;      // 物体包围盒对角线长度，作为物体归一化系数
@@ -123,6 +179,7 @@ protected:
 	glm::vec3 translation;			// 物体的平移参数
 	glm::vec3 rotation;				// 物体的旋转参数
 	glm::vec3 scale;					// 物体的缩放参数
+	unsigned int transform_version;	// 变换参数的修改次数
 
 	glm::vec4 ambient;				// 环境光
 	glm::vec4 diffuse;				// 漫反射
@@ -0,0 +1,50 @@
+#ifndef _UNIFORM_BLOCKS_H_
+#define _UNIFORM_BLOCKS_H_
+
+#include <glm/glm.hpp>
+
+// 着色器中 std140 uniform block 对应的 C++ 结构体，每帧整体上传一次
+// 成员顺序和补齐必须与 shaders/frame_data.glsl、shaders/lighting.glsl 中的声明保持一致
+
+// uniform block 的绑定点，ShaderCache 链接程序后按名字绑定
+enum UniformBlockBinding
+{
+	FRAME_BLOCK_BINDING = 0,
+	LIGHT_BLOCK_BINDING = 1,
+};
+
+// layout (std140) uniform FrameData
+struct FrameBlock
+{
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::mat4 lightSpaceMatrix;
+	glm::vec3 eyePos;
+	float padding;
+};
+
+// layout (std140) uniform LightData，vec3 后面紧跟一个 float 正好凑满 16 字节
+struct LightBlock
+{
+	glm::vec3 position;
+	float cutOff;
+	glm::vec3 direction;
+	float outerCutOff;
+	glm::vec3 ambient;
+	float constant;
+	glm::vec3 diffuse;
+	float linear;
+	glm::vec3 specular;
+	float quadratic;
+
+	glm::vec3 fillLight;
+	float roomAmbient;
+	float ambientBoost;
+	// 光源开关由着色器变体（LIGHT_ENABLED）决定，不再上传；补齐到 16 字节的倍数
+	float padding[3];
+};
+
+static_assert(sizeof(FrameBlock) == 208, "FrameBlock must match the std140 layout of FrameData");
+static_assert(sizeof(LightBlock) == 112, "LightBlock must match the std140 layout of LightData");
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef _VERTEX_FORMAT_H_
+#define _VERTEX_FORMAT_H_
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <stdint.h>
+
+// 压缩后的交错顶点格式，一个顶点 20 字节（原来四个 float 数组一共 44 字节）
+// 与 main.vs 中的顶点属性对应：
+//   position  location 0  int16 x4，相对包围盒中心按包围盒半边长量化到 [-32767, 32767]，w 只用于对齐
+//   color     location 2  unorm8 x4，只能表示 [0, 1]，超出范围的网格改用 float 格式（见 colorsFitUnorm8）
+//   texture   location 3  half x2
+//   normal    location 4  int16 x2，八面体映射编码的单位法向量，同样量化到 [-32767, 32767]
+struct PackedVertex
+{
+	int16_t position[4];
+	int16_t normal[2];
+	uint8_t color[4];
+	uint16_t texture[2];
+};
+
+// main.vs / depth.vs 中固定的顶点属性位置
+enum VertexAttribLocation
+{
+	ATTRIB_POSITION = 0,
+	ATTRIB_NORMAL = 1,
+	ATTRIB_COLOR = 2,
+	ATTRIB_TEXTURE = 3,
+	ATTRIB_NORMAL_OCT = 4,
+	// 实例化绘制时每个实例的模型矩阵，mat4 占用 6~9 四个位置，每列一个
+	ATTRIB_INSTANCE_MODEL = 6,
+	// 每个实例的法向量矩阵，mat3 占用 10~12 三个位置
+	ATTRIB_INSTANCE_NORMAL = 10,
+};
+
+// instanceVbo 中每个实例的数据。法向量矩阵在 CPU 上每个实例算一次，
+// 着色器不必对每个顶点求逆；每列补齐为 vec4，着色器只读前三个分量
+struct InstanceData
+{
+	glm::mat4 model;
+	glm::vec4 normal_matrix[3];
+};
+
+// 数值转换
+uint16_t floatToHalf(float value);
+float halfToFloat(uint16_t value);
+int16_t floatToSnorm16(float value);
+uint8_t floatToUnorm8(float value);
+
+// 单位法向量与八面体映射坐标（[-1, 1]^2）之间的互相转换
+glm::vec2 octEncode(const glm::vec3& normal);
+glm::vec3 octDecode(const glm::vec2& encoded);
+
+// 把 points 等数组打包成交错的压缩顶点
+// position_offset、position_scale 返回解码参数：原坐标 = 解码值 * position_scale + position_offset
+// normals、colors、textures 为空或数量不足时对应属性填 0
+void packVertices(const std::vector<glm::vec3>& points,
+	const std::vector<glm::vec3>& normals,
+	const std::vector<glm::vec3>& colors,
+	const std::vector<glm::vec2>& textures,
+	std::vector<PackedVertex>& packed,
+	glm::vec3& position_offset, glm::vec3& position_scale);
+
+// 所有颜色分量都在 [0, 1] 内时返回 true，否则打包会截断颜色，应使用 float 顶点格式
+bool colorsFitUnorm8(const std::vector<glm::vec3>& colors);
+
+#endif
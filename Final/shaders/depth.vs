@@ -1,9 +1,22 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
+#ifdef INSTANCED
+// per-instance model matrix, same layout as main.vs
+layout (location = 6) in mat4 aInstanceModel;
+#endif
 
 uniform mat4 lightSpaceMatrix;
 uniform mat4 model;
 
+uniform int packedVertex;
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
+
 void main() {
-    gl_Position = lightSpaceMatrix * model * vec4(aPos, 1.0);
+    vec3 position = packedVertex == 1 ? aPos * positionScale + positionOffset : aPos;
+#ifdef INSTANCED
+    gl_Position = lightSpaceMatrix * aInstanceModel * vec4(position, 1.0);
+#else
+    gl_Position = lightSpaceMatrix * model * vec4(position, 1.0);
+#endif
 }
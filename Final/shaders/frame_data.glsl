@@ -0,0 +1,9 @@
+// shared by main.vs and main.fs through #include (expanded by ReadShaderSource)
+
+// per-frame data, uploaded once per frame by MeshPainter::beginFrame (see UniformBlocks.h)
+layout (std140) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    mat4 lightSpaceMatrix;
+    vec3 eyePos;
+};
@@ -0,0 +1,23 @@
+// spotlight and ambient parameters shared by the lit fragment shaders
+
+// each vec3 is followed by a float so the std140 layout has no holes
+struct Light {
+    vec3 position;
+    float cutOff;
+    vec3 direction;
+    float outerCutOff;
+    vec3 ambient;
+    float constant;
+    vec3 diffuse;
+    float linear;
+    vec3 specular;
+    float quadratic;
+};
+
+layout (std140) uniform LightData {
+    Light light;
+    vec3 fillLight;
+    float roomAmbient;
+    float ambientBoost;
+    // whether the light is on is a shader variant (LIGHT_ENABLED), not a uniform
+};
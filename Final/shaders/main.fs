@@ -16,51 +16,89 @@ struct Material {
     float shininess;
 };
 
-struct Light {
-    vec3 position;
-    vec3 direction;
-    float cutOff;
-    float outerCutOff;
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-    float constant;
-    float linear;
-    float quadratic;
-};
+#include "frame_data.glsl"
+#include "lighting.glsl"
 
 uniform Material material;
-uniform Light light;
-uniform vec3 eyePos;
 uniform sampler2D diffuseMap;
-uniform sampler2D shadowMap;
-uniform int useTexture;
+uniform sampler2DShadow shadowMap;
 uniform vec2 uvScale;
-uniform float ambientBoost;
-uniform vec3 fillLight;
-uniform int lightEnabled;
-uniform float roomAmbient;
+
+// SHADOW_FILTER (set by MeshPainter from ShadowMap::getFilter, see ShadowMap.h):
+//   -1 no shadows, 0 one tap, 1 2x2 taps, 2 3x3 taps, 3 rotated Poisson disk
+// shadowMap uses GL_COMPARE_REF_TO_TEXTURE, so every tap returns the bilinearly
+// filtered result of four depth comparisons (1.0 = lit)
+#ifndef SHADOW_FILTER
+#define SHADOW_FILTER 2
+#endif
+
+#if SHADOW_FILTER == 3
+const vec2 poissonDisk[12] = vec2[](
+    vec2(-0.326, -0.406), vec2(-0.840, -0.074), vec2(-0.696,  0.457),
+    vec2(-0.203,  0.621), vec2( 0.962, -0.195), vec2( 0.473, -0.480),
+    vec2( 0.519,  0.767), vec2( 0.185, -0.893), vec2( 0.507,  0.064),
+    vec2( 0.896,  0.412), vec2(-0.322, -0.933), vec2(-0.792, -0.598)
+);
+#endif
 
 float ShadowCalculation(vec4 lightSpacePos, vec3 normal, vec3 lightDir) {
+#if SHADOW_FILTER < 0
+    return 0.0;
+#else
     vec3 projCoords = lightSpacePos.xyz / lightSpacePos.w;
     projCoords = projCoords * 0.5 + 0.5;
     if (projCoords.z > 1.0) {
         return 0.0;
     }
     float bias = max(0.005 * (1.0 - dot(normal, lightDir)), 0.0005);
-    float shadow = 0.0;
-    vec2 texelSize = 1.0 / textureSize(shadowMap, 0);
+    float ref = projCoords.z - bias;
+    vec2 texelSize = 1.0 / vec2(textureSize(shadowMap, 0));
+    float lit = 0.0;
+#if SHADOW_FILTER == 0
+    lit = texture(shadowMap, vec3(projCoords.xy, ref));
+#elif SHADOW_FILTER == 1
+    for (int x = 0; x < 2; ++x) {
+        for (int y = 0; y < 2; ++y) {
+            lit += texture(shadowMap, vec3(projCoords.xy + (vec2(x, y) - 0.5) * texelSize, ref));
+        }
+    }
+    lit /= 4.0;
+#elif SHADOW_FILTER == 2
     for (int x = -1; x <= 1; ++x) {
         for (int y = -1; y <= 1; ++y) {
-            float pcfDepth = texture(shadowMap, projCoords.xy + vec2(x, y) * texelSize).r;
-            shadow += (projCoords.z - bias) > pcfDepth ? 1.0 : 0.0;
+            lit += texture(shadowMap, vec3(projCoords.xy + vec2(x, y) * texelSize, ref));
         }
     }
-    shadow /= 9.0;
-    return shadow;
+    lit /= 9.0;
+#else
+    // rotate the disk per pixel so the banding turns into fine noise
+    float angle = 6.2831853 * fract(sin(dot(gl_FragCoord.xy, vec2(12.9898, 78.233))) * 43758.5453);
+    mat2 rotation = mat2(cos(angle), sin(angle), -sin(angle), cos(angle));
+    for (int i = 0; i < 12; ++i) {
+        lit += texture(shadowMap, vec3(projCoords.xy + rotation * poissonDisk[i] * 2.0 * texelSize, ref));
+    }
+    lit /= 12.0;
+#endif
+    return 1.0 - lit;
+#endif
 }
 
+// Variants are compiled by MeshPainter with these defines instead of branching on uniforms:
+//   USE_TEXTURE    sample diffuseMap for the base color, otherwise use the vertex color
+//   LIGHT_ENABLED  add the spotlight diffuse/specular terms and the shadow lookup
 void main() {
+#ifdef USE_TEXTURE
+    vec3 baseColor = texture(diffuseMap, fs_in.TexCoord * uvScale).rgb;
+#else
+    vec3 baseColor = fs_in.Color;
+#endif
+
+    vec3 ambient = roomAmbient * baseColor + light.ambient * material.ambient * baseColor + ambientBoost * baseColor + fillLight * baseColor;
+
+    float distance = length(light.position - fs_in.FragPos);
+    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * distance * distance);
+
+#ifdef LIGHT_ENABLED
     vec3 norm = normalize(fs_in.Normal);
     vec3 lightDir = normalize(light.position - fs_in.FragPos);
 
@@ -68,16 +106,6 @@ void main() {
     float theta = dot(lightDir, normalize(-light.direction));
     float epsilon = light.cutOff - light.outerCutOff;
     float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
-    if (lightEnabled == 0) {
-        intensity = 0.0;
-    }
-
-    vec3 baseColor = fs_in.Color;
-    if (useTexture == 1) {
-        baseColor = texture(diffuseMap, fs_in.TexCoord * uvScale).rgb;
-    }
-
-    vec3 ambient = roomAmbient * baseColor + light.ambient * material.ambient * baseColor + ambientBoost * baseColor + fillLight * baseColor;
 
     float diff = max(dot(norm, lightDir), 0.0);
     vec3 diffuse = light.diffuse * (diff * material.diffuse * baseColor);
@@ -87,12 +115,12 @@ void main() {
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
     vec3 specular = light.specular * (spec * material.specular);
 
-    float distance = length(light.position - fs_in.FragPos);
-    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * distance * distance);
-
     float shadow = ShadowCalculation(fs_in.LightSpacePos, norm, lightDir);
 
     vec3 lighting = ambient + (1.0 - shadow) * intensity * (diffuse + specular);
+#else
+    vec3 lighting = ambient;
+#endif
     lighting *= attenuation;
 
     FragColor = vec4(lighting, 1.0);
@@ -3,13 +3,25 @@ layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec3 aColor;
 layout (location = 3) in vec2 aTex;
+// octahedral-encoded normal used by the packed vertex format (see VertexFormat.h)
+layout (location = 4) in vec2 aNormalOct;
+#ifdef INSTANCED
+// per-instance model matrix (columns in locations 6-9) and normal matrix (10-12),
+// replace model/normalMatrix; the normal matrix is computed once per instance on the CPU
+layout (location = 6) in mat4 aInstanceModel;
+layout (location = 10) in mat3 aInstanceNormal;
+#endif
+
+#include "frame_data.glsl"
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
-uniform mat4 lightSpaceMatrix;
 uniform mat3 normalMatrix;
 
+// packed vertex format: aPos and aNormalOct hold quantized integers
+uniform int packedVertex;
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
+
 out VS_OUT {
     vec3 FragPos;
     vec3 Normal;
@@ -18,10 +30,33 @@ out VS_OUT {
     vec3 Color;
 } vs_out;
 
+vec3 octDecode(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
 void main() {
-    vec4 worldPos = model * vec4(aPos, 1.0);
+    vec3 position = aPos;
+    vec3 normal = aNormal;
+    if (packedVertex == 1) {
+        position = aPos * positionScale + positionOffset;
+        normal = octDecode(aNormalOct / 32767.0);
+    }
+
+#ifdef INSTANCED
+    mat4 modelMatrix = aInstanceModel;
+    mat3 normalMat = aInstanceNormal;
+#else
+    mat4 modelMatrix = model;
+    mat3 normalMat = normalMatrix;
+#endif
+
+    vec4 worldPos = modelMatrix * vec4(position, 1.0);
     vs_out.FragPos = worldPos.xyz;
-    vs_out.Normal = normalize(normalMatrix * aNormal);
+    vs_out.Normal = normalize(normalMat * normal);
     vs_out.TexCoord = aTex;
     vs_out.Color = aColor;
     vs_out.LightSpacePos = lightSpaceMatrix * worldPos;
@@ -1,6 +1,7 @@
 ﻿#include "Camera.h"
 
 Camera::Camera() { 
+	lastOrtho = false;
 	initCamera();
 	updateCamera(); 
 };
@@ -107,8 +108,8 @@ void Camera::updateCamera()
 	float eyey = radius * sin(upAngle * M_PI / 180.0);
 	float eyez = radius * cos(upAngle * M_PI / 180.0) * cos(rotateAngle * M_PI / 180.0);
 
-	eye = glm::vec4(eyex, eyey, eyez, 1.0);
-	at = glm::vec4(0.0, 0.0, 0.0, 1.0);
+	// 相机绕 at 旋转，at 默认为原点，可以直接修改（之后调用 markDirty）
+	eye = at + glm::vec4(eyex, eyey, eyez, 0.0);
 
 }
 
@@ -121,6 +122,8 @@ void Camera::initCamera(){
 	scale = 1.5;
 	zNear = 0.01;
 	zFar = 100.0;
+	at = glm::vec4(0.0, 0.0, 0.0, 1.0);
+	dirty = true;
 }
 
 void Camera::keyboard(int key, int action, int mode)
@@ -160,4 +163,59 @@ void Camera::keyboard(int key, int action, int mode)
 	// clamp radius to keep camera inside the room
 	if (radius < 0.8f) radius = 0.8f;
 	if (radius > 2.3f) radius = 2.3f;
+
+	// 下一帧重新计算矩阵
+	dirty = true;
+}
+
+void Camera::getPickRay(double x, double y, int width, int height, glm::vec3& origin, glm::vec3& direction) const
+{
+	// 窗口坐标转为标准化设备坐标，y 轴方向相反
+	float ndc_x = (float)(2.0 * x / width - 1.0);
+	float ndc_y = (float)(1.0 - 2.0 * y / height);
+
+	// 近平面和远平面上的两点反投影回世界坐标
+	glm::mat4 inverse = glm::inverse(viewProjMatrix);
+	glm::vec4 near_point = inverse * glm::vec4(ndc_x, ndc_y, -1.0f, 1.0f);
+	glm::vec4 far_point = inverse * glm::vec4(ndc_x, ndc_y, 1.0f, 1.0f);
+	origin = glm::vec3(near_point) / near_point.w;
+	direction = glm::normalize(glm::vec3(far_point) / far_point.w - origin);
+}
+
+bool Camera::beginFrame(bool isOrtho)
+{
+	if (!dirty && isOrtho == lastOrtho)
+		return false;
+
+	updateCamera();
+	viewMatrix = getViewMatrix();
+	projMatrix = getProjectionMatrix(isOrtho);
+	viewProjMatrix = projMatrix * viewMatrix;
+	updateFrustumPlanes();
+
+	dirty = false;
+	lastOrtho = isOrtho;
+	return true;
+}
+
+void Camera::updateFrustumPlanes()
+{
+	// Gribb-Hartmann 方法：裁剪空间中 -w <= x, y, z <= w，
+	// 用矩阵的第 4 行分别加减前三行就得到六个平面
+	const glm::mat4& m = viewProjMatrix;
+	for (int i = 0; i < 3; i++)
+	{
+		for (int side = 0; side < 2; side++)
+		{
+			float sign = side == 0 ? 1.0f : -1.0f;
+			glm::vec4 plane(m[0][3] + sign * m[0][i],
+				m[1][3] + sign * m[1][i],
+				m[2][3] + sign * m[2][i],
+				m[3][3] + sign * m[3][i]);
+			float length = sqrt(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+			if (length > 0.0f)
+				plane = plane / length;
+			frustumPlanes[i * 2 + side] = plane;
+		}
+	}
 }
@@ -1,99 +1,172 @@
 #include "Angel.h"
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
 
 namespace Angel {
 
-// Create a NULL-terminated string by reading the provided file
-static char*
-readShaderSource(const char* shaderFile)
-{
-	#ifdef __APPLE__	// for MacOS
-		FILE *fp;
-		fp = fopen(shaderFile, "r");
-	#else				// for windows
-		FILE *fp;
-		fopen_s(&fp, shaderFile, "r");
-	#endif
+namespace {
 
-    if ( fp == NULL ) { return NULL; }
+bool verbose_output = false;
 
-    fseek(fp, 0L, SEEK_END);
-    long size = ftell(fp);
+std::string directoryOf(const std::string& path)
+{
+    size_t slash = path.find_last_of("/\\");
+    return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+}
 
-    fseek(fp, 0L, SEEK_SET);
-    char* buf = new char[size + 1];
+// Append the file to out, replacing each  #include "name"  line with the
+// contents of name (resolved relative to the including file).
+bool expandShaderSource(const std::string& filename, std::string& out, std::vector<std::string>& stack)
+{
+    if (std::find(stack.begin(), stack.end(), filename) != stack.end()) {
+	std::cerr << "Recursive #include of " << filename << std::endl;
+	return false;
+    }
 
-    memset(buf, 0, size + 1);
+    MappedFile file;
+    if (!file.open(filename)) {
+	std::cerr << "Failed to read " << filename << std::endl;
+	return false;
+    }
 
-    fread(buf, 1, size, fp);
+    stack.push_back(filename);
+    const char* p = file.data();
+    const char* end = file.end();
+    int line = 1;
+    while (p < end) {
+	const char* eol = std::find(p, end, '\n');
+	const char* q = p;
+	while (q < eol && (*q == ' ' || *q == '\t'))
+	    q++;
+
+	if (eol - q >= 8 && strncmp(q, "#include", 8) == 0) {
+	    const char* open = std::find(q + 8, eol, '"');
+	    const char* close = open < eol ? std::find(open + 1, eol, '"') : eol;
+	    if (close >= eol) {
+		std::cerr << filename << ":" << line << ": malformed #include" << std::endl;
+		stack.pop_back();
+		return false;
+	    }
+	    // number the included lines from 1 so compiler messages match the included file
+	    out += "#line 1\n";
+	    if (!expandShaderSource(directoryOf(filename) + std::string(open + 1, close), out, stack)) {
+		stack.pop_back();
+		return false;
+	    }
+	    // keep compiler messages pointing at the right line of this file
+	    out += "#line " + std::to_string(line + 1) + "\n";
+	}
+	else {
+	    out.append(p, eol);
+	    out += '\n';
+	}
 
-    buf[size] = '\0';
-    fclose(fp);
+	p = eol < end ? eol + 1 : end;
+	line++;
+    }
+    stack.pop_back();
+    return true;
+}
 
-    return buf;
+GLuint compileShader(const char* source, GLenum type, const char* name)
+{
+    GLuint shader = glCreateShader( type );
+    glShaderSource( shader, 1, (const GLchar**) &source, NULL );
+    glCompileShader( shader );
+
+    GLint  compiled;
+    glGetShaderiv( shader, GL_COMPILE_STATUS, &compiled );
+    if ( !compiled ) {
+	std::cerr << name << " failed to compile:" << std::endl;
+	GLint  logSize;
+	glGetShaderiv( shader, GL_INFO_LOG_LENGTH, &logSize );
+	std::vector<char> logMsg(logSize > 0 ? logSize : 1, '\0');
+	glGetShaderInfoLog( shader, (GLsizei)logMsg.size(), NULL, logMsg.data() );
+	std::cerr << logMsg.data() << std::endl;
+	glDeleteShader( shader );
+	return 0;
+    }
+    return shader;
 }
 
+}
 
-// Create a GLSL program object from vertex and fragment shader files
-GLuint
-InitShader(const char* vShaderFile, const char* fShaderFile)
+// Read a shader file through a memory mapping and expand its #include lines
+bool
+ReadShaderSource(const char* shaderFile, std::string& source)
 {
-    struct Shader {
-	const char*  filename;
-	GLenum       type;
-	GLchar*      source;
-    }  shaders[2] = {
-	{ vShaderFile, GL_VERTEX_SHADER, NULL },
-	{ fShaderFile, GL_FRAGMENT_SHADER, NULL }
-    };
+    source.clear();
+    std::vector<std::string> stack;
+    return expandShaderSource(shaderFile, source, stack);
+}
 
-    GLuint program = glCreateProgram();
-    
-    for ( int i = 0; i < 2; ++i ) {
-	Shader& s = shaders[i];
-	s.source = readShaderSource( s.filename );
-	if ( shaders[i].source == NULL ) {
-	    std::cerr << "Failed to read " << s.filename << std::endl;
-	    exit( EXIT_FAILURE );
-	}
+void
+SetVerbose(bool verbose)
+{
+    verbose_output = verbose;
+}
+
+bool
+Verbose()
+{
+    return verbose_output;
+}
 
-	GLuint shader = glCreateShader( s.type );
-	glShaderSource( shader, 1, (const GLchar**) &s.source, NULL );
-	glCompileShader( shader );
-
-	GLint  compiled;
-	glGetShaderiv( shader, GL_COMPILE_STATUS, &compiled );
-	if ( !compiled ) {
-	    std::cerr << s.filename << " failed to compile:" << std::endl;
-	    GLint  logSize;
-	    glGetShaderiv( shader, GL_INFO_LOG_LENGTH, &logSize );
-	    char* logMsg = new char[logSize];
-	    glGetShaderInfoLog( shader, logSize, NULL, logMsg );
-	    std::cerr << logMsg << std::endl;
-	    delete [] logMsg;
-
-	    exit( EXIT_FAILURE );
-	}
 
-	delete [] s.source;
+// Create a GLSL program object from vertex and fragment shader source text.
+// Returns 0 (after printing the log) when compiling or linking fails.
+GLuint
+InitShaderSource(const char* vSource, const char* fSource,
+		 const char* vName, const char* fName, bool retrievableBinary)
+{
+    GLuint vShader = compileShader( vSource, GL_VERTEX_SHADER, vName );
+    GLuint fShader = vShader ? compileShader( fSource, GL_FRAGMENT_SHADER, fName ) : 0;
+    if ( !vShader || !fShader ) {
+	if ( vShader ) glDeleteShader( vShader );
+	return 0;
+    }
 
-	glAttachShader( program, shader );
+    GLuint program = glCreateProgram();
+    glAttachShader( program, vShader );
+    glAttachShader( program, fShader );
+
+    // glad is generated for 3.3, so the 4.1 entry point is looked up directly
+    if ( retrievableBinary ) {
+	typedef void (APIENTRYP ProgramParameteriProc)(GLuint, GLenum, GLint);
+	static ProgramParameteriProc programParameteri =
+	    (ProgramParameteriProc) glfwGetProcAddress( "glProgramParameteri" );
+	if ( programParameteri )
+	    programParameteri( program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE );
     }
 
     /* link  and error check */
     glLinkProgram(program);
 
+    // the shader objects are no longer needed once the program is linked
+    glDetachShader( program, vShader );
+    glDetachShader( program, fShader );
+    glDeleteShader( vShader );
+    glDeleteShader( fShader );
+
     GLint  linked;
     glGetProgramiv( program, GL_LINK_STATUS, &linked );
     if ( !linked ) {
-	std::cerr << "Shader program failed to link" << std::endl;
+	std::cerr << "Shader program failed to link (" << vName << " + " << fName << ")" << std::endl;
 	GLint  logSize;
 	glGetProgramiv( program, GL_INFO_LOG_LENGTH, &logSize);
-	char* logMsg = new char[logSize];
-	glGetProgramInfoLog( program, logSize, NULL, logMsg );
-	std::cerr << logMsg << std::endl;
-	delete [] logMsg;
-
-	exit( EXIT_FAILURE );
+	std::vector<char> logMsg(logSize > 0 ? logSize : 1, '\0');
+	glGetProgramInfoLog( program, (GLsizei)logMsg.size(), NULL, logMsg.data() );
+	std::cerr << logMsg.data() << std::endl;
+	glDeleteProgram( program );
+	return 0;
     }
 
     /* use program object */
@@ -102,4 +175,15 @@ InitShader(const char* vShaderFile, const char* fShaderFile)
     return program;
 }
 
+
+// Create a GLSL program object from vertex and fragment shader files
+GLuint
+InitShader(const char* vShaderFile, const char* fShaderFile)
+{
+    std::string vSource, fSource;
+    if ( !ReadShaderSource( vShaderFile, vSource ) || !ReadShaderSource( fShaderFile, fSource ) )
+	return 0;
+    return InitShaderSource( vSource.c_str(), fSource.c_str(), vShaderFile, fShaderFile );
+}
+
 }  // Close namespace Angel block
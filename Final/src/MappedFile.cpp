@@ -0,0 +1,200 @@
+#include "MappedFile.h"
+#include "Hash.h"
+
+#include <cstdio>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <sys/stat.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// 空文件无法映射，统一指向这个空串，调用方不需要特殊处理
+static const char empty_file[1] = { 0 };
+
+MappedFile::MappedFile() : data_(NULL), size_(0), opened_(false)
+{
+#ifdef _WIN32
+	file_handle_ = NULL;
+	mapping_handle_ = NULL;
+#endif
+}
+
+MappedFile::MappedFile(const std::string& filename) : MappedFile()
+{
+	open(filename);
+}
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+bool MappedFile::open(const std::string& filename)
+{
+	close();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file, &file_size)) {
+		CloseHandle(file);
+		return false;
+	}
+	size_ = (size_t)file_size.QuadPart;
+	if (size_ == 0) {
+		CloseHandle(file);
+		data_ = empty_file;
+		opened_ = true;
+		return true;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping == NULL) {
+		CloseHandle(file);
+		size_ = 0;
+		return false;
+	}
+	void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (view == NULL) {
+		CloseHandle(mapping);
+		CloseHandle(file);
+		size_ = 0;
+		return false;
+	}
+	file_handle_ = file;
+	mapping_handle_ = mapping;
+	data_ = (const char*)view;
+#else
+	int fd = ::open(filename.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		::close(fd);
+		return false;
+	}
+	size_ = (size_t)st.st_size;
+	if (size_ == 0) {
+		::close(fd);
+		data_ = empty_file;
+		opened_ = true;
+		return true;
+	}
+
+	void* view = mmap(NULL, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+	// 映射建立后文件描述符就可以关闭了
+	::close(fd);
+	if (view == MAP_FAILED) {
+		size_ = 0;
+		return false;
+	}
+	// 模型文件基本都是从头到尾顺序扫描，提示内核提前预读
+	madvise(view, size_, MADV_SEQUENTIAL);
+	data_ = (const char*)view;
+#endif
+
+	opened_ = true;
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (data_ != NULL && data_ != empty_file) {
+#ifdef _WIN32
+		UnmapViewOfFile(data_);
+		CloseHandle((HANDLE)mapping_handle_);
+		CloseHandle((HANDLE)file_handle_);
+		file_handle_ = NULL;
+		mapping_handle_ = NULL;
+#else
+		munmap((void*)data_, size_);
+#endif
+	}
+	data_ = NULL;
+	size_ = 0;
+	opened_ = false;
+}
+
+bool MappedFile::getFileInfo(const std::string& filename, uint64_t& size, int64_t& modify_time)
+{
+#ifdef _WIN32
+	struct _stat64 st;
+	if (_stat64(filename.c_str(), &st) != 0)
+		return false;
+#else
+	struct stat st;
+	if (stat(filename.c_str(), &st) != 0)
+		return false;
+#endif
+	size = (uint64_t)st.st_size;
+	modify_time = (int64_t)st.st_mtime;
+	return true;
+}
+
+bool MappedFile::hashFile(const std::string& filename, uint64_t& hash)
+{
+	MappedFile source;
+	if (!source.open(filename))
+		return false;
+	hash = hashBytes(source.data(), source.size());
+	return true;
+}
+
+AtomicFileWriter::AtomicFileWriter(const std::string& path)
+	: path_(path), temp_path_(path + ".tmp"), written_(0), committed_(false)
+{
+	out_.open(temp_path_.c_str(), std::ios::binary | std::ios::trunc);
+}
+
+AtomicFileWriter::~AtomicFileWriter()
+{
+	if (!committed_ && out_.is_open()) {
+		out_.close();
+		std::remove(temp_path_.c_str());
+	}
+}
+
+void AtomicFileWriter::write(const void* data, size_t size)
+{
+	out_.write((const char*)data, (std::streamsize)size);
+	written_ += size;
+}
+
+void AtomicFileWriter::align(size_t alignment)
+{
+	static const char padding[64] = { 0 };
+	while (written_ % alignment != 0) {
+		size_t count = (size_t)(alignment - written_ % alignment);
+		write(padding, count < sizeof(padding) ? count : sizeof(padding));
+	}
+}
+
+bool AtomicFileWriter::commit()
+{
+	if (!out_.is_open())
+		return false;
+	out_.close();
+	committed_ = true;
+	if (!out_) {
+		std::remove(temp_path_.c_str());
+		return false;
+	}
+	// Windows 上 rename 不能覆盖已有文件，先删除旧文件
+	std::remove(path_.c_str());
+	if (std::rename(temp_path_.c_str(), path_.c_str()) != 0) {
+		std::remove(temp_path_.c_str());
+		return false;
+	}
+	return true;
+}
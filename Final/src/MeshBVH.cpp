@@ -0,0 +1,336 @@
+#include "MeshBVH.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// SAH 分桶数与代价参数：遍历一个节点的代价按一次三角形求交的 1 倍计
+const int SAH_BIN_COUNT = 16;
+const float SAH_TRAVERSAL_COST = 1.0f;
+// 不超过这个数时，如果划分不比直接做叶子划算就停止；超过时总是继续划分
+const int MAX_LEAF_SIZE = 8;
+// 遍历栈的深度。每层最多压一个节点，建树时深度到这里就强制做叶子，遍历时栈不会溢出
+const int TRAVERSAL_STACK_SIZE = 64;
+// 批量求交时每个任务处理的射线数
+const size_t RAYS_PER_TASK = 256;
+
+struct Bounds
+{
+	glm::vec3 lo;
+	glm::vec3 hi;
+
+	Bounds() : lo(FLT_MAX), hi(-FLT_MAX) {}
+	void grow(const glm::vec3& p) { lo = glm::min(lo, p); hi = glm::max(hi, p); }
+	void grow(const glm::vec3& a, const glm::vec3& b) { lo = glm::min(lo, a); hi = glm::max(hi, b); }
+	float area() const
+	{
+		glm::vec3 d = hi - lo;
+		if (d.x < 0.0f || d.y < 0.0f || d.z < 0.0f)
+			return 0.0f;
+		return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+	}
+};
+
+// 射线与包围盒的 slab 测试，相交时 t_enter 为进入包围盒的位置
+inline bool intersectBounds(const glm::vec3& lo, const glm::vec3& hi, const glm::vec3& origin,
+	const glm::vec3& inv_dir, float t_max, float& t_enter)
+{
+	glm::vec3 t0 = (lo - origin) * inv_dir;
+	glm::vec3 t1 = (hi - origin) * inv_dir;
+	glm::vec3 t_small = glm::min(t0, t1);
+	glm::vec3 t_large = glm::max(t0, t1);
+	float t_near = std::max(std::max(t_small.x, t_small.y), std::max(t_small.z, 0.0f));
+	float t_far = std::min(std::min(t_large.x, t_large.y), std::min(t_large.z, t_max));
+	t_enter = t_near;
+	return t_near <= t_far;
+}
+
+// Möller-Trumbore 射线三角形求交，e1、e2 为预先算好的两条边
+inline bool intersectTriangle(const glm::vec3& origin, const glm::vec3& dir,
+	const glm::vec3& v0, const glm::vec3& e1, const glm::vec3& e2, float& t, float& u, float& v)
+{
+	glm::vec3 p = glm::cross(dir, e2);
+	float det = glm::dot(e1, p);
+	if (std::fabs(det) < 1e-12f)
+		return false;
+	float inv_det = 1.0f / det;
+
+	glm::vec3 s = origin - v0;
+	u = glm::dot(s, p) * inv_det;
+	if (u < 0.0f || u > 1.0f)
+		return false;
+	glm::vec3 q = glm::cross(s, e1);
+	v = glm::dot(dir, q) * inv_det;
+	if (v < 0.0f || u + v > 1.0f)
+		return false;
+	t = glm::dot(e2, q) * inv_det;
+	return true;
+}
+
+}
+
+MeshBVH::MeshBVH() : max_depth(0)
+{
+}
+
+void MeshBVH::clear()
+{
+	nodes.clear();
+	triangles.clear();
+	triangle_ids.clear();
+	max_depth = 0;
+}
+
+glm::vec3 MeshBVH::getBoundsMin() const { return nodes.empty() ? glm::vec3(0.0f) : nodes[0].bounds_min; }
+glm::vec3 MeshBVH::getBoundsMax() const { return nodes.empty() ? glm::vec3(0.0f) : nodes[0].bounds_max; }
+
+void MeshBVH::build(TriMesh* mesh)
+{
+	build(mesh->getVertexPositions(), mesh->getFaces());
+}
+
+void MeshBVH::build(const std::vector<glm::vec3>& positions, const std::vector<vec3i>& faces)
+{
+	clear();
+	if (faces.empty())
+		return;
+
+	std::vector<BuildTriangle> build_triangles(faces.size());
+	for (size_t i = 0; i < faces.size(); i++)
+	{
+		const glm::vec3& a = positions[faces[i].x];
+		const glm::vec3& b = positions[faces[i].y];
+		const glm::vec3& c = positions[faces[i].z];
+		BuildTriangle& tri = build_triangles[i];
+		tri.bounds_min = glm::min(a, glm::min(b, c));
+		tri.bounds_max = glm::max(a, glm::max(b, c));
+		tri.centroid = (tri.bounds_min + tri.bounds_max) * 0.5f;
+		tri.face = (int)i;
+	}
+
+	// 节点数最多为 2n - 1
+	nodes.reserve(faces.size() * 2);
+	buildNode(build_triangles, 0, (int)build_triangles.size(), 0);
+
+	// 按叶子顺序保存三角形
+	triangles.resize(faces.size() * 3);
+	triangle_ids.resize(faces.size());
+	for (size_t i = 0; i < build_triangles.size(); i++)
+	{
+		const vec3i& face = faces[build_triangles[i].face];
+		const glm::vec3& v0 = positions[face.x];
+		triangles[i * 3] = v0;
+		triangles[i * 3 + 1] = positions[face.y] - v0;
+		triangles[i * 3 + 2] = positions[face.z] - v0;
+		triangle_ids[i] = build_triangles[i].face;
+	}
+}
+
+int MeshBVH::buildNode(std::vector<BuildTriangle>& build_triangles, int begin, int end, int depth)
+{
+	// 子节点建立时 nodes 可能扩容，这里只记下标，不保存引用
+	int index = (int)nodes.size();
+	nodes.push_back(Node());
+
+	Bounds bounds, centroid_bounds;
+	for (int i = begin; i < end; i++)
+	{
+		bounds.grow(build_triangles[i].bounds_min, build_triangles[i].bounds_max);
+		centroid_bounds.grow(build_triangles[i].centroid);
+	}
+	nodes[index].bounds_min = bounds.lo;
+	nodes[index].bounds_max = bounds.hi;
+	if (depth > max_depth)
+		max_depth = depth;
+
+	int count = end - begin;
+	int best_axis = -1;
+	int best_split = 0;
+	float best_cost = FLT_MAX;
+	float parent_area = bounds.area();
+
+	// 到达遍历栈能支持的最大深度时不再划分，聚集在一起的几何体会得到一个较大的叶子
+	if (count > 1 && parent_area > 0.0f && depth < TRAVERSAL_STACK_SIZE)
+	{
+		for (int axis = 0; axis < 3; axis++)
+		{
+			float lo = centroid_bounds.lo[axis];
+			float extent = centroid_bounds.hi[axis] - lo;
+			float bin_scale = SAH_BIN_COUNT / extent;
+			// 中心几乎重合（非规格化数）时 bin_scale 溢出为无穷大，桶下标会变成 NaN，跳过这个轴
+			if (extent <= 0.0f || !(bin_scale < FLT_MAX))
+				continue;
+
+			Bounds bins[SAH_BIN_COUNT];
+			int bin_counts[SAH_BIN_COUNT] = { 0 };
+			for (int i = begin; i < end; i++)
+			{
+				int b = std::min(SAH_BIN_COUNT - 1, (int)((build_triangles[i].centroid[axis] - lo) * bin_scale));
+				bins[b].grow(build_triangles[i].bounds_min, build_triangles[i].bounds_max);
+				bin_counts[b]++;
+			}
+
+			// 从右往左累积，得到每个划分位置右侧的面积与数量
+			float right_area[SAH_BIN_COUNT];
+			int right_count[SAH_BIN_COUNT];
+			Bounds right;
+			int right_sum = 0;
+			for (int b = SAH_BIN_COUNT - 1; b > 0; b--)
+			{
+				right.grow(bins[b].lo, bins[b].hi);
+				right_sum += bin_counts[b];
+				right_area[b] = right.area();
+				right_count[b] = right_sum;
+			}
+
+			// 再从左往右扫描，划分位置 s 表示桶 [0, s) 在左、[s, BIN) 在右
+			Bounds left;
+			int left_sum = 0;
+			for (int s = 1; s < SAH_BIN_COUNT; s++)
+			{
+				left.grow(bins[s - 1].lo, bins[s - 1].hi);
+				left_sum += bin_counts[s - 1];
+				if (left_sum == 0 || right_count[s] == 0)
+					continue;
+				float cost = left.area() * left_sum + right_area[s] * right_count[s];
+				if (cost < best_cost)
+				{
+					best_cost = cost;
+					best_axis = axis;
+					best_split = s;
+				}
+			}
+		}
+	}
+
+	// 划分代价：遍历一次节点 + 两侧按面积比例的求交代价；叶子代价：全部三角形求交
+	bool make_leaf = best_axis < 0;
+	if (!make_leaf && count <= MAX_LEAF_SIZE)
+		make_leaf = SAH_TRAVERSAL_COST + best_cost / parent_area >= (float)count;
+
+	if (make_leaf)
+	{
+		nodes[index].right_or_first = begin;
+		nodes[index].count = count;
+		return index;
+	}
+
+	float lo = centroid_bounds.lo[best_axis];
+	float bin_scale = SAH_BIN_COUNT / (centroid_bounds.hi[best_axis] - lo);
+	BuildTriangle* middle = std::partition(&build_triangles[0] + begin, &build_triangles[0] + end,
+		[&](const BuildTriangle& tri) {
+			int b = std::min(SAH_BIN_COUNT - 1, (int)((tri.centroid[best_axis] - lo) * bin_scale));
+			return b < best_split;
+		});
+	int mid = (int)(middle - &build_triangles[0]);
+
+	// 左子节点紧跟在父节点之后
+	buildNode(build_triangles, begin, mid, depth + 1);
+	int right = buildNode(build_triangles, mid, end, depth + 1);
+	nodes[index].right_or_first = right;
+	nodes[index].count = 0;
+	return index;
+}
+
+bool MeshBVH::traverse(const Ray& ray, RayHit& hit, float t_max, bool any_hit) const
+{
+	if (nodes.empty())
+		return false;
+
+	const glm::vec3 origin = ray.origin;
+	const glm::vec3 dir = ray.direction;
+	const glm::vec3 inv_dir = ray.inverseDirection();
+
+	float t_best = std::min(t_max, hit.t);
+	float t_enter;
+	if (!intersectBounds(nodes[0].bounds_min, nodes[0].bounds_max, origin, inv_dir, t_best, t_enter))
+		return false;
+
+	int stack[TRAVERSAL_STACK_SIZE];
+	int stack_size = 0;
+	int node_index = 0;
+	bool found = false;
+
+	while (true)
+	{
+		const Node& node = nodes[node_index];
+		if (node.count > 0)
+		{
+			for (int i = node.right_or_first; i < node.right_or_first + node.count; i++)
+			{
+				float t, u, v;
+				if (intersectTriangle(origin, dir, triangles[i * 3], triangles[i * 3 + 1], triangles[i * 3 + 2], t, u, v)
+					&& t > 0.0f && t < t_best)
+				{
+					t_best = t;
+					hit.t = t;
+					hit.u = u;
+					hit.v = v;
+					hit.triangle = triangle_ids[i];
+					found = true;
+					if (any_hit)
+						return true;
+				}
+			}
+		}
+		else
+		{
+			// 先进入较近的子节点，较远的压栈；找到交点后 t_best 变小，远处的节点会被跳过
+			int left = node_index + 1;
+			int right = node.right_or_first;
+			float t_left, t_right;
+			bool hit_left = intersectBounds(nodes[left].bounds_min, nodes[left].bounds_max, origin, inv_dir, t_best, t_left);
+			bool hit_right = intersectBounds(nodes[right].bounds_min, nodes[right].bounds_max, origin, inv_dir, t_best, t_right);
+			if (hit_left && hit_right)
+			{
+				if (t_right < t_left)
+					std::swap(left, right);
+				stack[stack_size++] = right;
+				node_index = left;
+				continue;
+			}
+			if (hit_left || hit_right)
+			{
+				node_index = hit_left ? left : right;
+				continue;
+			}
+		}
+
+		if (stack_size == 0)
+			break;
+		node_index = stack[--stack_size];
+	}
+	return found;
+}
+
+bool MeshBVH::intersect(const Ray& ray, RayHit& hit, float t_max) const
+{
+	return traverse(ray, hit, t_max, false);
+}
+
+bool MeshBVH::occluded(const Ray& ray, float t_max) const
+{
+	RayHit hit;
+	return traverse(ray, hit, t_max, true);
+}
+
+void MeshBVH::intersect(const Ray* rays, size_t count, RayHit* hits) const
+{
+	size_t num_tasks = (count + RAYS_PER_TASK - 1) / RAYS_PER_TASK;
+	if (num_tasks <= 1)
+	{
+		for (size_t i = 0; i < count; i++)
+			traverse(rays[i], hits[i], FLT_MAX, false);
+		return;
+	}
+
+	// 每个任务处理一段连续的射线，相邻射线通常经过相同的节点，缓存命中率更高
+	ThreadPool::shared().parallelFor(num_tasks, [&](size_t task) {
+		size_t begin = task * RAYS_PER_TASK;
+		size_t end = std::min(count, begin + RAYS_PER_TASK);
+		for (size_t i = begin; i < end; i++)
+			traverse(rays[i], hits[i], FLT_MAX, false);
+	});
+}
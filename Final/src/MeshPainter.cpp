@@ -1,14 +1,147 @@
 #include "MeshPainter.h"
 
+#include "ShaderCache.h"
+#include "UniformBlocks.h"
+#include "TextureManager.h"
+
+#include <cstddef>
+
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
-MeshPainter::MeshPainter(){};
+// 绑定状态未知时使用的值，保证下一次绘制一定重新绑定
+static const GLuint UNKNOWN_BINDING = ~0u;
+
+MeshPainter::MeshPainter() : packed_vertices(true), frame_ubo(0), light_ubo(0), light_space_matrix(1.0f),
+	bound_vao(UNKNOWN_BINDING), bound_texture(UNKNOWN_BINDING), frustum_culling(true), frustum_valid(false),
+	shadow_map(NULL), variant_shadow_filter(SHADOW_FILTER_NONE),
+	depth_vshader("shaders/depth.vs"), depth_fshader("shaders/depth.fs"), depth_program(0),
+	depth_instanced_program(0), instances_uploaded(false) {};
 MeshPainter::~MeshPainter(){};
 
-std::vector<std::string> MeshPainter::getMeshNames(){ return mesh_names;};
-std::vector<TriMesh *> MeshPainter::getMeshes(){ return meshes;};
-std::vector<openGLObject> MeshPainter::getOpenGLObj(){ return opengl_objects;};
+const std::vector<std::string>& MeshPainter::getMeshNames() const { return mesh_names;};
+const std::vector<TriMesh *>& MeshPainter::getMeshes() const { return meshes;};
+const std::vector<openGLObject>& MeshPainter::getOpenGLObj() const { return opengl_objects;};
+
+void MeshPainter::setPackedVertices(bool packed){ packed_vertices = packed; };
+bool MeshPainter::getPackedVertices(){ return packed_vertices; };
+
+void MeshPainter::setSceneLighting(const SceneLighting& lighting){ scene_lighting = lighting; };
+const SceneLighting& MeshPainter::getSceneLighting() const { return scene_lighting; };
+void MeshPainter::setLightSpaceMatrix(const glm::mat4& matrix){ light_space_matrix = matrix; };
+
+void MeshPainter::setShadowMap(ShadowMap* shadow_map){
+	this->shadow_map = shadow_map;
+	if (shadow_map)
+		shadow_map->invalidateStatic();
+	updateShadowFilter();
+};
+
+void MeshPainter::setDepthShaders(const std::string &vshader, const std::string &fshader){
+	depth_vshader = vshader;
+	depth_fshader = fshader;
+	if (depth_program != 0)
+	{
+		ShaderCache::shared().release(depth_program);
+		depth_program = 0;
+	}
+	if (depth_instanced_program != 0)
+	{
+		ShaderCache::shared().release(depth_instanced_program);
+		depth_instanced_program = 0;
+	}
+};
+
+void MeshPainter::updateShadowFilter(){
+	int filter = shadow_map ? shadow_map->getFilter() : SHADOW_FILTER_NONE;
+	if (filter == variant_shadow_filter)
+		return;
+	// 过滤方式是编译进着色器的，换了之后所有变体都要按新的宏重新编译
+	variant_shadow_filter = filter;
+	for (size_t i = 0; i < opengl_objects.size(); i++)
+	{
+		openGLObject &object = opengl_objects[i];
+		for (int v = 0; v < SHADER_VARIANT_COUNT; v++)
+		{
+			if (object.variants[v] != 0)
+				ShaderCache::shared().release(object.variants[v]);
+			object.variants[v] = 0;
+		}
+		object.variant = -1;
+		selectVariant(object);
+	}
+};
+
+const RenderStats& MeshPainter::getFrameStats() const { return frame_stats; };
+void MeshPainter::resetFrameStats(){ frame_stats.reset(); };
+
+const MeshBVH& MeshPainter::getMeshBVH(int i){
+	if (mesh_bvhs.size() < meshes.size())
+		mesh_bvhs.resize(meshes.size(), NULL);
+	if (mesh_bvhs[i] == NULL)
+	{
+		mesh_bvhs[i] = new MeshBVH();
+		mesh_bvhs[i]->build(meshes[i]);
+	}
+	return *mesh_bvhs[i];
+};
+
+bool MeshPainter::intersectMesh(int i, const glm::mat4 &modelMatrix, const Ray &ray, RayHit &hit){
+	// 先用世界包围盒排除，大部分物体不需要求逆矩阵和遍历 BVH
+	glm::vec3 world_min, world_max;
+	meshes[i]->getWorldAABB(modelMatrix, world_min, world_max);
+	glm::vec3 inv_dir = ray.inverseDirection();
+	glm::vec3 t0 = (world_min - ray.origin) * inv_dir;
+	glm::vec3 t1 = (world_max - ray.origin) * inv_dir;
+	glm::vec3 t_small = glm::min(t0, t1);
+	glm::vec3 t_large = glm::max(t0, t1);
+	float t_near = std::max(std::max(t_small.x, t_small.y), std::max(t_small.z, 0.0f));
+	float t_far = std::min(std::min(t_large.x, t_large.y), std::min(t_large.z, hit.t));
+	if (t_near > t_far)
+		return false;
+
+	glm::mat4 inverse = glm::inverse(modelMatrix);
+	Ray local(glm::vec3(inverse * glm::vec4(ray.origin, 1.0f)), glm::vec3(inverse * glm::vec4(ray.direction, 0.0f)));
+	return getMeshBVH(i).intersect(local, hit);
+};
+
+int MeshPainter::pickMesh(const Ray &ray, RayHit &hit){
+	int picked = -1;
+	for (size_t i = 0; i < meshes.size(); i++)
+	{
+		if (intersectMesh((int)i, meshes[i]->getModelMatrix(), ray, hit))
+			picked = (int)i;
+	}
+	return picked;
+};
+
+void MeshPainter::setFrustumCulling(bool enabled){ frustum_culling = enabled; };
+bool MeshPainter::getFrustumCulling() const { return frustum_culling; };
+
+bool MeshPainter::isVisible(int i, const glm::mat4 &modelMatrix){
+	if (!frustum_culling || !frustum_valid)
+		return true;
+
+	glm::vec3 world_min, world_max;
+	meshes[i]->getWorldAABB(modelMatrix, world_min, world_max);
+	for (int p = 0; p < Camera::PLANE_COUNT; p++)
+	{
+		// 包围盒在平面法向量方向上最远的角点都在外侧，整个包围盒就在视锥外
+		const glm::vec4 &plane = frustum_planes[p];
+		glm::vec3 corner(plane.x >= 0.0f ? world_max.x : world_min.x,
+			plane.y >= 0.0f ? world_max.y : world_min.y,
+			plane.z >= 0.0f ? world_max.z : world_min.z);
+		if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f)
+			return false;
+	}
+	return true;
+};
+
+void MeshPainter::invalidateState(){
+	bound_vao = UNKNOWN_BINDING;
+	bound_texture = UNKNOWN_BINDING;
+	ShaderCache::shared().invalidateBoundProgram();
+};
 
 void MeshPainter::bindObjectAndData(TriMesh *mesh, openGLObject &object, const std::string &texture_image, const std::string &vshader, const std::string &fshader){
     // 初始化各种对象
@@ -22,9 +155,22 @@ void MeshPainter::bindObjectAndData(TriMesh *mesh, openGLObject &object, const s
 	glGenVertexArrays(1, &object.vao);  	// 分配1个顶点数组对象
 	glBindVertexArray(object.vao);  	// 绑定顶点数组对象
 
+	object.vertexCount = (GLsizei)points.size();
+	// unorm8 颜色会把 [0, 1] 以外的值截断，这样的网格保留 float 格式
+	object.packedVertices = packed_vertices && colorsFitUnorm8(colors);
+
 	// 创建并初始化顶点缓存对象
 	glGenBuffers(1, &object.vbo);
 	glBindBuffer(GL_ARRAY_BUFFER, object.vbo);
+	if (object.packedVertices)
+	{
+		// 交错的压缩格式，每个顶点 20 字节，解码参数在绘制时作为 uniform 传给着色器
+		std::vector<PackedVertex> packed;
+		packVertices(points, normals, colors, textures, packed, object.positionOffset, object.positionScale);
+		glBufferData(GL_ARRAY_BUFFER, packed.size() * sizeof(PackedVertex), packed.data(), GL_STATIC_DRAW);
+	}
+	else
+	{
     glBufferData(GL_ARRAY_BUFFER,
                  points.size() * sizeof(glm::vec3) +
                      normals.size() * sizeof(glm::vec3) +
@@ -40,186 +186,607 @@ void MeshPainter::bindObjectAndData(TriMesh *mesh, openGLObject &object, const s
     glBufferSubData(GL_ARRAY_BUFFER, (points.size() + normals.size()) * sizeof(glm::vec3), colors.size() * sizeof(glm::vec3), colors.data());
     // 绑定纹理数据
     glBufferSubData(GL_ARRAY_BUFFER, (points.size() + normals.size() + colors.size()) * sizeof(glm::vec3), textures.size() * sizeof(glm::vec2), textures.data());
+	}
 
+    // 索引模式下上传索引缓存，EBO 的绑定会记录在 VAO 中
+    const std::vector<unsigned int>& indices = mesh->getIndices();
+    object.ebo = 0;
+    object.instanceVbo = 0;
+    object.indexCount = (GLsizei)indices.size();
+    object.indexType = GL_UNSIGNED_INT;
+    if (!indices.empty())
+    {
+        glGenBuffers(1, &object.ebo);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, object.ebo);
+        // 顶点数不超过 65536 时用 16 位索引，索引缓存再减半
+        if (points.size() <= 65536)
+        {
+            std::vector<GLushort> short_indices(indices.begin(), indices.end());
+            object.indexType = GL_UNSIGNED_SHORT;
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, short_indices.size() * sizeof(GLushort), short_indices.data(), GL_STATIC_DRAW);
+        }
+        else
+        {
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+        }
+    }
+
+
+	object.shadowCaster = SHADOW_CASTER_STATIC;
+	object.shadowTransformVersion = mesh->getTransformVersion();
+	object.uvScale = glm::vec2(1.0f, 1.0f);
 
 	object.vshader = vshader;
 	object.fshader = fshader;
-	object.program = InitShader(object.vshader.c_str(), object.fshader.c_str());
-
+	// 着色器变体在 selectVariant 中第一次用到时才编译，相同的组合由所有物体共享
+	object.program = 0;
+	object.variant = -1;
+	for (int v = 0; v < SHADER_VARIANT_COUNT; v++)
+		object.variants[v] = 0;
+
+	// 顶点属性位置与 main.vs 中的 layout(location = ...) 一致
+	object.pLocation = ATTRIB_POSITION;
+	object.nLocation = ATTRIB_NORMAL;
+	object.cLocation = ATTRIB_COLOR;
+	object.tLocation = ATTRIB_TEXTURE;
+
+	if (object.packedVertices)
+	{
+		const GLsizei stride = sizeof(PackedVertex);
+		// 坐标和八面体法向量以整数读入，在着色器里乘以缩放系数还原
+		glEnableVertexAttribArray(object.pLocation);
+		glVertexAttribPointer(object.pLocation, 3, GL_SHORT, GL_FALSE, stride, BUFFER_OFFSET(offsetof(PackedVertex, position)));
+		glEnableVertexAttribArray(ATTRIB_NORMAL_OCT);
+		glVertexAttribPointer(ATTRIB_NORMAL_OCT, 2, GL_SHORT, GL_FALSE, stride, BUFFER_OFFSET(offsetof(PackedVertex, normal)));
+		glEnableVertexAttribArray(object.cLocation);
+		glVertexAttribPointer(object.cLocation, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, BUFFER_OFFSET(offsetof(PackedVertex, color)));
+		glEnableVertexAttribArray(object.tLocation);
+		glVertexAttribPointer(object.tLocation, 2, GL_HALF_FLOAT, GL_FALSE, stride, BUFFER_OFFSET(offsetof(PackedVertex, texture)));
+	}
+	else
+	{
     // 将顶点传入着色器
-	object.pLocation = glGetAttribLocation(object.program, "vPosition");
 	glEnableVertexAttribArray(object.pLocation);
 	glVertexAttribPointer(object.pLocation, 3, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(0));
 
     // 将法向量传入着色器
-	object.nLocation = glGetAttribLocation(object.program, "vNormal");
 	glEnableVertexAttribArray(object.nLocation);
 	glVertexAttribPointer(object.nLocation, 3, 
 		GL_FLOAT, GL_FALSE, 0, 
 		BUFFER_OFFSET( (points.size() )  * sizeof(glm::vec3)));
 
     // 将颜色传入着色器
-	object.cLocation = glGetAttribLocation(object.program, "vColor");
 	glEnableVertexAttribArray(object.cLocation);
 	glVertexAttribPointer(object.cLocation, 3, GL_FLOAT, GL_FALSE, 0, 
         BUFFER_OFFSET((points.size() + normals.size() ) * sizeof(glm::vec3)));
 
-	object.tLocation = glGetAttribLocation(object.program, "vTexture");
 	glEnableVertexAttribArray(object.tLocation);
 	glVertexAttribPointer(object.tLocation, 2, 
 		GL_FLOAT, GL_FALSE, 0, 
 		BUFFER_OFFSET( ( points.size() + colors.size() + normals.size())  * sizeof(glm::vec3)));
-
-
-	// 获得矩阵位置
-	object.modelLocation = glGetUniformLocation(object.program, "model");
-	object.viewLocation = glGetUniformLocation(object.program, "view");
-	object.projectionLocation = glGetUniformLocation(object.program, "projection");
-
-	object.shadowLocation = glGetUniformLocation(object.program, "isShadow");
+	}
 
     object.texture_image = texture_image;
-    // 读取纹理图片数
-    // 创建纹理的缓存对象
-    glGenTextures(1, &object.texture);
-    // 调用stb_image生成纹理
-    load_texture_STBImage(object.texture_image, object.texture);
-    // 传递纹理数据 将生成的纹理传给shader
-    glUniform1i(glGetUniformLocation(object.program, "texture"), 0);
-    // Clean up
-    glUseProgram(0);
+    // 读取纹理图片，多个物体使用同一张图片时共享同一个纹理对象
+    object.hasTexture = load_texture_STBImage(object.texture_image, object.texture);
 
+    // 按是否有纹理和光源开关选择着色器变体，并查好 uniform 位置
+    selectVariant(object);
+    // Clean up
     glBindVertexArray(0);
+    // 上面绑定了新的 VAO 和纹理，记录的绑定状态已经失效
+    invalidateState();
 
 
 };
 
-void MeshPainter::bindLightAndMaterial( TriMesh* mesh, openGLObject &object, Light* light, Camera* camera ) {
-    // 传递材质、光源、相机等数据给着色器
-    
-	// 传递相机的位置
-	glUniform3fv(glGetUniformLocation(object.program, "eye_position"), 1, &camera->eye[0]);
-
-	// 传递物体的材质
+void MeshPainter::bindMaterial( TriMesh* mesh, openGLObject &object ) {
+    // 传递物体的材质，位置都是绑定时查好的
 	glm::vec4 meshAmbient = mesh->getAmbient();
 	glm::vec4 meshDiffuse = mesh->getDiffuse();
 	glm::vec4 meshSpecular = mesh->getSpecular();
-	float meshShininess = mesh->getShininess();
 
-	glUniform4fv(glGetUniformLocation(object.program, "material.ambient"), 1, &meshAmbient[0]);
-	glUniform4fv(glGetUniformLocation(object.program, "material.diffuse"), 1, &meshDiffuse[0]);
-	glUniform4fv(glGetUniformLocation(object.program, "material.specular"), 1, &meshSpecular[0]);
-	glUniform1f(glGetUniformLocation(object.program, "material.shininess"), meshShininess);
+	glUniform3fv(object.materialAmbientLocation, 1, &meshAmbient[0]);
+	glUniform3fv(object.materialDiffuseLocation, 1, &meshDiffuse[0]);
+	glUniform3fv(object.materialSpecularLocation, 1, &meshSpecular[0]);
+	glUniform1f(object.materialShininessLocation, mesh->getShininess());
+}
+
+void MeshPainter::selectVariant( openGLObject &object, bool instanced ) {
+	int variant = (object.hasTexture ? SHADER_USE_TEXTURE : 0)
+		| (scene_lighting.lightEnabled ? SHADER_LIGHT_ENABLED : 0)
+		| (instanced ? SHADER_INSTANCED : 0);
+	if (variant == object.variant)
+		return;
+
+	// 有没有纹理、光源是否打开由 #define 决定，片元着色器中不再按 uniform 分支
+	if (object.variants[variant] == 0)
+	{
+		std::string defines;
+		if (variant & SHADER_USE_TEXTURE)
+			defines += "#define USE_TEXTURE\n";
+		if (variant & SHADER_LIGHT_ENABLED)
+			defines += "#define LIGHT_ENABLED\n";
+		if (variant & SHADER_INSTANCED)
+			defines += "#define INSTANCED\n";
+		defines += "#define SHADOW_FILTER " + std::to_string(variant_shadow_filter) + "\n";
+		object.variants[variant] = ShaderCache::shared().acquire(object.vshader, object.fshader, defines);
+	}
+	object.variant = variant;
+	object.program = object.variants[variant];
+
+	// uniform 位置在程序链接时已经全部查好，这里只是查表
+	// 相机、光源等每帧相同的数据在 uniform block 中，由 beginFrame 统一更新
+	const UniformTable& uniforms = ShaderCache::shared().getUniforms(object.program);
+
+	// 压缩格式的解码参数
+	object.packedLocation = uniforms.location("packedVertex");
+	object.positionOffsetLocation = uniforms.location("positionOffset");
+	object.positionScaleLocation = uniforms.location("positionScale");
 
+	// 获得矩阵位置
+	object.modelLocation = uniforms.location("model");
+	object.normalMatrixLocation = uniforms.location("normalMatrix");
+
+	object.uvScaleLocation = uniforms.location("uvScale");
+
+	// 材质
+	object.materialAmbientLocation = uniforms.location("material.ambient");
+	object.materialDiffuseLocation = uniforms.location("material.diffuse");
+	object.materialSpecularLocation = uniforms.location("material.specular");
+	object.materialShininessLocation = uniforms.location("material.shininess");
+
+	// 采样器对所有物体都一样，只在切换变体时设置
+	if (ShaderCache::shared().useProgram(object.program))
+		frame_stats.programChanges++;
+	glUniform1i(uniforms.location("diffuseMap"), 0);
+	glUniform1i(uniforms.location("shadowMap"), 1);
+}
+
+void MeshPainter::beginFrame(Light* light, Camera* camera) {
+    // 相机矩阵每帧最多计算一次，相机参数没有变化时直接使用缓存的矩阵
+	camera->beginFrame();
+	const glm::vec4* planes = camera->getFrustumPlanes();
+	for (int p = 0; p < Camera::PLANE_COUNT; p++)
+		frustum_planes[p] = planes[p];
+	frustum_valid = true;
+
+	// 上传后台解码完成的纹理，每帧只占用一小段时间
+	TextureManager::shared().processUploads();
+
+	// 两帧之间其它代码可能改变过绑定，每帧开始时重新绑定一次
+	invalidateState();
+
+	// 阴影贴图固定在 1 号纹理单元，0 号单元留给物体的纹理
+	updateShadowFilter();
+	if (shadow_map)
+	{
+		light_space_matrix = shadow_map->getLightSpaceMatrix();
+		glActiveTexture(GL_TEXTURE1);
+		glBindTexture(GL_TEXTURE_2D, shadow_map->getTexture());
+		glActiveTexture(GL_TEXTURE0);
+	}
+
+	FrameBlock frame;
+	frame.view = camera->viewMatrix;
+	frame.projection = camera->projMatrix;
+	frame.lightSpaceMatrix = light_space_matrix;
+	frame.eyePos = glm::vec3(camera->eye);
+	frame.padding = 0.0f;
 
 	// 传递光源信息
-	glm::vec4 lightAmbient = light->getAmbient();
-	glm::vec4 lightDiffuse = light->getDiffuse();
-	glm::vec4 lightSpecular = light->getSpecular();
-	glm::vec3 lightPosition = light->getTranslation();
-	glUniform4fv(glGetUniformLocation(object.program, "light.ambient"), 1, &lightAmbient[0]);
-	glUniform4fv(glGetUniformLocation(object.program, "light.diffuse"), 1, &lightDiffuse[0]);
-	glUniform4fv(glGetUniformLocation(object.program, "light.specular"), 1, &lightSpecular[0]);
-	glUniform3fv(glGetUniformLocation(object.program, "light.position"), 1, &lightPosition[0]);
-
-	glUniform1f(glGetUniformLocation(object.program, "light.constant"), light->getConstant());
-	glUniform1f(glGetUniformLocation(object.program, "light.linear"), light->getLinear());
-	glUniform1f(glGetUniformLocation(object.program, "light.quadratic"), light->getQuadratic());
+	LightBlock lighting;
+	lighting.position = light->getTranslation();
+	lighting.direction = scene_lighting.spotDirection;
+	lighting.cutOff = scene_lighting.cutOff;
+	lighting.outerCutOff = scene_lighting.outerCutOff;
+	lighting.ambient = glm::vec3(light->getAmbient());
+	lighting.diffuse = glm::vec3(light->getDiffuse());
+	lighting.specular = glm::vec3(light->getSpecular());
+	lighting.constant = light->getConstant();
+	lighting.linear = light->getLinear();
+	lighting.quadratic = light->getQuadratic();
+	lighting.fillLight = scene_lighting.fillLight;
+	lighting.roomAmbient = scene_lighting.roomAmbient;
+	lighting.ambientBoost = scene_lighting.ambientBoost;
+	lighting.padding[0] = lighting.padding[1] = lighting.padding[2] = 0.0f;
+
+	if (frame_ubo == 0)
+	{
+		glGenBuffers(1, &frame_ubo);
+		glBindBuffer(GL_UNIFORM_BUFFER, frame_ubo);
+		glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameBlock), NULL, GL_DYNAMIC_DRAW);
+		glGenBuffers(1, &light_ubo);
+		glBindBuffer(GL_UNIFORM_BUFFER, light_ubo);
+		glBufferData(GL_UNIFORM_BUFFER, sizeof(LightBlock), NULL, GL_DYNAMIC_DRAW);
+	}
 
+	// 每帧只上传这两次，之后所有物体的着色器都从绑定点读取
+	glBindBuffer(GL_UNIFORM_BUFFER, frame_ubo);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameBlock), &frame);
+	glBindBuffer(GL_UNIFORM_BUFFER, light_ubo);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(LightBlock), &lighting);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_BLOCK_BINDING, frame_ubo);
+	glBindBufferBase(GL_UNIFORM_BUFFER, LIGHT_BLOCK_BINDING, light_ubo);
 }
 
-void MeshPainter::addMesh( TriMesh* mesh, const std::string &name, const std::string &texture_image, const std::string &vshader, const std::string &fshader ){
-	mesh_names.push_back(name);
-    meshes.push_back(mesh);
+void MeshPainter::setShadowCaster(int i, ShadowCasterType type){
+	openGLObject &object = opengl_objects[i];
+	// 静态物体集合变化，缓存里可能多了或少了这个物体
+	if (shadow_map && (object.shadowCaster == SHADOW_CASTER_STATIC || type == SHADOW_CASTER_STATIC) && object.shadowCaster != type)
+		shadow_map->invalidateStatic();
+	object.shadowCaster = type;
+};
 
-    openGLObject object;
-    // 绑定openGL对象，并传递顶点属性的数据
-    bindObjectAndData(mesh, object, texture_image, vshader, fshader);
+ShadowCasterType MeshPainter::getShadowCaster(int i) const{
+	return opengl_objects[i].shadowCaster;
+};
 
-    opengl_objects.push_back(object);
+void MeshPainter::setTextureScale(int i, const glm::vec2 &scale){
+	opengl_objects[i].uvScale = scale;
+};
+
+void MeshPainter::useDepthProgram(){
+	if (depth_program == 0)
+	{
+		depth_program = ShaderCache::shared().acquire(depth_vshader, depth_fshader);
+		const UniformTable& uniforms = ShaderCache::shared().getUniforms(depth_program);
+		depth_light_location = uniforms.location("lightSpaceMatrix");
+		depth_model_location = uniforms.location("model");
+		depth_packed_location = uniforms.location("packedVertex");
+		depth_offset_location = uniforms.location("positionOffset");
+		depth_scale_location = uniforms.location("positionScale");
+	}
+
+	if (ShaderCache::shared().useProgram(depth_program))
+		frame_stats.programChanges++;
+	glUniformMatrix4fv(depth_light_location, 1, GL_FALSE, &shadow_map->getLightSpaceMatrix()[0][0]);
 };
 
-void MeshPainter::drawMesh(TriMesh* mesh, openGLObject &object, Light *light, Camera* camera){
-    
-    // 相机矩阵计算
-	camera->updateCamera();
-	camera->viewMatrix = camera->getViewMatrix();
-	camera->projMatrix = camera->getProjectionMatrix(false);
+void MeshPainter::useDepthInstancedProgram(){
+	if (depth_instanced_program == 0)
+	{
+		depth_instanced_program = ShaderCache::shared().acquire(depth_vshader, depth_fshader, "#define INSTANCED\n");
+		const UniformTable& uniforms = ShaderCache::shared().getUniforms(depth_instanced_program);
+		depth_instanced_light_location = uniforms.location("lightSpaceMatrix");
+		depth_instanced_packed_location = uniforms.location("packedVertex");
+		depth_instanced_offset_location = uniforms.location("positionOffset");
+		depth_instanced_scale_location = uniforms.location("positionScale");
+	}
 
+	if (ShaderCache::shared().useProgram(depth_instanced_program))
+		frame_stats.programChanges++;
+	glUniformMatrix4fv(depth_instanced_light_location, 1, GL_FALSE, &shadow_map->getLightSpaceMatrix()[0][0]);
+};
 
-	glBindVertexArray(object.vao);
+void MeshPainter::updateStaticShadows(){
+	// 和 Experiment3.2 的 shadowDirty 一样：静态物体的变换被修改过才重画缓存。
+	// 只比较版本号，不需要每帧重新计算各静态物体的模型矩阵
+	for (size_t i = 0; i < meshes.size(); i++)
+	{
+		if (opengl_objects[i].shadowCaster == SHADOW_CASTER_STATIC
+			&& opengl_objects[i].shadowTransformVersion != meshes[i]->getTransformVersion())
+		{
+			shadow_map->invalidateStatic();
+			break;
+		}
+	}
 
-	glUseProgram(object.program);
+	if (!shadow_map->beginStatic())
+		return;
+	useDepthProgram();
+	for (size_t i = 0; i < meshes.size(); i++)
+	{
+		if (opengl_objects[i].shadowCaster != SHADOW_CASTER_STATIC)
+			continue;
+		opengl_objects[i].shadowTransformVersion = meshes[i]->getTransformVersion();
+		drawShadowCaster((int)i, meshes[i]->getModelMatrix());
+	}
+	shadow_map->endStatic();
+};
 
-	// 物体的变换矩阵
-	glm::mat4 modelMatrix = mesh->getModelMatrix();
+void MeshPainter::beginShadowPass(){
+	if (!shadow_map)
+		return;
+
+	bool cached = shadow_map->getStaticCacheEnabled();
+	if (cached)
+		updateStaticShadows();
+
+	// 开启缓存时 begin 复制静态深度，否则清空后在这里画静态物体
+	shadow_map->begin();
+	useDepthProgram();
+	if (!cached)
+	{
+		for (size_t i = 0; i < meshes.size(); i++)
+		{
+			if (opengl_objects[i].shadowCaster == SHADOW_CASTER_STATIC)
+				drawShadowCaster((int)i, meshes[i]->getModelMatrix());
+		}
+	}
+};
 
-	// 传递矩阵
-	glUniformMatrix4fv(object.modelLocation, 1, GL_FALSE, &modelMatrix[0][0]);
-	glUniformMatrix4fv(object.viewLocation, 1, GL_FALSE, &camera->viewMatrix[0][0]);
-	glUniformMatrix4fv(object.projectionLocation, 1, GL_FALSE, &camera->projMatrix[0][0]);
-	// 将着色器 isShadow 设置为0，表示正常绘制的颜色，如果是1着表示阴影
-	glUniform1i(object.shadowLocation, 0);
+void MeshPainter::drawShadowCaster(int i, const glm::mat4 &modelMatrix){
+	if (!shadow_map || depth_program == 0)
+		return;
+
+	// 中间可能画过实例化的阴影，切换回普通的深度着色器，光源空间矩阵仍保留在程序中
+	if (ShaderCache::shared().useProgram(depth_program))
+		frame_stats.programChanges++;
+
+	// 深度绘制与正常绘制共用物体的 VAO，只读取位置属性
+	const openGLObject &object = opengl_objects[i];
+	if (object.vao != bound_vao)
+	{
+		glBindVertexArray(object.vao);
+		bound_vao = object.vao;
+		frame_stats.vaoChanges++;
+	}
 
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, object.texture);// 该语句必须，否则将只使用同一个纹理进行绘制
+	glUniformMatrix4fv(depth_model_location, 1, GL_FALSE, &modelMatrix[0][0]);
+	glUniform1i(depth_packed_location, object.packedVertices ? 1 : 0);
+	glUniform3fv(depth_offset_location, 1, &object.positionOffset[0]);
+	glUniform3fv(depth_scale_location, 1, &object.positionScale[0]);
 
-    
-	// 将材质和光源数据传递给着色器
-	// bindLightAndMaterial(mesh, object, light, camera);
-	// 绘制
-	glDrawArrays(GL_TRIANGLES, 0, mesh->getPoints().size());
+	if (object.ebo != 0)
+		glDrawElements(GL_TRIANGLES, object.indexCount, object.indexType, BUFFER_OFFSET(0));
+	else
+		glDrawArrays(GL_TRIANGLES, 0, object.vertexCount);
+	frame_stats.drawCalls++;
+};
 
+void MeshPainter::endShadowPass(){
+	if (shadow_map)
+		shadow_map->end();
+};
 
-	glBindVertexArray(0);
+void MeshPainter::drawShadowMap(){
+	beginShadowPass();
+	for (size_t i = 0; i < meshes.size(); i++)
+	{
+		if (opengl_objects[i].shadowCaster == SHADOW_CASTER_DYNAMIC)
+			drawShadowCaster((int)i, meshes[i]->getModelMatrix());
+	}
+	endShadowPass();
+};
 
-	glUseProgram(0);
+void MeshPainter::queueInstance(int i, const glm::mat4 &modelMatrix){
+	if (instance_lists.size() < opengl_objects.size())
+		instance_lists.resize(opengl_objects.size());
+	instance_lists[i].push_back(modelMatrix);
+	instances_uploaded = false;
+};
 
+void MeshPainter::uploadInstances(){
+	if (instances_uploaded)
+		return;
+
+	for (size_t i = 0; i < instance_lists.size(); i++)
+	{
+		const std::vector<glm::mat4> &instances = instance_lists[i];
+		if (instances.empty())
+			continue;
+
+		openGLObject &object = opengl_objects[i];
+		if (object.instanceVbo == 0)
+		{
+			// 实例属性记录在物体自己的 VAO 中，每个实例前进一个矩阵
+			glBindVertexArray(object.vao);
+			bound_vao = object.vao;
+			frame_stats.vaoChanges++;
+
+			glGenBuffers(1, &object.instanceVbo);
+			glBindBuffer(GL_ARRAY_BUFFER, object.instanceVbo);
+			for (int c = 0; c < 4; c++)
+			{
+				GLuint location = ATTRIB_INSTANCE_MODEL + c;
+				glEnableVertexAttribArray(location);
+				glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), BUFFER_OFFSET(c * sizeof(glm::vec4)));
+				glVertexAttribDivisor(location, 1);
+			}
+			for (int c = 0; c < 3; c++)
+			{
+				GLuint location = ATTRIB_INSTANCE_NORMAL + c;
+				glEnableVertexAttribArray(location);
+				glVertexAttribPointer(location, 3, GL_FLOAT, GL_FALSE, sizeof(InstanceData), BUFFER_OFFSET(sizeof(glm::mat4) + c * sizeof(glm::vec4)));
+				glVertexAttribDivisor(location, 1);
+			}
+		}
+
+		// 法向量矩阵每个实例算一次
+		instance_upload.resize(instances.size());
+		for (size_t j = 0; j < instances.size(); j++)
+		{
+			glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(instances[j])));
+			instance_upload[j].model = instances[j];
+			for (int c = 0; c < 3; c++)
+				instance_upload[j].normal_matrix[c] = glm::vec4(normalMatrix[c], 0.0f);
+		}
+
+		// 每帧重新分配整块缓存，驱动不需要等待上一帧对旧数据的绘制
+		glBindBuffer(GL_ARRAY_BUFFER, object.instanceVbo);
+		glBufferData(GL_ARRAY_BUFFER, instance_upload.size() * sizeof(InstanceData), instance_upload.data(), GL_STREAM_DRAW);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	instances_uploaded = true;
 };
 
+void MeshPainter::drawInstanceShadows(){
+	if (!shadow_map)
+		return;
+
+	uploadInstances();
+	useDepthInstancedProgram();
+	for (size_t i = 0; i < instance_lists.size(); i++)
+	{
+		const std::vector<glm::mat4> &instances = instance_lists[i];
+		const openGLObject &object = opengl_objects[i];
+		if (instances.empty() || object.shadowCaster == SHADOW_CASTER_NONE)
+			continue;
+
+		if (object.vao != bound_vao)
+		{
+			glBindVertexArray(object.vao);
+			bound_vao = object.vao;
+			frame_stats.vaoChanges++;
+		}
+
+		glUniform1i(depth_instanced_packed_location, object.packedVertices ? 1 : 0);
+		glUniform3fv(depth_instanced_offset_location, 1, &object.positionOffset[0]);
+		glUniform3fv(depth_instanced_scale_location, 1, &object.positionScale[0]);
+
+		if (object.ebo != 0)
+			glDrawElementsInstanced(GL_TRIANGLES, object.indexCount, object.indexType, BUFFER_OFFSET(0), (GLsizei)instances.size());
+		else
+			glDrawArraysInstanced(GL_TRIANGLES, 0, object.vertexCount, (GLsizei)instances.size());
+		frame_stats.drawCalls++;
+	}
+};
 
-void MeshPainter::drawMesh(int i, glm::mat4 modelMatrix, Light *light, Camera* camera){
-    
-	openGLObject &object = opengl_objects[i];
-    // 相机矩阵计算
-	camera->updateCamera();
-	camera->viewMatrix = camera->getViewMatrix();
-	camera->projMatrix = camera->getProjectionMatrix(false);
+void MeshPainter::flushInstances(){
+	// 剔除视锥外的实例，阴影 pass 已经用完整的列表画过，有实例被剔除时重新上传
+	for (size_t i = 0; i < instance_lists.size(); i++)
+	{
+		std::vector<glm::mat4> &instances = instance_lists[i];
+		size_t kept = 0;
+		for (size_t j = 0; j < instances.size(); j++)
+		{
+			if (isVisible((int)i, instances[j]))
+				instances[kept++] = instances[j];
+		}
+		if (kept < instances.size())
+		{
+			frame_stats.meshesCulled += (unsigned int)(instances.size() - kept);
+			instances.resize(kept);
+			instances_uploaded = false;
+		}
+		frame_stats.meshesDrawn += (unsigned int)kept;
+	}
+	uploadInstances();
+	// 每种物体一次绘制，实例的模型矩阵已经在 instanceVbo 中
+	for (size_t i = 0; i < instance_lists.size(); i++)
+	{
+		std::vector<glm::mat4> &instances = instance_lists[i];
+		if (instances.empty())
+			continue;
+		drawObject(meshes[i], opengl_objects[i], glm::mat4(1.0f), (GLsizei)instances.size());
+		instances.clear();
+	}
+	instances_uploaded = false;
+};
 
+void MeshPainter::addMesh( TriMesh* mesh, const std::string &name, const std::string &texture_image, const std::string &vshader, const std::string &fshader ){
+	mesh_names.push_back(name);
+    meshes.push_back(mesh);
 
-	glBindVertexArray(object.vao);
+    openGLObject object;
+    // 绑定openGL对象，并传递顶点属性的数据
+    bindObjectAndData(mesh, object, texture_image, vshader, fshader);
 
-	glUseProgram(object.program);
+    opengl_objects.push_back(object);
+    // 新的静态物体还不在缓存中
+    if (shadow_map)
+        shadow_map->invalidateStatic();
+};
 
-	// 传递矩阵
-	glUniformMatrix4fv(object.modelLocation, 1, GL_FALSE, &modelMatrix[0][0]);
-	glUniformMatrix4fv(object.viewLocation, 1, GL_FALSE, &camera->viewMatrix[0][0]);
-	glUniformMatrix4fv(object.projectionLocation, 1, GL_FALSE, &camera->projMatrix[0][0]);
-	// 将着色器 isShadow 设置为0，表示正常绘制的颜色，如果是1着表示阴影
-	glUniform1i(object.shadowLocation, 0);
+void MeshPainter::drawObject(TriMesh* mesh, openGLObject &object, const glm::mat4 &modelMatrix, GLsizei instance_count){
 
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, object.texture);// 该语句必须，否则将只使用同一个纹理进行绘制
+	// 光源开关变化后换用对应的着色器变体
+	selectVariant(object, instance_count > 0);
 
-    
-	// 将材质和光源数据传递给着色器
-	// bindLightAndMaterial(mesh, object, light, camera);
-	// 绘制
-	// drawMesh(meshes[i], opengl_objects[i], light, camera);
+	// 与上一次绘制相同的 VAO、程序、纹理不再重复绑定，绘制后也不解绑
+	if (object.vao != bound_vao)
+	{
+		glBindVertexArray(object.vao);
+		bound_vao = object.vao;
+		frame_stats.vaoChanges++;
+	}
 
-	glDrawArrays(GL_TRIANGLES, 0,  meshes[i]->getPoints().size());
+	if (ShaderCache::shared().useProgram(object.program))
+		frame_stats.programChanges++;
 
+	if (instance_count == 0)
+	{
+		// 法向量矩阵，物体有非均匀缩放时法向量不能直接用模型矩阵变换
+		// 实例化绘制时在 uploadInstances 中按每个实例的矩阵计算
+		glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(modelMatrix)));
 
-	glBindVertexArray(0);
+		// 传递矩阵
+		glUniformMatrix4fv(object.modelLocation, 1, GL_FALSE, &modelMatrix[0][0]);
+		glUniformMatrix3fv(object.normalMatrixLocation, 1, GL_FALSE, &normalMatrix[0][0]);
+	}
+	glUniform1i(object.packedLocation, object.packedVertices ? 1 : 0);
+	glUniform3fv(object.positionOffsetLocation, 1, &object.positionOffset[0]);
+	glUniform3fv(object.positionScaleLocation, 1, &object.positionScale[0]);
+	glUniform2fv(object.uvScaleLocation, 1, &object.uvScale[0]);
+
+	if (object.texture != bound_texture)
+	{
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, object.texture);// 该语句必须，否则将只使用同一个纹理进行绘制
+		bound_texture = object.texture;
+		frame_stats.textureChanges++;
+	}
 
-	glUseProgram(0);
+	// 将材质数据传递给着色器，光源和相机已经在 beginFrame 中上传
+	bindMaterial(mesh, object);
+	// 绘制
+	if (instance_count > 0)
+	{
+		if (object.ebo != 0)
+			glDrawElementsInstanced(GL_TRIANGLES, object.indexCount, object.indexType, BUFFER_OFFSET(0), instance_count);
+		else
+			glDrawArraysInstanced(GL_TRIANGLES, 0, object.vertexCount, instance_count);
+	}
+	else if (object.ebo != 0)
+		glDrawElements(GL_TRIANGLES, object.indexCount, object.indexType, BUFFER_OFFSET(0));
+	else
+		glDrawArrays(GL_TRIANGLES, 0, object.vertexCount);
+	frame_stats.drawCalls++;
+
+};
 
+void MeshPainter::drawMesh(TriMesh* mesh, openGLObject &object){
+	drawObject(mesh, object, mesh->getModelMatrix());
 };
+
+void MeshPainter::drawMesh(int i, const glm::mat4 &modelMatrix){
+	drawObject(meshes[i], opengl_objects[i], modelMatrix);
+};
+
 void MeshPainter::drawMeshes(Light *light, Camera* camera){
+    beginFrame(light, camera);
     for (int i = 0; i < meshes.size(); i++)
     {
-        drawMesh(meshes[i], opengl_objects[i], light, camera);
+        queueMesh(i, meshes[i]->getModelMatrix());
     }
+    flushQueue();
+};
+
+void MeshPainter::queueMesh(int i, const glm::mat4 &modelMatrix){
+	if (!isVisible(i, modelMatrix))
+	{
+		frame_stats.meshesCulled++;
+		return;
+	}
+	frame_stats.meshesDrawn++;
+
+	openGLObject &object = opengl_objects[i];
+	// 排序键中的程序必须是本帧实际使用的变体
+	selectVariant(object);
+	render_queue.push(object.program, object.texture, object.vao, i, modelMatrix);
+};
+
+void MeshPainter::flushQueue(){
+	// 程序、纹理、VAO 相同的物体排在一起，只在状态变化时绑定
+	render_queue.sort();
+	for (size_t i = 0; i < render_queue.size(); i++)
+	{
+		const DrawItem &item = render_queue[i];
+		drawObject(meshes[item.object], opengl_objects[item.object], item.modelMatrix);
+	}
+	render_queue.clear();
 };
 
 void MeshPainter::cleanMeshes(){
@@ -237,11 +804,50 @@ void MeshPainter::cleanMeshes(){
         glDeleteVertexArrays(1, &opengl_objects[i].vao);
 
         glDeleteBuffers(1, &opengl_objects[i].vbo);
-        glDeleteProgram(opengl_objects[i].program);
+        if (opengl_objects[i].ebo != 0)
+            glDeleteBuffers(1, &opengl_objects[i].ebo);
+        if (opengl_objects[i].instanceVbo != 0)
+            glDeleteBuffers(1, &opengl_objects[i].instanceVbo);
+        // 程序由所有使用它的物体共享，最后一个物体释放时才真正删除
+        for (int v = 0; v < SHADER_VARIANT_COUNT; v++)
+        {
+            if (opengl_objects[i].variants[v] != 0)
+                ShaderCache::shared().release(opengl_objects[i].variants[v]);
+        }
+        TextureManager::shared().release(opengl_objects[i].texture);
     }
 
+    for (size_t i = 0; i < mesh_bvhs.size(); i++)
+        delete mesh_bvhs[i];
+    mesh_bvhs.clear();
+
     meshes.clear();
     opengl_objects.clear();
+    render_queue.clear();
+    instance_lists.clear();
+    instances_uploaded = false;
+    if (shadow_map)
+        shadow_map->invalidateStatic();
+
+    if (depth_program != 0)
+    {
+        ShaderCache::shared().release(depth_program);
+        depth_program = 0;
+    }
+    if (depth_instanced_program != 0)
+    {
+        ShaderCache::shared().release(depth_instanced_program);
+        depth_instanced_program = 0;
+    }
+    // 删除的对象名可能被之后新建的对象复用
+    invalidateState();
+
+    if (frame_ubo != 0)
+    {
+        glDeleteBuffers(1, &frame_ubo);
+        glDeleteBuffers(1, &light_ubo);
+        frame_ubo = light_ubo = 0;
+    }
 };
 
 void MeshPainter::controlMesh(unsigned char key, int x, int y, const std::string &selected_mesh_name) {
@@ -249,75 +855,9 @@ void MeshPainter::controlMesh(unsigned char key, int x, int y, const std::string
 }
 
 
-void MeshPainter::load_texture_STBImage(const std::string& file_name, GLuint& m_texName)
+bool MeshPainter::load_texture_STBImage(const std::string& file_name, GLuint& m_texName)
 {
-	int width, height, channels = 0;
-	unsigned char *pixels = NULL;
-	stbi_set_flip_vertically_on_load(true);
-
-    // Try multiple possible paths to find the texture
-    const std::vector<std::string> searchPaths = {
-        file_name,
-        "Final/" + file_name,
-        "../" + file_name,
-        "../Final/" + file_name,
-        "../../Final/" + file_name,
-        "assets/textures/" + file_name,
-        "Final/assets/textures/" + file_name,
-        "../assets/textures/" + file_name
-    };
-
-    for (const auto& path : searchPaths) {
-        pixels = stbi_load(path.c_str(), &width, &height, &channels, 0);
-        if (pixels) {
-            std::cout << "Successfully loaded texture from: " << path << std::endl;
-            break;
-        }
-    }
-
-    if (!pixels) {
-        std::cerr << "Failed to load texture: " << file_name << " (tried multiple paths)" << std::endl;
-        return;
-    }
-
-
-	// 调整行对齐格式
-	if(width*channels%4!=0) glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-	GLenum format = GL_RGB;
-	// 设置通道格式
-	switch (channels){
-	case 1: format=GL_RED;break;
-	case 3: format=GL_RGB;break;
-	case 4: format=GL_RGBA;break;
-	default: format=GL_RGB;break;
-	}
-
-	// 绑定纹理对象
-	glBindTexture(GL_TEXTURE_2D, m_texName);
-
-	// 指定纹理的放大，缩小滤波，使用线性方式，即当图片放大的时候插值方式
-	// 将图片的rgb数据上传给opengl
-	glTexImage2D(
-		GL_TEXTURE_2D,	// 指定目标纹理，这个值必须是GL_TEXTURE_2D
-		0,				// 执行细节级别，0是最基本的图像级别，n表示第N级贴图细化级别
-		format,			// 纹理数据的颜色格式(GPU显存)
-		width,			// 宽度。早期的显卡不支持不规则的纹理，则宽度和高度必须是2^n
-		height,			// 高度。早期的显卡不支持不规则的纹理，则宽度和高度必须是2^n
-		0,				// 指定边框的宽度。必须为0
-		format,			// 像素数据的颜色格式(CPU内存)
-		GL_UNSIGNED_BYTE,	// 指定像素数据的数据类型
-		pixels			// 指定内存中指向图像数据的指针
-	);
-	
-	// 生成多级渐远纹理，多消耗1/3的显存，较小分辨率时获得更好的效果
-	// glGenerateMipmap(GL_TEXTURE_2D);
-
-	// 指定插值方法
-	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-
-	// 恢复初始对齐格式
-	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
-	// 释放图形内存
-	stbi_image_free(pixels);
+	// 路径解析、解码和多级渐远纹理的生成都在 TextureManager 中完成，同一张图片只读取一次
+	m_texName = TextureManager::shared().acquire(file_name);
+	return m_texName != 0;
 };
@@ -0,0 +1,48 @@
+#include "RenderQueue.h"
+
+#include <algorithm>
+
+namespace {
+
+struct KeyLess
+{
+	const std::vector<DrawItem>* items;
+	bool operator()(uint32_t a, uint32_t b) const { return (*items)[a].key < (*items)[b].key; }
+};
+
+}
+
+uint64_t RenderQueue::makeKey(GLuint program, GLuint texture, GLuint vao)
+{
+	// OpenGL 对象名一般从 1 开始连续分配，截断只会让极少数不同状态排在一起，不影响正确性
+	return ((uint64_t)(program & 0xFFFFF) << 44) |
+		((uint64_t)(texture & 0xFFFFF) << 24) |
+		(uint64_t)(vao & 0xFFFFFF);
+}
+
+void RenderQueue::clear()
+{
+	// 保留容量，每帧重新收集时不再分配内存
+	items.clear();
+	order.clear();
+}
+
+void RenderQueue::push(GLuint program, GLuint texture, GLuint vao, int object, const glm::mat4& modelMatrix)
+{
+	DrawItem item;
+	item.key = makeKey(program, texture, vao);
+	item.program = program;
+	item.texture = texture;
+	item.vao = vao;
+	item.object = object;
+	item.modelMatrix = modelMatrix;
+	order.push_back((uint32_t)items.size());
+	items.push_back(item);
+}
+
+void RenderQueue::sort()
+{
+	KeyLess less;
+	less.items = &items;
+	std::stable_sort(order.begin(), order.end(), less);
+}
@@ -0,0 +1,113 @@
+#include "SceneGraph.h"
+
+SceneGraph::SceneGraph() : first_dirty(0)
+{
+}
+
+int SceneGraph::addNode(int parent, const glm::vec3& translation, const glm::vec3& rotation, const glm::vec3& scale)
+{
+	int node = size();
+	// 父节点必须先添加，保证顺序扫描时父节点的世界矩阵已经算好
+	if (parent >= node)
+	{
+		std::cerr << "SceneGraph: parent " << parent << " of node " << node << " does not exist" << std::endl;
+		parent = NO_PARENT;
+	}
+
+	parents.push_back(parent);
+	translations.push_back(translation);
+	rotations.push_back(rotation);
+	scales.push_back(scale);
+	local_matrices.push_back(glm::mat4(1.0f));
+	world_matrices.push_back(glm::mat4(1.0f));
+	local_dirty.push_back(0);
+	world_dirty.push_back(0);
+	markDirty(node);
+	return node;
+}
+
+void SceneGraph::markDirty(int node)
+{
+	local_dirty[node] = 1;
+	if (node < first_dirty)
+		first_dirty = node;
+}
+
+void SceneGraph::setTranslation(int node, const glm::vec3& translation)
+{
+	if (translations[node] == translation)
+		return;
+	translations[node] = translation;
+	markDirty(node);
+}
+
+void SceneGraph::setRotation(int node, const glm::vec3& rotation)
+{
+	if (rotations[node] == rotation)
+		return;
+	rotations[node] = rotation;
+	markDirty(node);
+}
+
+void SceneGraph::setScale(int node, const glm::vec3& scale)
+{
+	if (scales[node] == scale)
+		return;
+	scales[node] = scale;
+	markDirty(node);
+}
+
+int SceneGraph::update()
+{
+	int count = 0;
+	int n = size();
+	// first_dirty 之前的节点都不受影响；之后的节点只有自己或父节点被修改时才重算，
+	// 父节点在前，所以 world_dirty 沿子树一路传下去
+	for (int i = first_dirty; i < n; i++)
+	{
+		int parent = parents[i];
+		bool parent_dirty = parent != NO_PARENT && world_dirty[parent];
+		if (!local_dirty[i] && !parent_dirty)
+		{
+			world_dirty[i] = 0;
+			continue;
+		}
+
+		if (local_dirty[i])
+		{
+			glm::mat4 local = glm::translate(glm::mat4(1.0f), translations[i]);
+			const glm::vec3& rotation = rotations[i];
+			if (rotation.z != 0.0f)
+				local = glm::rotate(local, glm::radians(rotation.z), glm::vec3(0.0f, 0.0f, 1.0f));
+			if (rotation.y != 0.0f)
+				local = glm::rotate(local, glm::radians(rotation.y), glm::vec3(0.0f, 1.0f, 0.0f));
+			if (rotation.x != 0.0f)
+				local = glm::rotate(local, glm::radians(rotation.x), glm::vec3(1.0f, 0.0f, 0.0f));
+			local_matrices[i] = glm::scale(local, scales[i]);
+			local_dirty[i] = 0;
+		}
+
+		world_matrices[i] = parent == NO_PARENT ? local_matrices[i] : world_matrices[parent] * local_matrices[i];
+		world_dirty[i] = 1;
+		count++;
+	}
+
+	// 清掉这一次的传递标记，下一次 update 只看新的修改
+	for (int i = first_dirty; i < n; i++)
+		world_dirty[i] = 0;
+	first_dirty = n;
+	return count;
+}
+
+void SceneGraph::clear()
+{
+	parents.clear();
+	translations.clear();
+	rotations.clear();
+	scales.clear();
+	local_matrices.clear();
+	world_matrices.clear();
+	local_dirty.clear();
+	world_dirty.clear();
+	first_dirty = 0;
+}
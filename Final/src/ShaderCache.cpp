@@ -0,0 +1,321 @@
+#include "ShaderCache.h"
+#include "MappedFile.h"
+#include "Hash.h"
+#include "UniformBlocks.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+// glad 按 OpenGL 3.3 生成，没有 4.1 的程序二进制接口，运行时通过 GLFW 查询
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+namespace {
+
+typedef void (APIENTRYP GetProgramBinaryProc)(GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, void* binary);
+typedef void (APIENTRYP ProgramBinaryProc)(GLuint program, GLenum binaryFormat, const void* binary, GLsizei length);
+
+GetProgramBinaryProc get_program_binary = NULL;
+ProgramBinaryProc program_binary = NULL;
+
+// 程序二进制缓存文件：文件头 + 驱动返回的二进制数据
+// source_hash 由展开 #include 后的源码和驱动信息计算，源码或驱动变化后缓存自动失效
+const char program_cache_magic[4] = { 'T', 'M', 'G', 'P' };
+const uint32_t program_cache_version = 1;
+
+struct ProgramCacheHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint64_t source_hash;
+	uint32_t binary_format;
+	uint32_t binary_length;
+};
+
+// 把变体的宏定义插到 #version 这一行之后（GLSL 要求 #version 位于最前面）
+void injectDefines(std::string& source, const std::string& defines)
+{
+	if (defines.empty())
+		return;
+	size_t position = 0;
+	size_t version = source.find("#version");
+	if (version != std::string::npos)
+	{
+		size_t eol = source.find('\n', version);
+		position = eol == std::string::npos ? source.size() : eol + 1;
+	}
+	source.insert(position, defines + "#line 2\n");
+}
+
+// 读取两个着色器、展开 #include 并插入 defines，计算内容哈希
+bool readProgramSources(const std::string& vshader, const std::string& fshader, const std::string& defines,
+	std::string& vsource, std::string& fsource, uint64_t& content_hash)
+{
+	if (!ReadShaderSource(vshader.c_str(), vsource) || !ReadShaderSource(fshader.c_str(), fsource))
+		return false;
+	injectDefines(vsource, defines);
+	injectDefines(fsource, defines);
+	content_hash = hashString(fsource, hashString(vsource, hashString(vshader)));
+	return true;
+}
+
+std::string programCachePath(const std::string& vshader, const std::string& fshader, const std::string& defines)
+{
+	char hash_text[17];
+	snprintf(hash_text, sizeof(hash_text), "%016llx", (unsigned long long)hashString(defines, hashString(fshader)));
+	return vshader + "." + hash_text + ".glbin";
+}
+
+// 同一份源码在不同显卡或驱动版本上得到的二进制不能通用
+std::string driverString()
+{
+	const char* vendor = (const char*)glGetString(GL_VENDOR);
+	const char* renderer = (const char*)glGetString(GL_RENDERER);
+	const char* version = (const char*)glGetString(GL_VERSION);
+	return std::string(vendor ? vendor : "") + "|" + (renderer ? renderer : "") + "|" + (version ? version : "");
+}
+
+GLuint loadProgramBinary(const std::string& path, uint64_t source_hash)
+{
+	MappedFile cache;
+	if (!cache.open(path) || cache.size() < sizeof(ProgramCacheHeader))
+		return 0;
+
+	ProgramCacheHeader header;
+	memcpy(&header, cache.data(), sizeof(header));
+	if (memcmp(header.magic, program_cache_magic, 4) != 0 || header.version != program_cache_version
+		|| header.source_hash != source_hash || header.binary_length > cache.size() - sizeof(header))
+		return 0;
+
+	GLuint program = glCreateProgram();
+	program_binary(program, header.binary_format, cache.data() + sizeof(header), (GLsizei)header.binary_length);
+	// 驱动更新后旧的二进制可能被拒绝，此时回退到编译
+	GLint linked = 0;
+	glGetProgramiv(program, GL_LINK_STATUS, &linked);
+	if (!linked)
+	{
+		glDeleteProgram(program);
+		return 0;
+	}
+	return program;
+}
+
+void saveProgramBinary(GLuint program, const std::string& path, uint64_t source_hash)
+{
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+		return;
+
+	std::vector<char> binary(length);
+	GLenum format = 0;
+	GLsizei written = 0;
+	get_program_binary(program, length, &written, &format, binary.data());
+	if (written <= 0)
+		return;
+
+	ProgramCacheHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, program_cache_magic, 4);
+	header.version = program_cache_version;
+	header.source_hash = source_hash;
+	header.binary_format = format;
+	header.binary_length = (uint32_t)written;
+
+	AtomicFileWriter writer(path);
+	if (!writer.isOpen())
+		return;
+	writer.write(&header, sizeof(header));
+	writer.write(binary.data(), written);
+	writer.commit();
+}
+
+}
+
+void UniformTable::build(GLuint program)
+{
+	locations.clear();
+
+	GLint count = 0, max_length = 0;
+	glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+	glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_length);
+	std::vector<GLchar> name(max_length > 0 ? max_length : 1);
+
+	for (GLint i = 0; i < count; i++)
+	{
+		GLsizei length = 0;
+		GLint size = 0;
+		GLenum type = 0;
+		glGetActiveUniform(program, (GLuint)i, (GLsizei)name.size(), &length, &size, &type, name.data());
+		std::string uniform_name(name.data(), length);
+		// uniform block 中的成员没有位置，由 UBO 统一更新
+		GLint location = glGetUniformLocation(program, uniform_name.c_str());
+		if (location < 0)
+			continue;
+		locations[uniform_name] = location;
+		// 数组以 "name[0]" 的形式返回，同时登记不带下标的名字
+		if (uniform_name.size() > 3 && uniform_name.compare(uniform_name.size() - 3, 3, "[0]") == 0)
+			locations[uniform_name.substr(0, uniform_name.size() - 3)] = location;
+	}
+}
+
+GLint UniformTable::location(const std::string& name) const
+{
+	std::unordered_map<std::string, GLint>::const_iterator it = locations.find(name);
+	return it != locations.end() ? it->second : -1;
+}
+
+ShaderCache::ShaderCache() : binary_cache_enabled(true), binary_support(-1), source_generation(0),
+	bound_program(INVALID_PROGRAM), program_switches(0), skipped_switches(0)
+{
+}
+
+ShaderCache& ShaderCache::shared()
+{
+	static ShaderCache cache;
+	return cache;
+}
+
+bool ShaderCache::binaryCacheAvailable()
+{
+	if (binary_support < 0)
+	{
+		get_program_binary = (GetProgramBinaryProc)glfwGetProcAddress("glGetProgramBinary");
+		program_binary = (ProgramBinaryProc)glfwGetProcAddress("glProgramBinary");
+		GLint formats = 0;
+		if (get_program_binary && program_binary)
+			glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+		binary_support = formats > 0 ? 1 : 0;
+	}
+	return binary_cache_enabled && binary_support > 0;
+}
+
+GLuint ShaderCache::acquire(const std::string& vshader, const std::string& fshader, const std::string& defines)
+{
+	std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+
+	std::string key = vshader + "|" + fshader + "|" + defines;
+	std::string vsource, fsource;
+	uint64_t content_hash = 0;
+
+	std::map<std::string, Entry>::iterator it = entries.find(key);
+	if (it != entries.end())
+	{
+		Entry& cached = it->second;
+		// 命中缓存时不读取文件，只有 reloadSources 之后才检查源码；文件读取失败时沿用旧程序
+		if (cached.generation == source_generation
+			|| !readProgramSources(vshader, fshader, defines, vsource, fsource, content_hash)
+			|| content_hash == cached.content_hash)
+		{
+			cached.generation = source_generation;
+			cached.ref_count++;
+			return cached.program;
+		}
+		// 源码变了：旧程序换一个键继续留给还在使用它的物体，release 时照常删除
+		char retired_text[16];
+		snprintf(retired_text, sizeof(retired_text), "#%u", cached.program);
+		std::string retired_key = key + retired_text;
+		program_keys[cached.program] = retired_key;
+		entries[retired_key] = cached;
+		entries.erase(it);
+	}
+	else if (!readProgramSources(vshader, fshader, defines, vsource, fsource, content_hash))
+		return 0;
+
+	Entry entry;
+	entry.program = 0;
+	entry.content_hash = content_hash;
+	entry.generation = source_generation;
+	std::string binary_path;
+	uint64_t binary_hash = 0;
+	if (binaryCacheAvailable())
+	{
+		binary_path = programCachePath(vshader, fshader, defines);
+		binary_hash = hashString(driverString(), content_hash);
+		entry.program = loadProgramBinary(binary_path, binary_hash);
+	}
+	bool from_binary = entry.program != 0;
+	if (from_binary)
+	{
+		glUseProgram(entry.program);
+	}
+	else
+	{
+		entry.program = InitShaderSource(vsource.c_str(), fsource.c_str(), vshader.c_str(), fshader.c_str(), !binary_path.empty());
+		if (entry.program == 0)
+			return 0;
+		if (!binary_path.empty())
+			saveProgramBinary(entry.program, binary_path, binary_hash);
+	}
+	entry.ref_count = 1;
+	entry.uniforms.build(entry.program);
+	bindUniformBlocks(entry.program);
+	// 新程序在上面已经绑定
+	bound_program = entry.program;
+	entries[key] = entry;
+	program_keys[entry.program] = key;
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+	if (Verbose())
+		printf("Shader program %u %s in %.2f ms: %s + %s (%d uniforms, %d cached)\n",
+			entry.program, from_binary ? "loaded from binary cache" : "compiled", seconds * 1000.0,
+			vshader.c_str(), fshader.c_str(), (int)entry.uniforms.size(), (int)entries.size());
+	return entry.program;
+}
+
+void ShaderCache::release(GLuint program)
+{
+	std::map<GLuint, std::string>::iterator key_it = program_keys.find(program);
+	if (key_it == program_keys.end())
+		return;
+
+	std::map<std::string, Entry>::iterator it = entries.find(key_it->second);
+	if (--it->second.ref_count > 0)
+		return;
+
+	if (bound_program == program)
+	{
+		glUseProgram(0);
+		bound_program = 0;
+	}
+	glDeleteProgram(program);
+	entries.erase(it);
+	program_keys.erase(key_it);
+}
+
+const UniformTable& ShaderCache::getUniforms(GLuint program) const
+{
+	std::map<GLuint, std::string>::const_iterator key_it = program_keys.find(program);
+	if (key_it == program_keys.end())
+		return empty_uniforms;
+	return entries.find(key_it->second)->second.uniforms;
+}
+
+void ShaderCache::bindUniformBlocks(GLuint program)
+{
+	GLuint frame_index = glGetUniformBlockIndex(program, "FrameData");
+	if (frame_index != GL_INVALID_INDEX)
+		glUniformBlockBinding(program, frame_index, FRAME_BLOCK_BINDING);
+	GLuint light_index = glGetUniformBlockIndex(program, "LightData");
+	if (light_index != GL_INVALID_INDEX)
+		glUniformBlockBinding(program, light_index, LIGHT_BLOCK_BINDING);
+}
+
+bool ShaderCache::useProgram(GLuint program)
+{
+	if (program == bound_program)
+	{
+		skipped_switches++;
+		return false;
+	}
+	glUseProgram(program);
+	bound_program = program;
+	program_switches++;
+	return true;
+}
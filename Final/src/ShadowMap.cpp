@@ -0,0 +1,183 @@
+#include "ShadowMap.h"
+
+#include <algorithm>
+#include <cmath>
+
+ShadowMap::ShadowMap(int resolution) : resolution(resolution), created_resolution(0),
+	filter(SHADOW_PCF_9), light_space_matrix(1.0f), static_cache_enabled(true), static_dirty(true),
+	framebuffer(0), depth_texture(0), static_framebuffer(0), static_texture(0), saved_framebuffer(0)
+{
+	saved_viewport[0] = saved_viewport[1] = saved_viewport[2] = saved_viewport[3] = 0;
+}
+
+ShadowMap::~ShadowMap()
+{
+	destroy();
+}
+
+void ShadowMap::setResolution(int resolution)
+{
+	this->resolution = resolution > 0 ? resolution : 1;
+}
+
+void ShadowMap::setLightSpaceMatrix(const glm::mat4& matrix)
+{
+	if (matrix != light_space_matrix)
+		static_dirty = true;
+	light_space_matrix = matrix;
+}
+
+void ShadowMap::setStaticCacheEnabled(bool enabled)
+{
+	if (enabled == static_cache_enabled)
+		return;
+	static_cache_enabled = enabled;
+	// 下一次 begin 时按新的设置重建（创建或删除静态缓存）
+	created_resolution = 0;
+}
+
+glm::mat4 ShadowMap::spotLightMatrix(const glm::vec3& position, const glm::vec3& direction,
+	float outerCutOffDegrees, float nearPlane, float farPlane)
+{
+	glm::vec3 dir = glm::normalize(direction);
+	// 光线接近竖直时换一个上方向，避免 lookAt 退化
+	glm::vec3 up = std::fabs(dir.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+	float fov = std::min(2.0f * outerCutOffDegrees + 10.0f, 170.0f);
+	glm::mat4 projection = glm::perspective(glm::radians(fov), 1.0f, nearPlane, farPlane);
+	glm::mat4 view = glm::lookAt(position, position + dir, up);
+	return projection * view;
+}
+
+void ShadowMap::create()
+{
+	destroy();
+
+	GLint max_size = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_size);
+	if (max_size > 0 && resolution > max_size)
+		resolution = max_size;
+
+	createTarget(framebuffer, depth_texture, true);
+	if (static_cache_enabled)
+		createTarget(static_framebuffer, static_texture, false);
+
+	created_resolution = resolution;
+	static_dirty = true;
+}
+
+void ShadowMap::createTarget(GLuint& target_framebuffer, GLuint& target_texture, bool compare)
+{
+	glGenTextures(1, &target_texture);
+	glBindTexture(GL_TEXTURE_2D, target_texture);
+	// 两张深度纹理格式相同，才能用 glBlitFramebuffer 直接复制深度
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, resolution, resolution, 0,
+		GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+	if (compare)
+	{
+		// 线性过滤 + 比较模式：一次采样得到周围 2x2 个深度比较结果的双线性插值
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+		// 阴影贴图范围以外按最远深度处理，即不在阴影中
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+		const GLfloat border[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+		glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, border);
+	}
+	else
+	{
+		// 静态缓存只作为复制的来源，不会被采样
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	}
+
+	GLint previous = 0;
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previous);
+	glGenFramebuffers(1, &target_framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, target_framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, target_texture, 0);
+	// 只写深度，没有颜色附件
+	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		std::cerr << "Shadow map framebuffer is incomplete (" << resolution << "x" << resolution << ")" << std::endl;
+	glBindFramebuffer(GL_FRAMEBUFFER, previous);
+}
+
+void ShadowMap::destroy()
+{
+	if (framebuffer != 0)
+		glDeleteFramebuffers(1, &framebuffer);
+	if (depth_texture != 0)
+		glDeleteTextures(1, &depth_texture);
+	if (static_framebuffer != 0)
+		glDeleteFramebuffers(1, &static_framebuffer);
+	if (static_texture != 0)
+		glDeleteTextures(1, &static_texture);
+	framebuffer = depth_texture = 0;
+	static_framebuffer = static_texture = 0;
+	created_resolution = 0;
+}
+
+void ShadowMap::bindTarget(GLuint target_framebuffer)
+{
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &saved_framebuffer);
+	glGetIntegerv(GL_VIEWPORT, saved_viewport);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, target_framebuffer);
+	glViewport(0, 0, resolution, resolution);
+	// 斜率相关的深度偏移，配合着色器中的 bias 减少阴影失真
+	glEnable(GL_POLYGON_OFFSET_FILL);
+	glPolygonOffset(1.1f, 4.0f);
+}
+
+void ShadowMap::restoreTarget()
+{
+	glDisable(GL_POLYGON_OFFSET_FILL);
+	glBindFramebuffer(GL_FRAMEBUFFER, saved_framebuffer);
+	glViewport(saved_viewport[0], saved_viewport[1], saved_viewport[2], saved_viewport[3]);
+}
+
+bool ShadowMap::beginStatic()
+{
+	if (framebuffer == 0 || created_resolution != resolution)
+		create();
+	if (!static_cache_enabled || !static_dirty)
+		return false;
+
+	bindTarget(static_framebuffer);
+	glClear(GL_DEPTH_BUFFER_BIT);
+	return true;
+}
+
+void ShadowMap::endStatic()
+{
+	restoreTarget();
+	static_dirty = false;
+}
+
+void ShadowMap::begin()
+{
+	if (framebuffer == 0 || created_resolution != resolution)
+		create();
+
+	bindTarget(framebuffer);
+	if (static_cache_enabled && static_framebuffer != 0)
+	{
+		// 用缓存的静态深度代替清空，之后只需叠加动态物体
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, static_framebuffer);
+		glBlitFramebuffer(0, 0, resolution, resolution, 0, 0, resolution, resolution,
+			GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	}
+	else
+	{
+		glClear(GL_DEPTH_BUFFER_BIT);
+	}
+}
+
+void ShadowMap::end()
+{
+	restoreTarget();
+}
@@ -0,0 +1,356 @@
+#include "TextureCache.h"
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+// 缓存文件格式：文件头 + 每一级的尺寸与偏移 + 按 16 字节对齐的各级数据
+// 与模型缓存一样，文件头记录源文件的大小、修改时间和内容哈希，用于判断缓存是否过期
+namespace {
+
+bool texture_cache_enabled = true;
+
+const char texture_cache_magic[4] = { 'T', 'M', 'T', 'X' };
+const uint32_t texture_cache_version = 1;
+
+struct TextureCacheHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t format;
+	uint32_t width;
+	uint32_t height;
+	uint32_t level_count;
+	uint64_t source_size;
+	int64_t source_mtime;
+	uint64_t source_hash;
+};
+
+uint64_t levelSize(uint32_t format, uint32_t width, uint32_t height)
+{
+	if (format == TEXTURE_DATA_BC1)
+		return (uint64_t)((width + 3) / 4) * ((height + 3) / 4) * 8;
+	return (uint64_t)width * height * 4;
+}
+
+// 4x4 块中 RGB 的主方向，用幂迭代求协方差矩阵的最大特征向量
+void principalAxis(const float colors[16][3], const float mean[3], float axis[3])
+{
+	float cov[6] = { 0, 0, 0, 0, 0, 0 };
+	for (int i = 0; i < 16; i++)
+	{
+		float r = colors[i][0] - mean[0], g = colors[i][1] - mean[1], b = colors[i][2] - mean[2];
+		cov[0] += r * r; cov[1] += r * g; cov[2] += r * b;
+		cov[3] += g * g; cov[4] += g * b; cov[5] += b * b;
+	}
+	float v[3] = { 1.0f, 1.0f, 1.0f };
+	for (int iter = 0; iter < 8; iter++)
+	{
+		float x = cov[0] * v[0] + cov[1] * v[1] + cov[2] * v[2];
+		float y = cov[1] * v[0] + cov[3] * v[1] + cov[4] * v[2];
+		float z = cov[2] * v[0] + cov[4] * v[1] + cov[5] * v[2];
+		float m = std::max(std::fabs(x), std::max(std::fabs(y), std::fabs(z)));
+		if (m < 1e-6f)
+			break;
+		v[0] = x / m; v[1] = y / m; v[2] = z / m;
+	}
+	axis[0] = v[0]; axis[1] = v[1]; axis[2] = v[2];
+}
+
+uint16_t packRGB565(const float c[3])
+{
+	int r = (int)std::floor(std::min(std::max(c[0], 0.0f), 255.0f) * 31.0f / 255.0f + 0.5f);
+	int g = (int)std::floor(std::min(std::max(c[1], 0.0f), 255.0f) * 63.0f / 255.0f + 0.5f);
+	int b = (int)std::floor(std::min(std::max(c[2], 0.0f), 255.0f) * 31.0f / 255.0f + 0.5f);
+	return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+void unpackRGB565(uint16_t c, int out[3])
+{
+	int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+	out[0] = (r << 3) | (r >> 2);
+	out[1] = (g << 2) | (g >> 4);
+	out[2] = (b << 3) | (b >> 2);
+}
+
+// 2x2 盒式滤波缩小一级，奇数尺寸时最后一行/列重复采样
+void downsample(const unsigned char* src, uint32_t width, uint32_t height, unsigned char* dst, uint32_t dst_width, uint32_t dst_height)
+{
+	for (uint32_t y = 0; y < dst_height; y++)
+	{
+		uint32_t y0 = std::min(y * 2, height - 1), y1 = std::min(y * 2 + 1, height - 1);
+		for (uint32_t x = 0; x < dst_width; x++)
+		{
+			uint32_t x0 = std::min(x * 2, width - 1), x1 = std::min(x * 2 + 1, width - 1);
+			for (int k = 0; k < 4; k++)
+			{
+				unsigned int sum = src[(y0 * width + x0) * 4 + k] + src[(y0 * width + x1) * 4 + k]
+					+ src[(y1 * width + x0) * 4 + k] + src[(y1 * width + x1) * 4 + k];
+				dst[(y * dst_width + x) * 4 + k] = (unsigned char)((sum + 2) / 4);
+			}
+		}
+	}
+}
+
+void compressLevel(const unsigned char* rgba, uint32_t width, uint32_t height, unsigned char* out)
+{
+	unsigned char block[64];
+	for (uint32_t by = 0; by < height; by += 4)
+	{
+		for (uint32_t bx = 0; bx < width; bx += 4)
+		{
+			// 不满 4x4 的边缘块重复最后一行/列
+			for (uint32_t y = 0; y < 4; y++)
+			{
+				uint32_t sy = std::min(by + y, height - 1);
+				for (uint32_t x = 0; x < 4; x++)
+				{
+					uint32_t sx = std::min(bx + x, width - 1);
+					memcpy(block + (y * 4 + x) * 4, rgba + (sy * width + sx) * 4, 4);
+				}
+			}
+			encodeBC1Block(block, out);
+			out += 8;
+		}
+	}
+}
+
+}
+
+void setTextureCacheEnabled(bool enabled) { texture_cache_enabled = enabled; }
+bool getTextureCacheEnabled() { return texture_cache_enabled; }
+
+std::string textureCachePath(const std::string& filename) { return filename + ".tmtex"; }
+
+void encodeBC1Block(const unsigned char* rgba, unsigned char* out)
+{
+	float colors[16][3];
+	float mean[3] = { 0, 0, 0 };
+	for (int i = 0; i < 16; i++)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			colors[i][k] = rgba[i * 4 + k];
+			mean[k] += colors[i][k] / 16.0f;
+		}
+	}
+
+	// 把颜色投影到主方向上，取两端作为端点，再向内收缩 1/16 减小量化误差
+	float axis[3];
+	principalAxis(colors, mean, axis);
+	float min_t = 1e30f, max_t = -1e30f;
+	for (int i = 0; i < 16; i++)
+	{
+		float t = (colors[i][0] - mean[0]) * axis[0] + (colors[i][1] - mean[1]) * axis[1] + (colors[i][2] - mean[2]) * axis[2];
+		min_t = std::min(min_t, t);
+		max_t = std::max(max_t, t);
+	}
+	float inset = (max_t - min_t) / 16.0f;
+	min_t += inset;
+	max_t -= inset;
+	float length2 = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+	if (length2 > 0.0f)
+	{
+		min_t /= length2;
+		max_t /= length2;
+	}
+	float end0[3], end1[3];
+	for (int k = 0; k < 3; k++)
+	{
+		end0[k] = mean[k] + axis[k] * max_t;
+		end1[k] = mean[k] + axis[k] * min_t;
+	}
+
+	uint16_t c0 = packRGB565(end0), c1 = packRGB565(end1);
+	// c0 > c1 时是四色模式，c0 <= c1 时是带透明色的三色模式
+	if (c0 < c1)
+		std::swap(c0, c1);
+
+	uint32_t indices = 0;
+	if (c0 != c1)
+	{
+		int palette[4][3];
+		unpackRGB565(c0, palette[0]);
+		unpackRGB565(c1, palette[1]);
+		for (int k = 0; k < 3; k++)
+		{
+			palette[2][k] = (2 * palette[0][k] + palette[1][k]) / 3;
+			palette[3][k] = (palette[0][k] + 2 * palette[1][k]) / 3;
+		}
+		for (int i = 0; i < 16; i++)
+		{
+			int best = 0, best_error = 0x7FFFFFFF;
+			for (int p = 0; p < 4; p++)
+			{
+				int dr = rgba[i * 4] - palette[p][0], dg = rgba[i * 4 + 1] - palette[p][1], db = rgba[i * 4 + 2] - palette[p][2];
+				int error = dr * dr + dg * dg + db * db;
+				if (error < best_error)
+				{
+					best_error = error;
+					best = p;
+				}
+			}
+			indices |= (uint32_t)best << (i * 2);
+		}
+	}
+
+	out[0] = (unsigned char)(c0 & 0xFF);
+	out[1] = (unsigned char)(c0 >> 8);
+	out[2] = (unsigned char)(c1 & 0xFF);
+	out[3] = (unsigned char)(c1 >> 8);
+	out[4] = (unsigned char)(indices & 0xFF);
+	out[5] = (unsigned char)((indices >> 8) & 0xFF);
+	out[6] = (unsigned char)((indices >> 16) & 0xFF);
+	out[7] = (unsigned char)(indices >> 24);
+}
+
+void buildTextureData(const unsigned char* pixels, int width, int height, int channels, bool compress, TextureData& out)
+{
+	// 统一展开为 RGBA，灰度图复制到三个通道
+	std::vector<unsigned char> level((size_t)width * height * 4);
+	bool opaque = true;
+	for (size_t i = 0; i < (size_t)width * height; i++)
+	{
+		const unsigned char* p = pixels + i * channels;
+		unsigned char* q = &level[i * 4];
+		switch (channels)
+		{
+		case 1: q[0] = q[1] = q[2] = p[0]; q[3] = 255; break;
+		case 2: q[0] = q[1] = q[2] = p[0]; q[3] = p[1]; break;
+		case 3: q[0] = p[0]; q[1] = p[1]; q[2] = p[2]; q[3] = 255; break;
+		default: q[0] = p[0]; q[1] = p[1]; q[2] = p[2]; q[3] = p[3]; break;
+		}
+		if (q[3] != 255)
+			opaque = false;
+	}
+
+	out.format = compress && opaque ? TEXTURE_DATA_BC1 : TEXTURE_DATA_RGBA8;
+	out.channels = 4;
+	out.width = (uint32_t)width;
+	out.height = (uint32_t)height;
+	out.levels.clear();
+	out.data.clear();
+
+	uint32_t w = out.width, h = out.height;
+	std::vector<unsigned char> next;
+	for (;;)
+	{
+		TextureLevel info;
+		info.width = w;
+		info.height = h;
+		info.offset = out.data.size();
+		info.size = levelSize(out.format, w, h);
+		out.data.resize(info.offset + info.size);
+		if (out.format == TEXTURE_DATA_BC1)
+			compressLevel(level.data(), w, h, &out.data[info.offset]);
+		else
+			memcpy(&out.data[info.offset], level.data(), info.size);
+		out.levels.push_back(info);
+
+		if (w == 1 && h == 1)
+			break;
+		uint32_t next_w = std::max(w / 2, 1u), next_h = std::max(h / 2, 1u);
+		next.resize((size_t)next_w * next_h * 4);
+		downsample(level.data(), w, h, next.data(), next_w, next_h);
+		level.swap(next);
+		w = next_w;
+		h = next_h;
+	}
+}
+
+bool loadTextureCache(const std::string& filename, bool allow_bc1, TextureData& out)
+{
+	if (!texture_cache_enabled)
+		return false;
+
+	uint64_t source_size;
+	int64_t source_mtime;
+	if (!MappedFile::getFileInfo(filename, source_size, source_mtime))
+		return false;
+
+	MappedFile cache;
+	if (!cache.open(textureCachePath(filename)) || cache.size() < sizeof(TextureCacheHeader))
+		return false;
+
+	TextureCacheHeader header;
+	memcpy(&header, cache.data(), sizeof(header));
+	if (memcmp(header.magic, texture_cache_magic, 4) != 0 || header.version != texture_cache_version)
+		return false;
+	if (header.format != TEXTURE_DATA_RGBA8 && header.format != TEXTURE_DATA_BC1)
+		return false;
+	if (header.format == TEXTURE_DATA_BC1 && !allow_bc1)
+		return false;
+	if (header.source_size != source_size)
+		return false;
+	// 修改时间变了不一定是内容变了（例如重新拷贝了资源目录），此时再比较内容哈希
+	if (header.source_mtime != source_mtime)
+	{
+		uint64_t hash;
+		if (!MappedFile::hashFile(filename, hash) || hash != header.source_hash)
+			return false;
+	}
+
+	size_t table_size = sizeof(TextureLevel) * header.level_count;
+	if (header.level_count == 0 || cache.size() - sizeof(TextureCacheHeader) < table_size)
+		return false;
+	const TextureLevel* levels = (const TextureLevel*)(cache.data() + sizeof(TextureCacheHeader));
+
+	// 各级数据在文件中是连续的，整体拷贝一次，偏移改为相对第 0 级
+	uint64_t base = levels[0].offset;
+	uint64_t end = levels[header.level_count - 1].offset + levels[header.level_count - 1].size;
+	if (end > cache.size() || base > end)
+		return false;
+	out.levels.assign(levels, levels + header.level_count);
+	for (size_t i = 0; i < out.levels.size(); i++)
+	{
+		if (out.levels[i].offset < base || out.levels[i].offset + out.levels[i].size > end
+			|| out.levels[i].size != levelSize(header.format, out.levels[i].width, out.levels[i].height))
+			return false;
+		out.levels[i].offset -= base;
+	}
+	out.data.assign(cache.data() + base, cache.data() + end);
+	out.format = header.format;
+	out.channels = 4;
+	out.width = header.width;
+	out.height = header.height;
+	return true;
+}
+
+bool saveTextureCache(const std::string& filename, const TextureData& texture)
+{
+	if (!texture_cache_enabled || texture.format == TEXTURE_DATA_RAW || texture.levels.empty())
+		return false;
+
+	TextureCacheHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, texture_cache_magic, 4);
+	header.version = texture_cache_version;
+	header.format = texture.format;
+	header.width = texture.width;
+	header.height = texture.height;
+	header.level_count = (uint32_t)texture.levels.size();
+	if (!MappedFile::getFileInfo(filename, header.source_size, header.source_mtime)
+		|| !MappedFile::hashFile(filename, header.source_hash))
+		return false;
+
+	std::vector<TextureLevel> levels(texture.levels);
+	uint64_t base = (sizeof(header) + sizeof(TextureLevel) * levels.size() + 15) & ~uint64_t(15);
+	for (size_t i = 0; i < levels.size(); i++)
+		levels[i].offset += base;
+
+	std::string path = textureCachePath(filename);
+	AtomicFileWriter writer(path);
+	if (!writer.isOpen())
+	{
+		std::cout << "WARNING: cannot write texture cache " << path << std::endl;
+		return false;
+	}
+	writer.write(&header, sizeof(header));
+	writer.write(levels.data(), sizeof(TextureLevel) * levels.size());
+	writer.align(16);
+	writer.write(texture.data.data(), texture.data.size());
+	return writer.commit();
+}
@@ -0,0 +1,380 @@
+#include "TextureManager.h"
+#include "MappedFile.h"
+#include "ThreadPool.h"
+
+#include "stb_image.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#ifdef _WIN32
+#include <stdlib.h>
+#else
+#include <limits.h>
+#endif
+
+// glad 中没有 S3TC 扩展的枚举
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+
+namespace {
+
+bool fileExists(const std::string& path)
+{
+	uint64_t size;
+	int64_t modify_time;
+	return MappedFile::getFileInfo(path, size, modify_time);
+}
+
+// 转为绝对路径并消去 "." ".." 和符号链接，不同写法的同一个文件得到相同的键
+std::string canonicalPath(const std::string& path)
+{
+#ifdef _WIN32
+	char buffer[_MAX_PATH];
+	if (_fullpath(buffer, path.c_str(), _MAX_PATH))
+		return buffer;
+#else
+	char buffer[PATH_MAX];
+	if (realpath(path.c_str(), buffer))
+		return buffer;
+#endif
+	return path;
+}
+
+}
+
+TextureManager::TextureManager() : async_loading(true), upload_budget_ms(2.0), upload_pbo(0),
+	s3tc_supported(-1), pending_count(0), decoding_count(0)
+{
+}
+
+TextureManager::~TextureManager()
+{
+	// 等待还在解码的任务把结果交回来，再释放没有上传的数据
+	std::unique_lock<std::mutex> lock(decoded_mutex);
+	decoded_condition.wait(lock, [this] { return decoding_count == 0; });
+	decoded.clear();
+}
+
+TextureManager& TextureManager::shared()
+{
+	static TextureManager manager;
+	return manager;
+}
+
+void TextureManager::setAsyncLoading(bool async)
+{
+	async_loading = async;
+}
+
+std::string TextureManager::resolvePath(const std::string& file_name)
+{
+	std::map<std::string, std::string>::iterator it = resolved_paths.find(file_name);
+	if (it != resolved_paths.end())
+		return it->second;
+
+	// 可能的位置，只检查文件是否存在，不再逐个解码
+	const std::vector<std::string> searchPaths = {
+		file_name,
+		"Final/" + file_name,
+		"../" + file_name,
+		"../Final/" + file_name,
+		"../../Final/" + file_name,
+		"assets/textures/" + file_name,
+		"Final/assets/textures/" + file_name,
+		"../assets/textures/" + file_name
+	};
+
+	std::string resolved;
+	for (size_t i = 0; i < searchPaths.size(); i++)
+	{
+		if (fileExists(searchPaths[i]))
+		{
+			resolved = canonicalPath(searchPaths[i]);
+			break;
+		}
+	}
+	resolved_paths[file_name] = resolved;
+	return resolved;
+}
+
+GLuint TextureManager::acquire(const std::string& file_name)
+{
+	if (file_name.empty())
+		return 0;
+
+	std::string path = resolvePath(file_name);
+	if (path.empty())
+	{
+		std::cerr << "Failed to load texture: " << file_name << " (tried multiple paths)" << std::endl;
+		return 0;
+	}
+
+	std::map<std::string, Entry>::iterator it = entries.find(path);
+	if (it != entries.end())
+	{
+		it->second.ref_count++;
+		return it->second.texture;
+	}
+
+	if (s3tc_supported < 0)
+		s3tc_supported = queryS3TCSupport() ? 1 : 0;
+	bool allow_bc1 = s3tc_supported != 0;
+
+	GLuint texture = 0;
+	if (async_loading)
+	{
+		// 先用占位图顶上，解码交给线程池，完成后由 processUploads 上传
+		glGenTextures(1, &texture);
+		uploadPlaceholder(texture);
+		pending_count++;
+		{
+			std::lock_guard<std::mutex> lock(decoded_mutex);
+			decoding_count++;
+		}
+		ThreadPool::shared().enqueue([this, texture, path, allow_bc1] {
+			DecodedImage image;
+			image.texture = texture;
+			decodeImage(path, allow_bc1, image);
+			std::lock_guard<std::mutex> lock(decoded_mutex);
+			decoded.push_back(image);
+			decoding_count--;
+			decoded_condition.notify_all();
+		});
+	}
+	else
+	{
+		DecodedImage image;
+		decodeImage(path, allow_bc1, image);
+		if (!image.ok)
+			return 0;
+		glGenTextures(1, &texture);
+		image.texture = texture;
+		uploadImage(image, 0);
+	}
+
+	Entry entry;
+	entry.texture = texture;
+	entry.ref_count = 1;
+	entries[path] = entry;
+	texture_paths[texture] = path;
+	return texture;
+}
+
+void TextureManager::release(GLuint texture)
+{
+	std::map<GLuint, std::string>::iterator path_it = texture_paths.find(texture);
+	if (path_it == texture_paths.end())
+		return;
+
+	std::map<std::string, Entry>::iterator it = entries.find(path_it->second);
+	if (--it->second.ref_count > 0)
+		return;
+
+	glDeleteTextures(1, &texture);
+	entries.erase(it);
+	texture_paths.erase(path_it);
+}
+
+int TextureManager::processUploads()
+{
+	if (pending_count == 0)
+		return 0;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	int uploaded = 0;
+	for (;;)
+	{
+		DecodedImage image;
+		{
+			std::lock_guard<std::mutex> lock(decoded_mutex);
+			if (decoded.empty())
+				break;
+			image = decoded.front();
+			decoded.pop_front();
+		}
+		pending_count--;
+
+		if (!image.ok)
+		{
+			// 失败原因记录在解码线程中，这里只能报告文件名，纹理保持占位图
+			std::cerr << "Failed to decode texture: " << image.path << std::endl;
+			continue;
+		}
+		// 解码期间纹理已经被释放（对象名也可能被复用），丢弃结果
+		std::map<GLuint, std::string>::iterator it = texture_paths.find(image.texture);
+		if (it == texture_paths.end() || it->second != image.path)
+			continue;
+
+		if (upload_pbo == 0)
+			glGenBuffers(1, &upload_pbo);
+		uploadImage(image, upload_pbo);
+		uploaded++;
+
+		double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		if (elapsed >= upload_budget_ms)
+			break;
+	}
+	return uploaded;
+}
+
+void TextureManager::finishUploads()
+{
+	while (pending_count > 0)
+	{
+		{
+			std::unique_lock<std::mutex> lock(decoded_mutex);
+			decoded_condition.wait(lock, [this] { return !decoded.empty(); });
+		}
+		double budget = upload_budget_ms;
+		upload_budget_ms = 1e30;
+		processUploads();
+		upload_budget_ms = budget;
+	}
+}
+
+void TextureManager::decodeImage(const std::string& path, bool allow_bc1, DecodedImage& image)
+{
+	image.path = path;
+	image.ok = true;
+
+	// 缓存中已经是预先生成好的多级纹理，直接逐级上传
+	if (loadTextureCache(path, allow_bc1, image.data))
+		return;
+
+	int width = 0, height = 0, channels = 0;
+	// 翻转标志按线程设置，多个工作线程同时解码互不影响
+	stbi_set_flip_vertically_on_load_thread(1);
+	unsigned char* pixels = stbi_load(path.c_str(), &width, &height, &channels, 0);
+	if (!pixels)
+	{
+		std::cerr << "Failed to decode texture: " << path << " (" << stbi_failure_reason() << ")" << std::endl;
+		image.ok = false;
+		return;
+	}
+
+	if (getTextureCacheEnabled())
+	{
+		// 第一次读取：在 CPU 上生成多级纹理（尽量压缩为 BC1）并写入缓存
+		buildTextureData(pixels, width, height, channels, allow_bc1, image.data);
+		if (saveTextureCache(path, image.data))
+			std::cout << "Texture cache written: " << textureCachePath(path) << std::endl;
+	}
+	else
+	{
+		// 不使用缓存时保留原始像素，上传后由 OpenGL 生成多级纹理
+		TextureData& data = image.data;
+		data.format = TEXTURE_DATA_RAW;
+		data.channels = (uint32_t)channels;
+		data.width = (uint32_t)width;
+		data.height = (uint32_t)height;
+		data.data.assign(pixels, pixels + (size_t)width * height * channels);
+		TextureLevel level;
+		level.width = data.width;
+		level.height = data.height;
+		level.offset = 0;
+		level.size = data.data.size();
+		data.levels.assign(1, level);
+	}
+	stbi_image_free(pixels);
+}
+
+bool TextureManager::queryS3TCSupport()
+{
+	GLint count = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+	for (GLint i = 0; i < count; i++)
+	{
+		const char* name = (const char*)glGetStringi(GL_EXTENSIONS, (GLuint)i);
+		if (name && strcmp(name, "GL_EXT_texture_compression_s3tc") == 0)
+			return true;
+	}
+	return false;
+}
+
+void TextureManager::uploadPlaceholder(GLuint texture)
+{
+	// 浅灰色，图片上传前物体不会显得过暗或过亮
+	const unsigned char pixel[4] = { 200, 200, 200, 255 };
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixel);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+}
+
+void TextureManager::uploadImage(const DecodedImage& image, GLuint pbo)
+{
+	const TextureData& data = image.data;
+
+	// 所有层级先一次拷贝进 PBO，glTexImage2D 从缓冲对象读取，驱动可以异步完成传输
+	const unsigned char* source = data.data.data();
+	if (pbo != 0)
+	{
+		GLsizeiptr size = (GLsizeiptr)data.data.size();
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+		// 重新分配存储，不必等待上一次上传读完旧数据
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+		void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+		if (mapped)
+		{
+			memcpy(mapped, data.data.data(), (size_t)size);
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+			source = (const unsigned char*)BUFFER_OFFSET(0);
+		}
+		else
+		{
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		}
+	}
+
+	glBindTexture(GL_TEXTURE_2D, image.texture);
+	if (data.format == TEXTURE_DATA_RAW)
+	{
+		// 调整行对齐格式
+		if (data.width * data.channels % 4 != 0) glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		GLenum format = GL_RGB;
+		switch (data.channels) {
+		case 1: format = GL_RED; break;
+		case 2: format = GL_RG; break;
+		case 3: format = GL_RGB; break;
+		case 4: format = GL_RGBA; break;
+		default: format = GL_RGB; break;
+		}
+		glTexImage2D(GL_TEXTURE_2D, 0, format, data.width, data.height, 0, format, GL_UNSIGNED_BYTE, source);
+		// 生成多级渐远纹理，多消耗 1/3 的显存，远处缩小显示时只读取较小的层级
+		glGenerateMipmap(GL_TEXTURE_2D);
+		// 恢复初始对齐格式
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	}
+	else
+	{
+		// 预先生成的各级直接上传；BC1 每像素 4 位，显存和采样带宽只有 RGBA8 的 1/8
+		for (size_t i = 0; i < data.levels.size(); i++)
+		{
+			const TextureLevel& level = data.levels[i];
+			if (data.format == TEXTURE_DATA_BC1)
+				glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)i, GL_COMPRESSED_RGB_S3TC_DXT1_EXT,
+					level.width, level.height, 0, (GLsizei)level.size, source + level.offset);
+			else
+				glTexImage2D(GL_TEXTURE_2D, (GLint)i, GL_RGBA8, level.width, level.height, 0,
+					GL_RGBA, GL_UNSIGNED_BYTE, source + level.offset);
+		}
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)data.levels.size() - 1);
+	}
+	if (pbo != 0)
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	// 地面和墙面通过 uvScale 平铺，需要重复寻址
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+	const char* format_name = data.format == TEXTURE_DATA_BC1 ? "BC1" : (data.format == TEXTURE_DATA_RGBA8 ? "RGBA8" : "raw");
+	std::cout << "Successfully loaded texture from: " << image.path << " (" << data.width << "x" << data.height
+		<< ", " << format_name << ", " << data.levels.size() << " levels)" << std::endl;
+}
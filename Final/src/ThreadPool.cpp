@@ -0,0 +1,109 @@
+#include "ThreadPool.h"
+
+#include <atomic>
+#include <memory>
+
+ThreadPool::ThreadPool(unsigned int num_threads) : stopping(false)
+{
+	if (num_threads == 0) {
+		num_threads = std::thread::hardware_concurrency();
+		if (num_threads == 0) num_threads = 2;
+	}
+	for (unsigned int i = 0; i < num_threads; i++)
+		workers.push_back(std::thread(&ThreadPool::workerLoop, this));
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	condition.notify_all();
+	for (size_t i = 0; i < workers.size(); i++)
+		workers[i].join();
+}
+
+void ThreadPool::enqueue(const std::function<void()>& task)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		tasks.push_back(task);
+	}
+	condition.notify_one();
+}
+
+void ThreadPool::workerLoop()
+{
+	for (;;) {
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			condition.wait(lock, [this] { return stopping || !tasks.empty(); });
+			if (stopping && tasks.empty())
+				return;
+			task = tasks.front();
+			tasks.pop_front();
+		}
+		task();
+	}
+}
+
+namespace {
+// parallelFor 一次调用的共享状态，各线程通过原子计数领取下标
+struct ParallelForState
+{
+	std::function<void(size_t)> fn;
+	size_t count;
+	std::atomic<size_t> next;
+	std::atomic<size_t> done;
+	std::mutex mutex;
+	std::condition_variable finished;
+
+	void run()
+	{
+		for (;;) {
+			size_t i = next.fetch_add(1);
+			if (i >= count)
+				return;
+			fn(i);
+			if (done.fetch_add(1) + 1 == count) {
+				std::lock_guard<std::mutex> lock(mutex);
+				finished.notify_all();
+			}
+		}
+	}
+};
+}
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)>& fn)
+{
+	if (count == 0)
+		return;
+	if (count == 1 || workers.empty()) {
+		for (size_t i = 0; i < count; i++)
+			fn(i);
+		return;
+	}
+
+	std::shared_ptr<ParallelForState> state = std::make_shared<ParallelForState>();
+	state->fn = fn;
+	state->count = count;
+	state->next = 0;
+	state->done = 0;
+
+	size_t helpers = count - 1 < workers.size() ? count - 1 : workers.size();
+	for (size_t i = 0; i < helpers; i++)
+		enqueue([state] { state->run(); });
+
+	state->run();
+
+	std::unique_lock<std::mutex> lock(state->mutex);
+	state->finished.wait(lock, [&state] { return state->done.load() == state->count; });
+}
+
+ThreadPool& ThreadPool::shared()
+{
+	static ThreadPool pool;
+	return pool;
+}
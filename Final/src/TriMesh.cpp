@@ -1,4 +1,19 @@
 #include "TriMesh.h"
+#include "MappedFile.h"
+#include "TextScanner.h"
+#include "ThreadPool.h"
+
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+#include <unordered_map>
+#include <cmath>
+#include <atomic>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define TRIMESH_USE_SSE 1
+#endif
 
 // 一些基础颜色
 const glm::vec3 basic_colors[8] = {
@@ -41,58 +56,240 @@ const glm::vec3 square_vertices[4] = {
 TriMesh::TriMesh()
 {
 	do_normalize_size = true;
+	use_indices = false;
+	normal_weighting = NORMAL_WEIGHT_UNIFORM;
 	diagonal_length = 1.0;
 	scale = glm::vec3(1.0);
 	rotation = glm::vec3(0.0);
 	translation = glm::vec3(0.0);
+	transform_version = 0;
 }
 
 TriMesh::~TriMesh(){}
 
-std::vector<glm::vec3> TriMesh::getVertexPositions() { return vertex_positions; }
-std::vector<glm::vec3> TriMesh::getVertexColors(){ return vertex_colors; }
-std::vector<glm::vec3> TriMesh::getVertexNormals(){ return vertex_normals; }
-std::vector<glm::vec2> TriMesh::getVertexTextures(){ return vertex_textures; }
+const std::vector<glm::vec3>& TriMesh::getVertexPositions() const { return vertex_positions; }
+const std::vector<glm::vec3>& TriMesh::getVertexColors() const { return vertex_colors; }
+const std::vector<glm::vec3>& TriMesh::getVertexNormals() const { return vertex_normals; }
+const std::vector<glm::vec2>& TriMesh::getVertexTextures() const { return vertex_textures; }
 
-std::vector<vec3i> TriMesh::getFaces(){ return faces; }
-std::vector<glm::vec3> TriMesh::getPoints(){ return points;}
-std::vector<glm::vec3> TriMesh::getColors(){ return colors; }
-std::vector<glm::vec3> TriMesh::getNormals(){ return normals;}
-std::vector<glm::vec2> TriMesh::getTextures(){ return textures; }
+const std::vector<vec3i>& TriMesh::getFaces() const { return faces; }
+const std::vector<glm::vec3>& TriMesh::getPoints() const { return points;}
+const std::vector<glm::vec3>& TriMesh::getColors() const { return colors; }
+const std::vector<glm::vec3>& TriMesh::getNormals() const { return normals;}
+const std::vector<glm::vec2>& TriMesh::getTextures() const { return textures; }
+const std::vector<unsigned int>& TriMesh::getIndices() const { return indices; }
 
 
-void TriMesh::computeTriangleNormals()
+// 法向量的并行计算
+namespace {
+
+// 计算法向量使用的线程数，0 表示使用线程池的全部线程
+unsigned int normal_threads = 0;
+
+// 每块至少这么多个面片/顶点，太小的块调度开销比计算本身还大
+const size_t normal_min_chunk_size = 16 * 1024;
+
+// [0, count) 切成的块数，数量较少或只用一个线程时为 1
+size_t normalChunkCount(size_t count)
 {
-	face_normals.resize(faces.size());
-	for (size_t i = 0; i < faces.size(); i++)
+	size_t num_threads = normal_threads == 0 ? ThreadPool::shared().size() + 1 : normal_threads;
+	if (num_threads <= 1)
+		return 1;
+	size_t num_chunks = count / normal_min_chunk_size + 1;
+	if (num_chunks > num_threads * 4) num_chunks = num_threads * 4;
+	return num_chunks;
+}
+
+// 把 [0, count) 切成 num_chunks 块并行执行 fn(chunk, begin, end)，只有一块时直接在当前线程执行
+void parallelChunks(size_t count, size_t num_chunks, const std::function<void(size_t, size_t, size_t)>& fn)
+{
+	if (num_chunks <= 1)
 	{
-		auto &face = faces[i];
-		glm::vec3 v01 = vertex_positions[face.y] - vertex_positions[face.x];
-		glm::vec3 v02 = vertex_positions[face.z] - vertex_positions[face.x];
-		face_normals[i] = normalize(cross(v01, v02));
+		fn(0, 0, count);
+		return;
 	}
+	ThreadPool::shared().parallelFor(num_chunks, [&](size_t i) {
+		fn(i, count * i / num_chunks, count * (i + 1) / num_chunks);
+	});
 }
 
-void TriMesh::computeVertexNormals()
+void parallelRange(size_t count, const std::function<void(size_t, size_t)>& fn)
 {
-	// 计算面片的法向量
-	if (face_normals.size() == 0 && faces.size() > 0)
+	parallelChunks(count, normalChunkCount(count), [&](size_t, size_t begin, size_t end) {
+		fn(begin, end);
+	});
+}
+
+inline unsigned int faceCorner(const vec3i& face, int k)
+{
+	return k == 0 ? face.x : (k == 1 ? face.y : face.z);
+}
+
+// 计算 [begin, end) 面片的单位法向量与面积，退化的面片法向量为 0
+void computeFaceNormalRange(const std::vector<glm::vec3>& positions, const std::vector<vec3i>& faces,
+	std::vector<glm::vec3>& normals, std::vector<float>& areas, size_t begin, size_t end)
+{
+	size_t i = begin;
+#ifdef TRIMESH_USE_SSE
+	// 每 4 个面片一批：顶点坐标转为分量分开存放的形式，叉积、长度、归一化一次算 4 个
+	for (; i + 4 <= end; i += 4)
 	{
-		computeTriangleNormals();
+		float e1[3][4], e2[3][4];
+		for (int k = 0; k < 4; k++)
+		{
+			const vec3i& face = faces[i + k];
+			const glm::vec3& p0 = positions[face.x];
+			glm::vec3 d1 = positions[face.y] - p0;
+			glm::vec3 d2 = positions[face.z] - p0;
+			for (int c = 0; c < 3; c++)
+			{
+				e1[c][k] = d1[c];
+				e2[c][k] = d2[c];
+			}
+		}
+		__m128 ax = _mm_loadu_ps(e1[0]), ay = _mm_loadu_ps(e1[1]), az = _mm_loadu_ps(e1[2]);
+		__m128 bx = _mm_loadu_ps(e2[0]), by = _mm_loadu_ps(e2[1]), bz = _mm_loadu_ps(e2[2]);
+
+		__m128 nx = _mm_sub_ps(_mm_mul_ps(ay, bz), _mm_mul_ps(az, by));
+		__m128 ny = _mm_sub_ps(_mm_mul_ps(az, bx), _mm_mul_ps(ax, bz));
+		__m128 nz = _mm_sub_ps(_mm_mul_ps(ax, by), _mm_mul_ps(ay, bx));
+		__m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, nx), _mm_mul_ps(ny, ny)), _mm_mul_ps(nz, nz)));
+		// 长度为 0 时 1/length 为无穷大，用比较结果把它清零
+		__m128 inv_length = _mm_and_ps(_mm_cmpgt_ps(length, _mm_setzero_ps()), _mm_div_ps(_mm_set1_ps(1.0f), length));
+
+		float out[4][4];
+		_mm_storeu_ps(out[0], _mm_mul_ps(nx, inv_length));
+		_mm_storeu_ps(out[1], _mm_mul_ps(ny, inv_length));
+		_mm_storeu_ps(out[2], _mm_mul_ps(nz, inv_length));
+		_mm_storeu_ps(out[3], _mm_mul_ps(length, _mm_set1_ps(0.5f)));
+		for (int k = 0; k < 4; k++)
+		{
+			normals[i + k] = glm::vec3(out[0][k], out[1][k], out[2][k]);
+			areas[i + k] = out[3][k];
+		}
 	}
-	// 初始化法向量为0
-	vertex_normals.resize(vertex_positions.size(), glm::vec3(0, 0, 0));
-	for (size_t i = 0; i < faces.size(); i++)
+#endif
+	for (; i < end; i++)
 	{
-		auto &face = faces[i];
-		vertex_normals[face.x] += face_normals[i];
-		vertex_normals[face.y] += face_normals[i];
-		vertex_normals[face.z] += face_normals[i];
+		const vec3i& face = faces[i];
+		glm::vec3 n = glm::cross(positions[face.y] - positions[face.x], positions[face.z] - positions[face.x]);
+		float length = glm::length(n);
+		normals[i] = length > 0.0f ? n / length : glm::vec3(0.0f);
+		areas[i] = 0.5f * length;
 	}
-	for (size_t i = 0; i < vertex_normals.size(); i++)
+}
+
+}
+
+void TriMesh::setNormalThreads(unsigned int num_threads) { normal_threads = num_threads; }
+void TriMesh::setNormalWeighting(NormalWeighting weighting) { normal_weighting = weighting; }
+NormalWeighting TriMesh::getNormalWeighting() { return normal_weighting; }
+
+void TriMesh::computeTriangleNormals()
+{
+	face_normals.resize(faces.size());
+	face_areas.resize(faces.size());
+	// 每个面片只写自己的位置，各块互不重叠
+	parallelRange(faces.size(), [&](size_t begin, size_t end) {
+		computeFaceNormalRange(vertex_positions, faces, face_normals, face_areas, begin, end);
+	});
+}
+
+void TriMesh::computeVertexNormals()
+{
+	// 计算面片的法向量
+	if (face_normals.size() != faces.size() || face_areas.size() != faces.size())
 	{
-		vertex_normals[i] = normalize(vertex_normals[i]);
+		computeTriangleNormals();
 	}
+
+	// 顶点到面片角点的 CSR 邻接表：顶点 v 的角点为 corners[offsets[v], offsets[v + 1])，
+	// 角点编号 = 面片下标 * 3 + 在面片中的位置。建表的三步都按块并行：
+	// 按面片原子计数 -> 分块前缀和 -> 按面片原子领取位置填入
+	size_t num_vertices = vertex_positions.size();
+	std::vector<std::atomic<unsigned int> > cursor(num_vertices);
+	parallelRange(num_vertices, [&](size_t begin, size_t end) {
+		for (size_t v = begin; v < end; v++)
+			cursor[v].store(0, std::memory_order_relaxed);
+	});
+	parallelRange(faces.size(), [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++)
+		{
+			for (int k = 0; k < 3; k++)
+				cursor[faceCorner(faces[i], k)].fetch_add(1, std::memory_order_relaxed);
+		}
+	});
+
+	// 前缀和：先求每块的总数，块之间串行累加（块数很少），再各块并行写出自己的起点
+	std::vector<unsigned int> offsets(num_vertices + 1);
+	size_t num_chunks = normalChunkCount(num_vertices);
+	std::vector<unsigned int> chunk_start(num_chunks + 1, 0);
+	parallelChunks(num_vertices, num_chunks, [&](size_t chunk, size_t begin, size_t end) {
+		unsigned int sum = 0;
+		for (size_t v = begin; v < end; v++)
+			sum += cursor[v].load(std::memory_order_relaxed);
+		chunk_start[chunk + 1] = sum;
+	});
+	for (size_t c = 0; c < num_chunks; c++)
+		chunk_start[c + 1] += chunk_start[c];
+	parallelChunks(num_vertices, num_chunks, [&](size_t chunk, size_t begin, size_t end) {
+		unsigned int offset = chunk_start[chunk];
+		for (size_t v = begin; v < end; v++)
+		{
+			unsigned int count = cursor[v].load(std::memory_order_relaxed);
+			offsets[v] = offset;
+			// 计数用完后改为填表时的写入位置
+			cursor[v].store(offset, std::memory_order_relaxed);
+			offset += count;
+		}
+	});
+	offsets[num_vertices] = chunk_start[num_chunks];
+
+	std::vector<unsigned int> corners(offsets[num_vertices]);
+	parallelRange(faces.size(), [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				unsigned int slot = cursor[faceCorner(faces[i], k)].fetch_add(1, std::memory_order_relaxed);
+				corners[slot] = (unsigned int)(i * 3 + k);
+			}
+		}
+	});
+
+	// 按顶点并行累加，每个顶点只由一个线程写入。并行填表时同一顶点的角点顺序不固定，
+	// 先按角点编号排序，累加顺序与线程数无关，结果每次都相同
+	vertex_normals.assign(num_vertices, glm::vec3(0.0f));
+	NormalWeighting weighting = normal_weighting;
+	parallelRange(num_vertices, [&](size_t begin, size_t end) {
+		for (size_t v = begin; v < end; v++)
+		{
+			std::sort(corners.begin() + offsets[v], corners.begin() + offsets[v + 1]);
+			glm::vec3 sum(0.0f);
+			for (unsigned int c = offsets[v]; c < offsets[v + 1]; c++)
+			{
+				unsigned int face_index = corners[c] / 3;
+				float weight = 1.0f;
+				if (weighting == NORMAL_WEIGHT_AREA)
+				{
+					weight = face_areas[face_index];
+				}
+				else if (weighting == NORMAL_WEIGHT_ANGLE)
+				{
+					// 面片在该顶点处的内角，用 atan2 比 acos 在接近 0 和 180 度时更稳定
+					const vec3i& face = faces[face_index];
+					int k = corners[c] % 3;
+					const glm::vec3& p = vertex_positions[v];
+					glm::vec3 a = vertex_positions[faceCorner(face, (k + 1) % 3)] - p;
+					glm::vec3 b = vertex_positions[faceCorner(face, (k + 2) % 3)] - p;
+					weight = std::atan2(glm::length(glm::cross(a, b)), glm::dot(a, b));
+				}
+				sum += face_normals[face_index] * weight;
+			}
+			float length = glm::length(sum);
+			vertex_normals[v] = length > 0.0f ? sum / length : glm::vec3(0.0f);
+		}
+	});
 	// 球心在原点的球法向量为坐标
 	// for (int i = 0; i < vertex_positions.size(); i++)
 	// 	vertex_normals.push_back(vertex_positions[i] - vec3(0.0, 0.0, 0.0));
@@ -100,8 +297,56 @@ void TriMesh::computeVertexNormals()
 
 void TriMesh::setNormalize(bool do_norm) { do_normalize_size = do_norm; }
 bool TriMesh::getNormalize() { return do_normalize_size; }
+void TriMesh::setIndexed(bool indexed) { use_indices = indexed; }
+bool TriMesh::getIndexed() { return use_indices; }
 float TriMesh::getDiagonalLength() { return diagonal_length; }
 
+glm::vec3 TriMesh::getLocalBoundsMin()
+{
+	// 归一化时顶点被移到中心并除以对角线长度，包围盒也做同样的变换
+	if (do_normalize_size && diagonal_length > 0.0f)
+		return (down_corner - center) / diagonal_length;
+	return down_corner;
+}
+
+glm::vec3 TriMesh::getLocalBoundsMax()
+{
+	if (do_normalize_size && diagonal_length > 0.0f)
+		return (up_corner - center) / diagonal_length;
+	return up_corner;
+}
+
+void TriMesh::getWorldAABB(const glm::mat4& model, glm::vec3& world_min, glm::vec3& world_max)
+{
+	glm::vec3 local_min = getLocalBoundsMin();
+	glm::vec3 local_max = getLocalBoundsMax();
+	glm::vec3 local_center = (local_min + local_max) * 0.5f;
+	glm::vec3 local_extent = (local_max - local_min) * 0.5f;
+
+	// 中心直接变换；半边长在世界坐标各轴上的投影为 |M| * extent，不需要变换 8 个角点
+	glm::vec3 world_center = glm::vec3(model * glm::vec4(local_center, 1.0f));
+	glm::vec3 world_extent;
+	for (int k = 0; k < 3; k++)
+	{
+		world_extent[k] = fabs(model[0][k]) * local_extent.x
+			+ fabs(model[1][k]) * local_extent.y
+			+ fabs(model[2][k]) * local_extent.z;
+	}
+	world_min = world_center - world_extent;
+	world_max = world_center + world_extent;
+}
+
+void TriMesh::getWorldBoundingSphere(const glm::mat4& model, glm::vec3& world_center, float& world_radius)
+{
+	glm::vec3 local_min = getLocalBoundsMin();
+	glm::vec3 local_max = getLocalBoundsMax();
+	world_center = glm::vec3(model * glm::vec4((local_min + local_max) * 0.5f, 1.0f));
+
+	float max_scale = glm::max(glm::length(glm::vec3(model[0])),
+		glm::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+	world_radius = glm::length(local_max - local_min) * 0.5f * max_scale;
+}
+
 glm::vec3 TriMesh::getTranslation(){ return translation;}
 glm::vec3 TriMesh::getRotation(){ return rotation;}
 glm::vec3 TriMesh::getScale(){ return scale; }
@@ -118,9 +363,17 @@ glm::mat4 TriMesh::getModelMatrix( ) {
 	return model;
 }
 
-void TriMesh::setTranslation(glm::vec3 translation){this->translation = translation; }
-void TriMesh::setRotation(glm::vec3 rotation){ this->rotation = rotation; }
-void TriMesh::setScale(glm::vec3 scale) { this->scale = scale; }
+// 值没有变化时不增加版本号，每帧设置相同参数的物体不会让缓存失效
+void TriMesh::setTranslation(glm::vec3 translation){
+	if (this->translation != translation) { this->translation = translation; transform_version++; }
+}
+void TriMesh::setRotation(glm::vec3 rotation){
+	if (this->rotation != rotation) { this->rotation = rotation; transform_version++; }
+}
+void TriMesh::setScale(glm::vec3 scale) {
+	if (this->scale != scale) { this->scale = scale; transform_version++; }
+}
+unsigned int TriMesh::getTransformVersion() { return transform_version; }
 
 glm::vec4 TriMesh::getAmbient() { return ambient; };
 glm::vec4 TriMesh::getDiffuse() { return diffuse; };
@@ -145,11 +398,13 @@ void TriMesh::cleanData()
 	texture_index.clear();
 
 	face_normals.clear();
+	face_areas.clear();
 
 	points.clear();
 	colors.clear();
 	normals.clear();
 	textures.clear();
+	indices.clear();
 }
 
 void TriMesh::storeFacesPoints()
@@ -191,6 +446,20 @@ void TriMesh::storeFacesPoints()
 	if (vertex_normals.size() == 0)
 		computeVertexNormals();
 
+	if (use_indices)
+	{
+		storeIndexedPoints();
+		return;
+	}
+
+	// 提前按面片数分配好空间，避免逐个 push_back 时反复扩容拷贝
+	points.reserve(faces.size() * 3);
+	colors.reserve(faces.size() * 3);
+	if (vertex_normals.size() != 0)
+		normals.reserve(faces.size() * 3);
+	if (vertex_textures.size() != 0)
+		textures.reserve(faces.size() * 3);
+
 	for (int i = 0; i < faces.size(); i++)
 	{
 		// 坐标
@@ -218,6 +487,84 @@ void TriMesh::storeFacesPoints()
 	}
 }
 
+namespace {
+
+// 一个角点的（坐标, 颜色, 法向量, 纹理）下标组合
+struct CornerKey
+{
+	unsigned int position, color, normal, texture;
+	bool operator==(const CornerKey& other) const
+	{
+		return position == other.position && color == other.color
+			&& normal == other.normal && texture == other.texture;
+	}
+};
+
+struct CornerKeyHash
+{
+	size_t operator()(const CornerKey& key) const
+	{
+		uint64_t h = key.position * 0x9E3779B97F4A7C15ULL;
+		h ^= (key.color + 0x632BE59BD9B4E019ULL + (h << 6) + (h >> 2));
+		h ^= (key.normal + 0x85157AF5ULL + (h << 6) + (h >> 2));
+		h ^= (key.texture + 0x27D4EB2FULL + (h << 6) + (h >> 2));
+		return (size_t)h;
+	}
+};
+
+inline unsigned int corner(const vec3i& v, int j) { return j == 0 ? v.x : (j == 1 ? v.y : v.z); }
+
+}
+
+void TriMesh::storeIndexedPoints()
+{
+	// 四个下标都相同的角点是同一个顶点，只保存一份，三角形改为通过 indices 引用
+	const bool has_normals = vertex_normals.size() != 0;
+	const bool has_textures = vertex_textures.size() != 0;
+	const size_t num_corners = faces.size() * 3;
+
+	std::unordered_map<CornerKey, unsigned int, CornerKeyHash> welded;
+	welded.reserve(vertex_positions.size() * 2);
+	indices.resize(num_corners);
+	points.reserve(vertex_positions.size());
+	colors.reserve(vertex_positions.size());
+	if (has_normals) normals.reserve(vertex_positions.size());
+	if (has_textures) textures.reserve(vertex_positions.size());
+
+	for (size_t i = 0; i < faces.size(); i++)
+	{
+		for (int j = 0; j < 3; j++)
+		{
+			CornerKey key;
+			key.position = corner(faces[i], j);
+			key.color = corner(color_index[i], j);
+			key.normal = has_normals ? corner(normal_index[i], j) : 0;
+			key.texture = has_textures ? corner(texture_index[i], j) : 0;
+
+			std::pair<std::unordered_map<CornerKey, unsigned int, CornerKeyHash>::iterator, bool> result =
+				welded.insert(std::make_pair(key, (unsigned int)points.size()));
+			if (result.second)
+			{
+				points.push_back(vertex_positions[key.position]);
+				colors.push_back(vertex_colors[key.color]);
+				if (has_normals) normals.push_back(vertex_normals[key.normal]);
+				if (has_textures) textures.push_back(vertex_textures[key.texture]);
+			}
+			indices[i * 3 + j] = result.first->second;
+		}
+	}
+
+	// 打印合并前后需要上传给 GPU 的数据量（仅在 Verbose() 开启时）
+	if (!Verbose())
+		return;
+	size_t vertex_bytes = sizeof(glm::vec3) * (has_normals ? 3 : 2) + (has_textures ? sizeof(glm::vec2) : 0);
+	size_t index_bytes = points.size() <= 65536 ? sizeof(unsigned short) : sizeof(unsigned int);
+	printf("Indexed mesh: %d unique vertices for %d corners, %.1f KB -> %.1f KB\n",
+		(int)points.size(), (int)num_corners,
+		num_corners * vertex_bytes / 1024.0,
+		(points.size() * vertex_bytes + num_corners * index_bytes) / 1024.0);
+}
+
 // 立方体生成12个三角形的顶点索引
 void TriMesh::generateCube(glm::vec3 _color)
 {
@@ -227,12 +574,8 @@ void TriMesh::generateCube(glm::vec3 _color)
 	for (int i = 0; i < 8; i++)
 	{
 		vertex_positions.push_back(cube_vertices[i]);
-		vertex_colors.push_back(basic_colors[i]);
-		if (_color[0] == -1){
-		}
-		else{
-			vertex_colors.push_back( _color );
-		}
+		// 指定了颜色时所有面都用这个颜色，否则每个面一种基础颜色
+		vertex_colors.push_back(_color[0] == -1 ? basic_colors[i] : _color);
 	}
 
 	// 每个三角面片的顶点下标
@@ -269,18 +612,17 @@ void TriMesh::generateCube(glm::vec3 _color)
 	}
 
 	texture_index = faces;
-	normal_index = faces;
 
-	storeFacesPoints();
-	
-	normals.clear();
 	// 正方形的法向量不能靠之前顶点法向量的方法直接计算，因为每个四边形平面是正交的，不是连续曲面
-	for (int i = 0; i < faces.size(); i++)
-	{
-		normals.push_back( face_normals[i] );
-		normals.push_back( face_normals[i] );
-		normals.push_back( face_normals[i] );
+	// 这里直接把面片法向量作为顶点法向量，同一个面的两个三角形共用一个法向量
+	computeTriangleNormals();
+	for (int i = 0; i < 6; i++) {
+		vertex_normals.push_back(face_normals[i * 2]);
+		normal_index.push_back(vec3i(i, i, i));
+		normal_index.push_back(vec3i(i, i, i));
 	}
+
+	storeFacesPoints();
 }
 
 void TriMesh::generateTriangle(glm::vec3 color)
@@ -344,7 +686,7 @@ void TriMesh::generateSquare(glm::vec3 color)
 	int a = 0;
 }
 
-void TriMesh::generateCylinder(int num_division, float radius, float height)
+void TriMesh::generateCylinder(int num_division, float radius, float height, glm::vec3 _color)
 {
 
 	cleanData();
@@ -364,7 +706,7 @@ void TriMesh::generateCylinder(int num_division, float radius, float height)
 		vertex_positions.push_back(glm::vec3(x, y, z));
 		vertex_normals.push_back( normalize(glm::vec3(x, y, 0)));
 		// 这里颜色和法向量一样
-		vertex_colors.push_back( normalize(glm::vec3(x, y, 0)));
+		vertex_colors.push_back(_color[0] == -1 ? normalize(glm::vec3(x, y, 0)) : _color);
 	}
 
 	// 按cos和sin生成x，y坐标，z为正，即得到上表面顶点坐标
@@ -376,7 +718,7 @@ void TriMesh::generateCylinder(int num_division, float radius, float height)
 		float y = radius * sin(r_r_r);
 		vertex_positions.push_back(glm::vec3(x, y, z));
 		vertex_normals.push_back( normalize(glm::vec3(x, y, 0)));
-		vertex_colors.push_back( normalize(glm::vec3(x, y, 0)));
+		vertex_colors.push_back(_color[0] == -1 ? normalize(glm::vec3(x, y, 0)) : _color);
 	}
 
 	// 面片生成三角面片，每个矩形由两个三角形面片构成
@@ -410,7 +752,7 @@ void TriMesh::generateCylinder(int num_division, float radius, float height)
 	storeFacesPoints();
 }
 
-void TriMesh::generateDisk(int num_division, float radius)
+void TriMesh::generateDisk(int num_division, float radius, glm::vec3 _color)
 {
 	cleanData();
 	
@@ -427,12 +769,12 @@ void TriMesh::generateDisk(int num_division, float radius)
 		vertex_positions.push_back(glm::vec3(x, y, z));
 		vertex_normals.push_back(glm::vec3(0, 0, 1));
 		// 这里采用法线来生成颜色，可以自定义自己的颜色生成方式
-		vertex_colors.push_back(glm::vec3(0, 0, 1));
+		vertex_colors.push_back(_color[0] == -1 ? glm::vec3(0, 0, 1) : _color);
 	}
 	// 中心点
 	vertex_positions.push_back(glm::vec3(0, 0, 0));
 	vertex_normals.push_back(glm::vec3(0, 0, 1));
-	vertex_colors.push_back(glm::vec3(0, 0, 1));
+	vertex_colors.push_back(_color[0] == -1 ? glm::vec3(0, 0, 1) : _color);
 
 	// 生成三角面片，每个矩形由两个三角形面片构成
 	for (int i = 0; i < num_samples; i++)
@@ -465,6 +807,47 @@ void TriMesh::generateDisk(int num_division, float radius)
 	storeFacesPoints();
 }
 
+void TriMesh::generateSphere(int num_division, float radius, glm::vec3 _color)
+{
+	cleanData();
+
+	// 经线 num_division 条，纬线为它的一半；每圈首尾各存一个顶点，纹理坐标才能从 0 连续到 1
+	int num_slices = num_division < 3 ? 3 : num_division;
+	int num_stacks = num_slices / 2 < 2 ? 2 : num_slices / 2;
+	for (int i = 0; i <= num_stacks; i++)
+	{
+		float phi = M_PI * i / num_stacks;	// 从北极 (y = radius) 到南极
+		for (int j = 0; j <= num_slices; j++)
+		{
+			float theta = 2 * M_PI * j / num_slices;
+			glm::vec3 normal(sin(phi) * cos(theta), cos(phi), sin(phi) * sin(theta));
+			vertex_positions.push_back(radius * normal);
+			vertex_normals.push_back(normal);
+			vertex_colors.push_back(_color[0] == -1 ? normal : _color);
+			vertex_textures.push_back(glm::vec2(1.0 * j / num_slices, 1.0 - 1.0 * i / num_stacks));
+		}
+	}
+
+	// 每个矩形由两个三角形面片构成，从球外看为逆时针
+	for (int i = 0; i < num_stacks; i++)
+	{
+		for (int j = 0; j < num_slices; j++)
+		{
+			int a = i * (num_slices + 1) + j;
+			int b = a + num_slices + 1;
+			faces.push_back(vec3i(a, a + 1, b));
+			faces.push_back(vec3i(a + 1, b + 1, b));
+		}
+	}
+
+	// 坐标、法向量、颜色、纹理坐标一一对应，都可以直接用 faces 作为下标
+	normal_index = faces;
+	color_index = faces;
+	texture_index = faces;
+
+	storeFacesPoints();
+}
+
 void TriMesh::generateCone(int num_division, float radius, float height)
 {
 	cleanData();
@@ -512,63 +895,493 @@ void TriMesh::generateCone(int num_division, float radius, float height)
 
 void TriMesh::readOff(const std::string &filename)
 {
-	// fin打开文件读取文件信息
+	// 将整个文件映射到内存后直接在内存上解析，不再经过 ifstream
 	if (filename.empty())
 	{
 		return;
 	}
-	std::ifstream fin;
-	fin.open(filename);
-	if (!fin)
+	// 缓存有效时直接使用缓存
+	if (loadMeshCache(filename))
+	{
+		return;
+	}
+	std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+
+	MappedFile file;
+	if (!file.open(filename))
 	{
 		printf("File on error\n");
 		return;
 	}
-	else
+	printf("File open success\n");
+
+	cleanData();
+
+	TextScanner scanner(file.data(), file.end());
+	const char *token_begin, *token_end;
+	int nVertices = 0, nFaces = 0, nEdges = 0;
+
+	// 读取OFF字符串
+	scanner.skipSpaceAndComments();
+	scanner.readToken(token_begin, token_end);
+	// 读取文件中顶点数、面片数、边数
+	scanner.skipSpaceAndComments();
+	if (!scanner.readInt(nVertices) || !scanner.readInt(nFaces) || !scanner.readInt(nEdges)
+		|| nVertices < 0 || nFaces < 0)
 	{
-		printf("File open success\n");
+		printf("File on error: bad OFF header\n");
+		return;
+	}
 
-		cleanData();
+	// 按文件头给出的数量一次性分配好空间，解析过程中不再扩容
+	vertex_positions.resize(nVertices);
+	faces.reserve(nFaces);
 
-		int nVertices, nFaces, nEdges;
+	// 根据顶点数，循环读取每个顶点坐标
+	for (int i = 0; i < nVertices; i++)
+	{
+		glm::vec3 &node = vertex_positions[i];
+		scanner.skipSpaceAndComments();
+		if (!scanner.readFloat(node.x) || !scanner.readFloat(node.y) || !scanner.readFloat(node.z))
+		{
+			printf("File on error: bad vertex %d\n", i);
+			cleanData();
+			return;
+		}
+	}
+	vertex_colors = vertex_positions;
 
-		// 读取OFF字符串
-		std::string str;
-		fin >> str;
-		// 读取文件中顶点数、面片数、边数
-		fin >> nVertices >> nFaces >> nEdges;
-		// 根据顶点数，循环读取每个顶点坐标
-		for (int i = 0; i < nVertices; i++)
+	// 根据面片数，循环读取每个面片信息，并用构建的vec3i结构体保存
+	// 多于三个顶点的面片按扇形拆成三角形
+	for (int i = 0; i < nFaces; i++)
+	{
+		int num, a, b, c;
+		scanner.skipSpaceAndComments();
+		// num记录此面片由几个顶点构成，a、b、c为构成该面片顶点序号
+		if (!scanner.readInt(num) || num < 3 || !scanner.readInt(a) || !scanner.readInt(b))
 		{
-			glm::vec3 tmp_node;
-			fin >> tmp_node.x >> tmp_node.y >> tmp_node.z;
-			vertex_positions.push_back(tmp_node);
-			vertex_colors.push_back(tmp_node);
+			printf("File on error: bad face %d\n", i);
+			cleanData();
+			return;
 		}
-		// 根据面片数，循环读取每个面片信息，并用构建的vec3i结构体保存
-		for (int i = 0; i < nFaces; i++)
+		for (int k = 2; k < num; k++)
 		{
-			int num, a, b, c;
-			// num记录此面片由几个顶点构成，a、b、c为构成该面片顶点序号
-			fin >> num >> a >> b >> c;
+			if (!scanner.readInt(c) || a < 0 || b < 0 || c < 0
+				|| a >= nVertices || b >= nVertices || c >= nVertices)
+			{
+				printf("File on error: bad face %d\n", i);
+				cleanData();
+				return;
+			}
 			faces.push_back(vec3i(a, b, c));
+			b = c;
 		}
+		// 面片行尾可能带有颜色等附加数据，直接跳过
+		scanner.skipLine();
 	}
-	fin.close();
 
 	normal_index = faces;
 	color_index = faces;
 	texture_index = faces;
 
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+	double megabytes = file.size() / (1024.0 * 1024.0);
+	if (Verbose())
+		printf("OFF parsed: %d vertices, %d faces, %.2f MB in %.2f ms (%.1f MB/s)\n",
+			nVertices, (int)faces.size(), megabytes, seconds * 1000.0,
+			seconds > 0.0 ? megabytes / seconds : 0.0);
+
 	storeFacesPoints();
+	saveMeshCache(filename);
+};
+
+// 二进制网格缓存 (.tmbin)
+// 文件布局：文件头 + 段表 + 各段数据（按 16 字节对齐）。
+// 各段就是 TriMesh 内部数组的原样内存，加载时映射整个文件后逐段整体拷贝，
+// 不需要逐个顶点解析。文件头记录源文件的大小、修改时间和内容哈希，用于判断缓存是否过期
+// 绘制用的数组与 vertex_* / *_index 等全部顶点数据都会恢复，命中缓存时各 get 函数的结果与重新读取时相同
+namespace {
+
+bool mesh_cache_enabled = true;
+
+const char mesh_cache_magic[4] = { 'T', 'M', 'B', 'N' };
+const uint32_t mesh_cache_version = 3;
+const uint32_t mesh_cache_flag_normalized = 1;
+const uint32_t mesh_cache_flag_indexed = 2;
+// 第 2、3 位记录计算顶点法向量时的加权方式
+const uint32_t mesh_cache_weighting_shift = 2;
+const uint32_t mesh_cache_weighting_mask = 3;
+
+enum MeshCacheSectionId
+{
+	CACHE_POINTS = 1,
+	CACHE_NORMALS,
+	CACHE_COLORS,
+	CACHE_TEXTURES,
+	CACHE_VERTEX_POSITIONS,
+	CACHE_FACES,
+	CACHE_INDICES,
+	CACHE_VERTEX_NORMALS,
+	CACHE_VERTEX_COLORS,
+	CACHE_VERTEX_TEXTURES,
+	CACHE_NORMAL_INDEX,
+	CACHE_COLOR_INDEX,
+	CACHE_TEXTURE_INDEX,
 };
 
+struct MeshCacheHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t flags;
+	uint32_t section_count;
+	uint64_t source_size;
+	int64_t source_mtime;
+	uint64_t source_hash;
+	float up_corner[3];
+	float down_corner[3];
+	float center[3];
+	float diagonal_length;
+};
+
+struct MeshCacheSection
+{
+	uint32_t id;
+	uint32_t element_size;
+	uint64_t count;
+	uint64_t offset;
+};
+
+std::string meshCachePath(const std::string& filename) { return filename + ".tmbin"; }
+
+
+template <typename T>
+bool readCacheSection(const MappedFile& cache, const MeshCacheSection& section, std::vector<T>& out)
+{
+	if (section.element_size != sizeof(T) || section.offset > cache.size()
+		|| section.count > (cache.size() - section.offset) / sizeof(T))
+		return false;
+	const T* begin = (const T*)(cache.data() + section.offset);
+	out.assign(begin, begin + section.count);
+	return true;
+}
+
+}
+
+void TriMesh::setMeshCacheEnabled(bool enabled) { mesh_cache_enabled = enabled; }
+
+bool TriMesh::loadMeshCache(const std::string& filename)
+{
+	if (!mesh_cache_enabled)
+		return false;
+
+	std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+
+	uint64_t source_size;
+	int64_t source_mtime;
+	if (!MappedFile::getFileInfo(filename, source_size, source_mtime))
+		return false;
+
+	MappedFile cache;
+	if (!cache.open(meshCachePath(filename)) || cache.size() < sizeof(MeshCacheHeader))
+		return false;
+
+	MeshCacheHeader header;
+	memcpy(&header, cache.data(), sizeof(header));
+	if (memcmp(header.magic, mesh_cache_magic, 4) != 0 || header.version != mesh_cache_version)
+		return false;
+	if (((header.flags & mesh_cache_flag_normalized) != 0) != do_normalize_size
+		|| ((header.flags & mesh_cache_flag_indexed) != 0) != use_indices
+		|| ((header.flags >> mesh_cache_weighting_shift) & mesh_cache_weighting_mask) != (uint32_t)normal_weighting)
+		return false;
+	if (header.source_size != source_size)
+		return false;
+	// 修改时间变了不一定是内容变了（例如重新拷贝了资源目录），此时再比较内容哈希
+	if (header.source_mtime != source_mtime)
+	{
+		uint64_t hash;
+		if (!MappedFile::hashFile(filename, hash) || hash != header.source_hash)
+			return false;
+	}
+
+	size_t table_size = sizeof(MeshCacheSection) * header.section_count;
+	if (cache.size() - sizeof(MeshCacheHeader) < table_size)
+		return false;
+	const MeshCacheSection* sections = (const MeshCacheSection*)(cache.data() + sizeof(MeshCacheHeader));
+
+	cleanData();
+	bool ok = true;
+	for (uint32_t i = 0; i < header.section_count && ok; i++)
+	{
+		const MeshCacheSection& section = sections[i];
+		switch (section.id)
+		{
+		case CACHE_POINTS: ok = readCacheSection(cache, section, points); break;
+		case CACHE_NORMALS: ok = readCacheSection(cache, section, normals); break;
+		case CACHE_COLORS: ok = readCacheSection(cache, section, colors); break;
+		case CACHE_TEXTURES: ok = readCacheSection(cache, section, textures); break;
+		case CACHE_VERTEX_POSITIONS: ok = readCacheSection(cache, section, vertex_positions); break;
+		case CACHE_FACES: ok = readCacheSection(cache, section, faces); break;
+		case CACHE_INDICES: ok = readCacheSection(cache, section, indices); break;
+		case CACHE_VERTEX_NORMALS: ok = readCacheSection(cache, section, vertex_normals); break;
+		case CACHE_VERTEX_COLORS: ok = readCacheSection(cache, section, vertex_colors); break;
+		case CACHE_VERTEX_TEXTURES: ok = readCacheSection(cache, section, vertex_textures); break;
+		case CACHE_NORMAL_INDEX: ok = readCacheSection(cache, section, normal_index); break;
+		case CACHE_COLOR_INDEX: ok = readCacheSection(cache, section, color_index); break;
+		case CACHE_TEXTURE_INDEX: ok = readCacheSection(cache, section, texture_index); break;
+		default: break;
+		}
+	}
+	if (!ok)
+	{
+		cleanData();
+		return false;
+	}
+
+	up_corner = glm::vec3(header.up_corner[0], header.up_corner[1], header.up_corner[2]);
+	down_corner = glm::vec3(header.down_corner[0], header.down_corner[1], header.down_corner[2]);
+	center = glm::vec3(header.center[0], header.center[1], header.center[2]);
+	diagonal_length = header.diagonal_length;
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+	if (Verbose())
+		printf("Mesh cache hit: %s (%d points) in %.2f ms\n",
+			meshCachePath(filename).c_str(), (int)points.size(), seconds * 1000.0);
+	return true;
+}
+
+void TriMesh::saveMeshCache(const std::string& filename)
+{
+	if (!mesh_cache_enabled)
+		return;
+
+	MeshCacheHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, mesh_cache_magic, 4);
+	header.version = mesh_cache_version;
+	header.flags = (do_normalize_size ? mesh_cache_flag_normalized : 0)
+		| (use_indices ? mesh_cache_flag_indexed : 0)
+		| ((uint32_t)normal_weighting << mesh_cache_weighting_shift);
+	if (!MappedFile::getFileInfo(filename, header.source_size, header.source_mtime)
+		|| !MappedFile::hashFile(filename, header.source_hash))
+		return;
+	for (int k = 0; k < 3; k++)
+	{
+		header.up_corner[k] = up_corner[k];
+		header.down_corner[k] = down_corner[k];
+		header.center[k] = center[k];
+	}
+	header.diagonal_length = diagonal_length;
+
+	struct SectionData { uint32_t id; uint32_t element_size; uint64_t count; const void* data; };
+	const SectionData data[] = {
+		{ CACHE_POINTS, sizeof(glm::vec3), points.size(), points.data() },
+		{ CACHE_NORMALS, sizeof(glm::vec3), normals.size(), normals.data() },
+		{ CACHE_COLORS, sizeof(glm::vec3), colors.size(), colors.data() },
+		{ CACHE_TEXTURES, sizeof(glm::vec2), textures.size(), textures.data() },
+		{ CACHE_VERTEX_POSITIONS, sizeof(glm::vec3), vertex_positions.size(), vertex_positions.data() },
+		{ CACHE_FACES, sizeof(vec3i), faces.size(), faces.data() },
+		{ CACHE_INDICES, sizeof(unsigned int), indices.size(), indices.data() },
+		{ CACHE_VERTEX_NORMALS, sizeof(glm::vec3), vertex_normals.size(), vertex_normals.data() },
+		{ CACHE_VERTEX_COLORS, sizeof(glm::vec3), vertex_colors.size(), vertex_colors.data() },
+		{ CACHE_VERTEX_TEXTURES, sizeof(glm::vec2), vertex_textures.size(), vertex_textures.data() },
+		{ CACHE_NORMAL_INDEX, sizeof(vec3i), normal_index.size(), normal_index.data() },
+		{ CACHE_COLOR_INDEX, sizeof(vec3i), color_index.size(), color_index.data() },
+		{ CACHE_TEXTURE_INDEX, sizeof(vec3i), texture_index.size(), texture_index.data() },
+	};
+	const uint32_t section_count = sizeof(data) / sizeof(data[0]);
+	header.section_count = section_count;
+
+	MeshCacheSection sections[section_count];
+	uint64_t offset = sizeof(MeshCacheHeader) + sizeof(sections);
+	for (uint32_t i = 0; i < section_count; i++)
+	{
+		offset = (offset + 15) & ~uint64_t(15);
+		sections[i].id = data[i].id;
+		sections[i].element_size = data[i].element_size;
+		sections[i].count = data[i].count;
+		sections[i].offset = offset;
+		offset += data[i].count * data[i].element_size;
+	}
+
+	std::string path = meshCachePath(filename);
+	AtomicFileWriter writer(path);
+	if (!writer.isOpen())
+	{
+		std::cout << "WARNING: cannot write mesh cache " << path << std::endl;
+		return;
+	}
+	writer.write(&header, sizeof(header));
+	writer.write(sections, sizeof(sections));
+	for (uint32_t i = 0; i < section_count; i++)
+	{
+		writer.align(16);
+		writer.write(data[i].data, (size_t)(data[i].count * data[i].element_size));
+	}
+	writer.commit();
+}
+
+// OBJ 并行解析
+// 文件被切成若干按换行对齐的块，每块在线程池里独立解析成局部数组，
+// 最后按各块的顶点/面片数做前缀和，把局部数组拼接到最终位置
+namespace {
+
+// 解析 OBJ 使用的线程数，0 表示使用线程池的全部线程
+unsigned int obj_parse_threads = 0;
+
+// 每块至少这么大，太小的块调度开销比解析本身还大
+const size_t obj_min_chunk_size = 256 * 1024;
+
+struct ObjChunk
+{
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec2> texcoords;
+	std::vector<glm::vec3> normals;
+
+	// 每个三角形 9 个下标：3 个角点 × (顶点, 纹理, 法向量)，-1 表示缺省
+	std::vector<int> corners;
+	// 使用了负数（相对）下标的角点在 corners 中的位置，
+	// 这些下标要在合并时再加上前面各块的数量
+	std::vector<size_t> relative_corners;
+
+	bool missing_texture;
+	bool missing_normal;
+	bool bad_index;
+
+	ObjChunk() : missing_texture(false), missing_normal(false), bad_index(false) {}
+};
+
+// 把 OBJ 下标转成从 0 开始的下标
+// 正数是从 1 开始的绝对下标；负数是相对当前已读数量的下标，先转成块内下标并记录位置
+inline int resolveObjIndex(int index, size_t local_count, ObjChunk& chunk, size_t slot)
+{
+	if (index > 0)
+		return index - 1;
+	if (index < 0) {
+		chunk.relative_corners.push_back(slot);
+		return (int)local_count + index;
+	}
+	chunk.bad_index = true;
+	return -1;
+}
+
+// 行内读取一个浮点数，数据不全时不会读到下一行去
+inline bool readLineFloat(TextScanner& scanner, float& value)
+{
+	scanner.skipBlank();
+	return scanner.parseFloat(value);
+}
+
+// 解析 "v", "v/vt", "v//vn", "v/vt/vn" 形式的一个角点，缺省的部分记为 0
+bool parseObjCorner(TextScanner& scanner, int corner[3])
+{
+	corner[0] = corner[1] = corner[2] = 0;
+	if (!scanner.parseInt(corner[0]))
+		return false;
+	if (scanner.consume('/')) {
+		if (!scanner.consume('/')) {
+			scanner.parseInt(corner[1]);
+			if (!scanner.consume('/'))
+				return true;
+		}
+		scanner.parseInt(corner[2]);
+	}
+	return true;
+}
+
+void parseObjChunk(const char* begin, const char* end, ObjChunk& chunk)
+{
+	TextScanner scanner(begin, end);
+	// 一个面片的角点，多边形按扇形拆成三角形
+	std::vector<int> polygon;
+
+	while (!scanner.atEnd())
+	{
+		scanner.skipBlank();
+		const char* p = scanner.position();
+		size_t remaining = end - p;
+
+		if (remaining >= 2 && p[0] == 'v' && (p[1] == ' ' || p[1] == '\t'))
+		{
+			scanner.consume('v');
+			glm::vec3 v;
+			if (readLineFloat(scanner, v.x) && readLineFloat(scanner, v.y) && readLineFloat(scanner, v.z))
+				chunk.positions.push_back(v);
+		}
+		else if (remaining >= 3 && p[0] == 'v' && p[1] == 't' && (p[2] == ' ' || p[2] == '\t'))
+		{
+			scanner.consume('v');
+			scanner.consume('t');
+			glm::vec2 vt;
+			if (readLineFloat(scanner, vt.x) && readLineFloat(scanner, vt.y))
+				chunk.texcoords.push_back(vt);
+		}
+		else if (remaining >= 3 && p[0] == 'v' && p[1] == 'n' && (p[2] == ' ' || p[2] == '\t'))
+		{
+			scanner.consume('v');
+			scanner.consume('n');
+			glm::vec3 vn;
+			if (readLineFloat(scanner, vn.x) && readLineFloat(scanner, vn.y) && readLineFloat(scanner, vn.z))
+				chunk.normals.push_back(vn);
+		}
+		else if (remaining >= 2 && p[0] == 'f' && (p[1] == ' ' || p[1] == '\t'))
+		{
+			scanner.consume('f');
+			polygon.clear();
+			int corner[3];
+			for (;;)
+			{
+				scanner.skipBlank();
+				if (scanner.atLineEnd() || !parseObjCorner(scanner, corner))
+					break;
+				polygon.push_back(corner[0]);
+				polygon.push_back(corner[1]);
+				polygon.push_back(corner[2]);
+			}
+
+			size_t num = polygon.size() / 3;
+			for (size_t k = 2; k < num; k++)
+			{
+				const size_t fan[3] = { 0, k - 1, k };
+				for (int j = 0; j < 3; j++)
+				{
+					const int* c = &polygon[fan[j] * 3];
+					size_t slot = chunk.corners.size();
+					chunk.corners.push_back(resolveObjIndex(c[0], chunk.positions.size(), chunk, slot));
+					if (c[1] != 0)
+						chunk.corners.push_back(resolveObjIndex(c[1], chunk.texcoords.size(), chunk, slot + 1));
+					else {
+						chunk.corners.push_back(-1);
+						chunk.missing_texture = true;
+					}
+					if (c[2] != 0)
+						chunk.corners.push_back(resolveObjIndex(c[2], chunk.normals.size(), chunk, slot + 2));
+					else {
+						chunk.corners.push_back(-1);
+						chunk.missing_normal = true;
+					}
+				}
+			}
+		}
+		// 注释、o/g/s/usemtl 等其余行直接跳过
+		scanner.skipLine();
+	}
+}
+
+}
+
+void TriMesh::setObjParseThreads(unsigned int num_threads) { obj_parse_threads = num_threads; }
+
 void TriMesh::readObj(const std::string& filename)
 {
-	std::ifstream fin(filename);
-	std::string line;
+	// 缓存有效时直接使用缓存
+	if (loadMeshCache(filename))
+		return;
+
+	std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
 
-	if (!fin)
+	MappedFile file;
+	if (!file.open(filename))
 	{
 		std::cout << "ERROR: cannot open the file: " << filename << std::endl;
 		exit(0);	// 退出程序
@@ -576,32 +1389,141 @@ void TriMesh::readObj(const std::string& filename)
 
 	cleanData();
 
-	// @TODO: 读取obj文件，记录里面的这些数据
-	// vertex_positions
-	// vertex_normals
-	// vertex_textures		
+	// 按线程数和最小块大小切块，每个块的起点都挪到下一行行首
+	ThreadPool& pool = ThreadPool::shared();
+	size_t num_threads = obj_parse_threads == 0 ? pool.size() + 1 : obj_parse_threads;
+	// 单线程时整个文件作为一块，作为对比并行加速的基准
+	size_t num_chunks = num_threads <= 1 ? 1 : file.size() / obj_min_chunk_size + 1;
+	if (num_chunks > num_threads * 4) num_chunks = num_threads * 4;
 
-	// faces
-	// normal_index
-	// texture_index
+	std::vector<const char*> bounds(1, file.data());
+	for (size_t i = 1; i < num_chunks; i++)
+	{
+		const char* p = file.data() + file.size() * i / num_chunks;
+		if (p < bounds.back()) p = bounds.back();
+		const char* nl = (const char*)memchr(p, '\n', file.end() - p);
+		p = nl ? nl + 1 : file.end();
+		if (p > bounds.back() && p < file.end())
+			bounds.push_back(p);
+	}
+	bounds.push_back(file.end());
+	num_chunks = bounds.size() - 1;
 
-	// 其中vertex_color和color_index可以用法向量的数值赋值
-		
-	while (std::getline(fin, line))
+	// 解析与合并都按块执行，单线程时在当前线程依次处理，不经过线程池
+	auto forEachChunk = [&](const std::function<void(size_t)>& fn) {
+		if (num_threads <= 1)
+		{
+			for (size_t i = 0; i < num_chunks; i++)
+				fn(i);
+		}
+		else
+		{
+			pool.parallelFor(num_chunks, fn);
+		}
+	};
+
+	std::vector<ObjChunk> chunks(num_chunks);
+	forEachChunk([&](size_t i) {
+		parseObjChunk(bounds[i], bounds[i + 1], chunks[i]);
+	});
+
+	// 前缀和：每块的数据在最终数组中的起始位置
+	std::vector<size_t> position_offset(num_chunks + 1, 0);
+	std::vector<size_t> texcoord_offset(num_chunks + 1, 0);
+	std::vector<size_t> normal_offset(num_chunks + 1, 0);
+	std::vector<size_t> face_offset(num_chunks + 1, 0);
+	bool missing_texture = false, missing_normal = false, bad_index = false;
+	for (size_t i = 0; i < num_chunks; i++)
 	{
-		std::istringstream sin(line);
-		std::string type;
-		GLfloat _x, _y, _z;
-		int a0, b0, c0;
-		int a1, b1, c1;
-		int a2, b2, c2;
-		char slash;
+		position_offset[i + 1] = position_offset[i] + chunks[i].positions.size();
+		texcoord_offset[i + 1] = texcoord_offset[i] + chunks[i].texcoords.size();
+		normal_offset[i + 1] = normal_offset[i] + chunks[i].normals.size();
+		face_offset[i + 1] = face_offset[i] + chunks[i].corners.size() / 9;
+		missing_texture = missing_texture || chunks[i].missing_texture;
+		missing_normal = missing_normal || chunks[i].missing_normal;
+		bad_index = bad_index || chunks[i].bad_index;
+	}
 
-		// xxxxxxx
+	const size_t num_positions = position_offset[num_chunks];
+	const size_t num_texcoords = texcoord_offset[num_chunks];
+	const size_t num_normals = normal_offset[num_chunks];
+	const size_t num_faces = face_offset[num_chunks];
+
+	vertex_positions.resize(num_positions);
+	vertex_textures.resize(num_texcoords);
+	vertex_normals.resize(num_normals);
+	faces.assign(num_faces, vec3i(0, 0, 0));
+	texture_index.assign(num_faces, vec3i(0, 0, 0));
+	normal_index.assign(num_faces, vec3i(0, 0, 0));
+
+	// 某些面片缺少纹理坐标时用第 0 个代替；缺少法向量时整体改为由面片重新计算
+	const bool use_textures = num_texcoords > 0;
+	const bool use_normals = num_normals > 0 && !missing_normal;
+
+	// 合并：各块互不重叠，可以并行拷贝
+	std::vector<char> chunk_bad(num_chunks, 0);
+	forEachChunk([&](size_t i) {
+		ObjChunk& chunk = chunks[i];
+		std::copy(chunk.positions.begin(), chunk.positions.end(), vertex_positions.begin() + position_offset[i]);
+		std::copy(chunk.texcoords.begin(), chunk.texcoords.end(), vertex_textures.begin() + texcoord_offset[i]);
+		std::copy(chunk.normals.begin(), chunk.normals.end(), vertex_normals.begin() + normal_offset[i]);
+
+		const size_t offsets[3] = { position_offset[i], texcoord_offset[i], normal_offset[i] };
+		for (size_t k = 0; k < chunk.relative_corners.size(); k++)
+		{
+			size_t slot = chunk.relative_corners[k];
+			chunk.corners[slot] += (int)offsets[slot % 3];
+		}
 
+		const size_t limits[3] = { num_positions, num_texcoords, num_normals };
+		int* c = chunk.corners.data();
+		size_t n = chunk.corners.size() / 9;
+		for (size_t f = 0; f < n; f++, c += 9)
+		{
+			for (int j = 0; j < 9; j++)
+			{
+				if (j % 3 == 1 && c[j] < 0 && use_textures) c[j] = 0;
+				if (j % 3 != 0 && c[j] < 0) continue;
+				if (c[j] < 0 || (size_t)c[j] >= limits[j % 3])
+				{
+					chunk_bad[i] = 1;
+					c[j] = 0;
+				}
+			}
+			size_t dst = face_offset[i] + f;
+			faces[dst] = vec3i(c[0], c[3], c[6]);
+			if (use_textures) texture_index[dst] = vec3i(c[1], c[4], c[7]);
+			if (use_normals) normal_index[dst] = vec3i(c[2], c[5], c[8]);
+		}
+	});
+	for (size_t i = 0; i < num_chunks; i++)
+		bad_index = bad_index || chunk_bad[i];
+	if (bad_index)
+		std::cout << "WARNING: " << filename << " contains out-of-range indices" << std::endl;
+
+	if (!use_textures)
+		texture_index.clear();
+	if (!use_normals)
+	{
+		// 文件没有（完整的）法向量，按面片计算顶点法向量
+		vertex_normals.clear();
+		computeVertexNormals();
+		normal_index = faces;
 	}
+	// 其中vertex_color和color_index用法向量的数值赋值
+	vertex_colors = vertex_normals;
+	color_index = normal_index;
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+	double megabytes = file.size() / (1024.0 * 1024.0);
+	if (Verbose())
+		printf("OBJ parsed: %d vertices, %d faces, %.2f MB in %.2f ms (%.1f MB/s, %d chunks, %d threads)\n",
+			(int)num_positions, (int)num_faces, megabytes, seconds * 1000.0,
+			seconds > 0.0 ? megabytes / seconds : 0.0, (int)num_chunks,
+			(int)std::min(std::min(num_threads, (size_t)pool.size() + 1), num_chunks));
 
 	storeFacesPoints();
+	saveMeshCache(filename);
 }
 
 
@@ -0,0 +1,171 @@
+#include "VertexFormat.h"
+
+#include <cmath>
+#include <cstring>
+
+uint16_t floatToHalf(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	uint16_t sign = (uint16_t)((bits >> 16) & 0x8000);
+	uint32_t magnitude = bits & 0x7FFFFFFF;
+
+	// inf 与 nan
+	if (magnitude >= 0x7F800000)
+		return sign | 0x7C00 | (magnitude > 0x7F800000 ? 0x200 : 0);
+	// 超过 half 的表示范围（舍入后大于 65504）
+	if (magnitude >= 0x477FF000)
+		return sign | 0x7C00;
+	// 小于 2^-14 的数只能表示为非规格化数，单位为 2^-24
+	if (magnitude < 0x38800000)
+	{
+		if (magnitude < 0x33000000)
+			return sign;
+		uint32_t mantissa = (magnitude & 0x7FFFFF) | 0x800000;
+		int shift = 126 - (int)(magnitude >> 23);
+		uint32_t result = mantissa >> shift;
+		uint32_t remainder = mantissa & ((1u << shift) - 1);
+		uint32_t halfway = 1u << (shift - 1);
+		if (remainder > halfway || (remainder == halfway && (result & 1)))
+			result++;
+		return sign | (uint16_t)result;
+	}
+	// 规格化数：指数偏移从 127 改为 15，尾数舍去低 13 位（就近舍入到偶数）
+	uint32_t h = magnitude - 0x38000000;
+	h += 0xFFF + ((h >> 13) & 1);
+	return sign | (uint16_t)(h >> 13);
+}
+
+float halfToFloat(uint16_t value)
+{
+	uint32_t sign = (uint32_t)(value & 0x8000) << 16;
+	uint32_t exponent = (value >> 10) & 0x1F;
+	uint32_t mantissa = value & 0x3FF;
+
+	if (exponent == 0)
+	{
+		float f = std::ldexp((float)mantissa, -24);
+		return sign ? -f : f;
+	}
+
+	uint32_t bits;
+	if (exponent == 31)
+		bits = sign | 0x7F800000 | (mantissa << 13);
+	else
+		bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+	float f;
+	memcpy(&f, &bits, sizeof(f));
+	return f;
+}
+
+int16_t floatToSnorm16(float value)
+{
+	if (value > 1.0f) value = 1.0f;
+	if (value < -1.0f) value = -1.0f;
+	return (int16_t)std::floor(value * 32767.0f + 0.5f);
+}
+
+uint8_t floatToUnorm8(float value)
+{
+	if (value > 1.0f) value = 1.0f;
+	if (value < 0.0f) value = 0.0f;
+	return (uint8_t)std::floor(value * 255.0f + 0.5f);
+}
+
+// 八面体映射：先把单位球投影到 |x|+|y|+|z|=1 的八面体上，
+// 再把下半部分的四个三角形翻折到正方形的四个角
+glm::vec2 octEncode(const glm::vec3& normal)
+{
+	float l1 = std::fabs(normal.x) + std::fabs(normal.y) + std::fabs(normal.z);
+	if (l1 == 0.0f)
+		return glm::vec2(0.0f, 0.0f);
+	float x = normal.x / l1;
+	float y = normal.y / l1;
+	if (normal.z < 0.0f)
+	{
+		float folded_x = (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+		float folded_y = (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+		x = folded_x;
+		y = folded_y;
+	}
+	return glm::vec2(x, y);
+}
+
+glm::vec3 octDecode(const glm::vec2& encoded)
+{
+	glm::vec3 n(encoded.x, encoded.y, 1.0f - std::fabs(encoded.x) - std::fabs(encoded.y));
+	float t = n.z < 0.0f ? -n.z : 0.0f;
+	n.x += n.x >= 0.0f ? -t : t;
+	n.y += n.y >= 0.0f ? -t : t;
+	return glm::normalize(n);
+}
+
+void packVertices(const std::vector<glm::vec3>& points,
+	const std::vector<glm::vec3>& normals,
+	const std::vector<glm::vec3>& colors,
+	const std::vector<glm::vec2>& textures,
+	std::vector<PackedVertex>& packed,
+	glm::vec3& position_offset, glm::vec3& position_scale)
+{
+	packed.resize(points.size());
+
+	// 坐标相对包围盒量化，包围盒越小精度越高
+	glm::vec3 min_corner(0.0f), max_corner(0.0f);
+	if (!points.empty())
+	{
+		min_corner = max_corner = points[0];
+		for (size_t i = 1; i < points.size(); i++)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				if (points[i][k] < min_corner[k]) min_corner[k] = points[i][k];
+				if (points[i][k] > max_corner[k]) max_corner[k] = points[i][k];
+			}
+		}
+	}
+	glm::vec3 half_extent;
+	for (int k = 0; k < 3; k++)
+	{
+		position_offset[k] = (min_corner[k] + max_corner[k]) * 0.5f;
+		half_extent[k] = (max_corner[k] - min_corner[k]) * 0.5f;
+		// 平面物体在某个方向上厚度为 0，避免除以 0
+		if (half_extent[k] < 1e-8f) half_extent[k] = 1.0f;
+		// 着色器直接读取整数值，1/32767 一并放进缩放系数里
+		position_scale[k] = half_extent[k] / 32767.0f;
+	}
+
+	for (size_t i = 0; i < points.size(); i++)
+	{
+		PackedVertex& v = packed[i];
+		for (int k = 0; k < 3; k++)
+			v.position[k] = floatToSnorm16((points[i][k] - position_offset[k]) / half_extent[k]);
+		v.position[3] = 0;
+
+		glm::vec2 oct = i < normals.size() ? octEncode(normals[i]) : glm::vec2(0.0f, 0.0f);
+		v.normal[0] = floatToSnorm16(oct.x);
+		v.normal[1] = floatToSnorm16(oct.y);
+
+		glm::vec3 color = i < colors.size() ? colors[i] : glm::vec3(0.0f);
+		v.color[0] = floatToUnorm8(color.x);
+		v.color[1] = floatToUnorm8(color.y);
+		v.color[2] = floatToUnorm8(color.z);
+		v.color[3] = 255;
+
+		glm::vec2 uv = i < textures.size() ? textures[i] : glm::vec2(0.0f, 0.0f);
+		v.texture[0] = floatToHalf(uv.x);
+		v.texture[1] = floatToHalf(uv.y);
+	}
+}
+
+bool colorsFitUnorm8(const std::vector<glm::vec3>& colors)
+{
+	for (size_t i = 0; i < colors.size(); i++)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			if (!(colors[i][k] >= 0.0f && colors[i][k] <= 1.0f))
+				return false;
+		}
+	}
+	return true;
+}
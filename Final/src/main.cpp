@@ -1,154 +1,41 @@
-#define _CRT_SECURE_NO_WARNINGS // VS需要这个来忽略fopen警告
-#ifdef __APPLE__
-#include <GLUT/glut.h>
-#else
-#include <GL/glut.h>
-#endif
+#include "Angel.h"
+#include "TriMesh.h"
+#include "Camera.h"
+#include "MeshPainter.h"
+#include "ShadowMap.h"
+#include "SceneGraph.h"
+
 #include <iostream>
+#include <fstream>
 #include <vector>
 #include <string>
-#include <fstream>
-#include <sstream>
 #include <cmath>
-#include <iomanip>
-
-// 引入 stb_image 用于加载真实图片
-//#define STB_IMAGE_IMPLEMENTATION
-#include "stb_image.h"
-
-#ifdef __APPLE__
-void glutSolidCylinder(GLdouble radius, GLdouble height, GLint slices, GLint stacks) {
-    GLUquadric *quad = gluNewQuadric();
-    gluQuadricDrawStyle(quad, GLU_FILL);
-    gluCylinder(quad, radius, radius, height, slices, stacks);
-    glPushMatrix();
-    glRotatef(180, 1, 0, 0);
-    gluDisk(quad, 0, radius, slices, 1);
-    glPopMatrix();
-    glPushMatrix();
-    glTranslatef(0, 0, height);
-    gluDisk(quad, 0, radius, slices, 1);
-    glPopMatrix();
-    gluDeleteQuadric(quad);
-}
-#endif
-
-// ================= 基础结构体 =================
-struct Vertex { float x, y, z; };
-struct TexCoord { float u, v; };
-struct Normal { float nx, ny, nz; };
-struct Face {
-    int vIndices[3];
-    int tIndices[3];
-    int nIndices[3];
-};
-
-// 模型类
-class Model {
-public:
-    std::vector<Vertex> vertices;
-    std::vector<TexCoord> texCoords;
-    std::vector<Normal> normals;
-    std::vector<Face> faces;
-    GLuint displayListId; // 使用显示列表优化性能
-
-    void load(const std::string& filename) {
-        std::ifstream file(filename);
-        if (!file.is_open()) {
-            std::cerr << "无法打开文件: " << filename << std::endl;
-            return;
-        }
-
-        std::string line;
-        while (std::getline(file, line)) {
-            std::stringstream ss(line);
-            std::string prefix;
-            ss >> prefix;
+#include <cstring>
 
-            if (prefix == "v") {
-                Vertex v; ss >> v.x >> v.y >> v.z;
-                vertices.push_back(v);
-            }
-            else if (prefix == "vt") {
-                TexCoord t; ss >> t.u >> t.v;
-                texCoords.push_back(t);
-            }
-            else if (prefix == "vn") {
-                Normal n; ss >> n.nx >> n.ny >> n.nz;
-                normals.push_back(n);
-            }
-            else if (prefix == "f") {
-                Face f;
-                char slash;
-                for (int i = 0; i < 3; ++i) {
-                    ss >> f.vIndices[i];
-                    // 处理 obj 的 f v/vt/vn 格式
-                    if (ss.peek() == '/') {
-                        ss.ignore(); // 忽略第一个 /
-                        if (ss.peek() != '/') { // 如果不是 //，说明有纹理
-                            ss >> f.tIndices[i];
-                        }
-                        if (ss.peek() == '/') {
-                            ss.ignore(); // 忽略第二个 /
-                            ss >> f.nIndices[i];
-                        }
-                    }
-                    // OBJ 索引从1开始，我们要减1
-                    f.vIndices[i]--;
-                    if (f.tIndices[i] > 0) f.tIndices[i]--;
-                    if (f.nIndices[i] > 0) f.nIndices[i]--;
-                }
-                faces.push_back(f);
-            }
-        }
-        file.close();
-        
-        // 生成显示列表
-        displayListId = glGenLists(1);
-        glNewList(displayListId, GL_COMPILE);
-        drawImmediate();
-        glEndList();
-        std::cout << "模型加载成功: " << filename << " (面数: " << faces.size() << ")" << std::endl;
-    }
-
-    void draw() {
-        if (displayListId) glCallList(displayListId);
-        else drawImmediate();
-    }
+// ================= 全局变量 =================
 
-private:
-    void drawImmediate() {
-        glBegin(GL_TRIANGLES);
-        for (const auto& face : faces) {
-            for (int i = 0; i < 3; ++i) {
-                if (!normals.empty() && face.nIndices[i] >= 0) {
-                    const auto& n = normals[face.nIndices[i]];
-                    glNormal3f(n.nx, n.ny, n.nz);
-                }
-                if (!texCoords.empty() && face.tIndices[i] >= 0) {
-                    const auto& t = texCoords[face.tIndices[i]];
-                    glTexCoord2f(t.u, t.v);
-                }
-                const auto& v = vertices[face.vIndices[i]];
-                glVertex3f(v.x, v.y, v.z);
-            }
-        }
-        glEnd();
-    }
-};
+int WIDTH = 1024;
+int HEIGHT = 768;
 
-// ================= 全局变量 =================
+Camera* camera = new Camera();
+Light* light = new Light();
+MeshPainter* painter = new MeshPainter();
+ShadowMap* shadowMap = new ShadowMap(1024);
 
-// 场景模型
-Model mdlLamp;
-Model mdlCube; // 如果你有cube.obj，或者我们用代码画
+const std::string vshader = "shaders/main.vs";
+const std::string fshader = "shaders/main.fs";
 
-// 纹理ID
-GLuint texFloor, texWall, texWood;
+// 场景物体在 painter 中的下标
+// 房间各面直接用自身的模型矩阵绘制，机械臂各部件共用几个基本网格，由 drawRobot 按关节矩阵绘制
+std::vector<int> roomMeshes;
+int meshBase, meshBaseTop, meshJoint, meshArm, meshTarget;
+int meshLamp = -1;
 
 // 相机与控制
 float camAngleX = 0.0f, camAngleY = 20.0f, camDist = 20.0f;
-int mouseLeftDown = 0, mouseX = 0, mouseY = 0;
+int mouseLeftDown = 0;
+double mouseX = 0.0, mouseY = 0.0;
+double pressX = 0.0, pressY = 0.0; // 按下左键的位置，松开时几乎没有移动就当作点击拾取
 
 // 机械臂状态
 float baseRot = 0.0f;    // 底座旋转
@@ -157,6 +44,13 @@ float arm2Rot = -45.0f;  // 小臂角度
 float clawAngle = 0.0f;  // 爪子开合角度 (0闭合, 30张开)
 float clawRot = 0.0f;    // 爪子整体旋转
 
+// 工厂场景：armGrid x armGrid 台姿态相同的机械臂排成方阵，正中间一台在原点，负责抓取物体
+// 每行台数取奇数保证原点上有一台，G 键在 1 / 5 / 11 之间切换
+int armGrid = 1;
+const float ARM_SPACING = 2.6f;
+// 实例化绘制：每种部件网格一次绘制；关闭后每台机械臂的每个部件单独绘制，I 键切换
+bool useInstancing = true;
+
 // 物理与抓取
 struct ObjectState {
     float x, y, z;
@@ -165,340 +59,307 @@ struct ObjectState {
 };
 ObjectState targetObj = { 5.0f, 0.5f, 5.0f, false, 0.0f };
 
-// 机械臂末端坐标 (计算得出)
-float clawWorldX, clawWorldY, clawWorldZ;
+// 机械臂的层级模型：关节节点保存关节角度，部件节点挂在关节下面，给出网格自身的位置和缩放
+// 世界矩阵缓存在场景图中，只有角度变化的关节及其子树会重新计算
+SceneGraph armScene;
+int nodeBaseJoint, nodeShoulder, nodeElbow, nodeWrist, nodeLeftFinger, nodeRightFinger, nodeCaught;
+struct ArmPart {
+    int mesh;
+    int node;
+    const char* name; // 鼠标拾取时显示
+};
+std::vector<ArmPart> armParts;
 
 // 灯光位置 (对应屋顶的灯)
-GLfloat lightPos[] = { 0.0f, 9.5f, 0.0f, 1.0f }; // 假设屋顶高10
-
-// PI
-const float PI = 3.1415926535f;
+glm::vec3 lightPos(0.0f, 9.5f, 0.0f); // 假设屋顶高10
 
 // ================= 辅助函数 =================
 
-// 加载纹理
-GLuint loadTexture(const char* filename) {
-    int width, height, nrChannels;
-    unsigned char* data = stbi_load(filename, &width, &height, &nrChannels, 0);
-    GLuint textureID = 0;
-    if (data) {
-        glGenTextures(1, &textureID);
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        // 设置纹理环绕方式
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        // 过滤方式
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        GLenum format = (nrChannels == 4) ? GL_RGBA : GL_RGB;
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        stbi_image_free(data);
-        std::cout << "纹理加载成功: " << filename << std::endl;
-    } else {
-        std::cout << "纹理加载失败: " << filename << std::endl;
-    }
-    return textureID;
+void setMaterial(TriMesh* mesh, glm::vec3 ambient, glm::vec3 diffuse, glm::vec3 specular, float shininess) {
+    mesh->setAmbient(glm::vec4(ambient, 1.0f));
+    mesh->setDiffuse(glm::vec4(diffuse, 1.0f));
+    mesh->setSpecular(glm::vec4(specular, 1.0f));
+    mesh->setShininess(shininess);
+}
+
+// 场景中的网格都使用索引模式，合并重复顶点后用 glDrawElements 绘制。
+// 不做大小归一化：房间与机械臂按生成时的单位尺寸（单位正方形/立方体、半径 1 的圆柱和球）
+// 摆放，灯具模型按原始坐标缩小 0.1，与原来 GLUT 版本的尺寸一致
+TriMesh* newIndexedMesh() {
+    TriMesh* mesh = new TriMesh();
+    mesh->setIndexed(true);
+    mesh->setNormalize(false);
+    return mesh;
+}
+
+// 房间的一个面：单位正方形缩放、旋转到对应位置，uvScale 为纹理重复次数
+int addRoomFace(const std::string& name, const std::string& texture, glm::vec3 color,
+    glm::vec3 translation, glm::vec3 rotation, glm::vec3 scale, glm::vec2 uvScale, ShadowCasterType caster) {
+    TriMesh* face = newIndexedMesh();
+    face->generateSquare(color);
+    face->setTranslation(translation);
+    face->setRotation(rotation);
+    face->setScale(scale);
+    setMaterial(face, glm::vec3(0.2f), glm::vec3(0.8f), glm::vec3(0.1f), 8.0f);
+    painter->addMesh(face, name, texture, vshader, fshader);
+
+    int index = (int)painter->getMeshes().size() - 1;
+    painter->setTextureScale(index, uvScale);
+    painter->setShadowCaster(index, caster);
+    roomMeshes.push_back(index);
+    return index;
 }
 
-// 绘制房间 (包含地板、墙壁、天花板)
-void drawRoom() {
+// 机械臂部件：网格在物体坐标系中保持单位大小，由 drawRobot 给出完整的模型矩阵
+int addPart(TriMesh* mesh, const std::string& name, glm::vec3 ambient, glm::vec3 diffuse) {
+    setMaterial(mesh, ambient, diffuse, glm::vec3(0.5f), 32.0f);
+    painter->addMesh(mesh, name, "", vshader, fshader);
+
+    int index = (int)painter->getMeshes().size() - 1;
+    // 每帧都可能移动，不进入静态阴影缓存
+    painter->setShadowCaster(index, SHADOW_CASTER_DYNAMIC);
+    return index;
+}
+
+// 建立房间 (包含地板、墙壁、天花板)
+void initRoom() {
     float roomSize = 15.0f; // 房间半径
     float height = 10.0f;
+    glm::vec3 white(1.0f, 1.0f, 1.0f);
 
-    // 1. 地板
-    glEnable(GL_TEXTURE_2D);
-    glBindTexture(GL_TEXTURE_2D, texFloor);
-    glBegin(GL_QUADS);
-    glNormal3f(0, 1, 0);
-    glTexCoord2f(0, 0); glVertex3f(-roomSize, 0, roomSize);
-    glTexCoord2f(5, 0); glVertex3f(roomSize, 0, roomSize);
-    glTexCoord2f(5, 5); glVertex3f(roomSize, 0, -roomSize);
-    glTexCoord2f(0, 5); glVertex3f(-roomSize, 0, -roomSize);
-    glEnd();
+    // 1. 地板：最低处，不会挡住任何物体
+    addRoomFace("floor", "assets/textures/floor.jpg", white,
+        glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(-90.0f, 0.0f, 0.0f),
+        glm::vec3(2 * roomSize, 2 * roomSize, 1.0f), glm::vec2(5.0f, 5.0f), SHADOW_CASTER_NONE);
 
     // 2. 墙壁 (画3面，留一面看进去)
-    glBindTexture(GL_TEXTURE_2D, texWall);
-    glBegin(GL_QUADS);
-    // 后墙
-    glNormal3f(0, 0, 1);
-    glTexCoord2f(0, 0); glVertex3f(-roomSize, 0, -roomSize);
-    glTexCoord2f(2, 0); glVertex3f(roomSize, 0, -roomSize);
-    glTexCoord2f(2, 1); glVertex3f(roomSize, height, -roomSize);
-    glTexCoord2f(0, 1); glVertex3f(-roomSize, height, -roomSize);
-    
-    // 左墙
-    glNormal3f(1, 0, 0);
-    glTexCoord2f(0, 0); glVertex3f(-roomSize, 0, roomSize);
-    glTexCoord2f(2, 0); glVertex3f(-roomSize, 0, -roomSize);
-    glTexCoord2f(2, 1); glVertex3f(-roomSize, height, -roomSize);
-    glTexCoord2f(0, 1); glVertex3f(-roomSize, height, roomSize);
-
-    // 右墙
-    glNormal3f(-1, 0, 0);
-    glTexCoord2f(0, 0); glVertex3f(roomSize, 0, -roomSize);
-    glTexCoord2f(2, 0); glVertex3f(roomSize, 0, roomSize);
-    glTexCoord2f(2, 1); glVertex3f(roomSize, height, roomSize);
-    glTexCoord2f(0, 1); glVertex3f(roomSize, height, -roomSize);
-    glEnd();
-
-    // 3. 天花板 (简单白色)
-    glDisable(GL_TEXTURE_2D);
-    glColor3f(0.9f, 0.9f, 0.9f);
-    glBegin(GL_QUADS);
-    glNormal3f(0, -1, 0);
-    glVertex3f(-roomSize, height, -roomSize);
-    glVertex3f(roomSize, height, -roomSize);
-    glVertex3f(roomSize, height, roomSize);
-    glVertex3f(-roomSize, height, roomSize);
-    glEnd();
-    
-    // 绘制屋顶的灯具模型
-    glPushMatrix();
-    glTranslatef(lightPos[0], lightPos[1] - 0.5f, lightPos[2]); // 稍微下来一点
-    glScalef(0.1f, 0.1f, 0.1f); // 根据你的OBJ大小调整缩放
-    glColor3f(1.0f, 1.0f, 0.8f); // 暖光颜色
-    mdlLamp.draw();
-    glPopMatrix();
+    addRoomFace("back_wall", "assets/textures/wall.jpg", white,
+        glm::vec3(0.0f, height / 2, -roomSize), glm::vec3(0.0f, 0.0f, 0.0f),
+        glm::vec3(2 * roomSize, height, 1.0f), glm::vec2(2.0f, 1.0f), SHADOW_CASTER_STATIC);
+    addRoomFace("left_wall", "assets/textures/wall.jpg", white,
+        glm::vec3(-roomSize, height / 2, 0.0f), glm::vec3(0.0f, 90.0f, 0.0f),
+        glm::vec3(2 * roomSize, height, 1.0f), glm::vec2(2.0f, 1.0f), SHADOW_CASTER_STATIC);
+    addRoomFace("right_wall", "assets/textures/wall.jpg", white,
+        glm::vec3(roomSize, height / 2, 0.0f), glm::vec3(0.0f, -90.0f, 0.0f),
+        glm::vec3(2 * roomSize, height, 1.0f), glm::vec2(2.0f, 1.0f), SHADOW_CASTER_STATIC);
+
+    // 3. 天花板 (简单白色)，在灯的背后
+    addRoomFace("ceiling", "", glm::vec3(0.9f, 0.9f, 0.9f),
+        glm::vec3(0.0f, height, 0.0f), glm::vec3(90.0f, 0.0f, 0.0f),
+        glm::vec3(2 * roomSize, 2 * roomSize, 1.0f), glm::vec2(1.0f, 1.0f), SHADOW_CASTER_NONE);
+
+    // 屋顶的灯具模型，文件不存在时跳过（readObj 打不开文件会直接退出）
+    const std::string lampFile = "assets/lamp.obj";
+    if (std::ifstream(lampFile.c_str()).good()) {
+        TriMesh* lamp = newIndexedMesh();
+        lamp->readObj(lampFile);
+        lamp->setTranslation(lightPos - glm::vec3(0.0f, 0.5f, 0.0f)); // 稍微下来一点
+        lamp->setScale(glm::vec3(0.1f, 0.1f, 0.1f)); // 根据你的OBJ大小调整缩放
+        setMaterial(lamp, glm::vec3(1.0f, 1.0f, 0.8f), glm::vec3(1.0f, 1.0f, 0.8f), glm::vec3(0.0f), 1.0f);
+        painter->addMesh(lamp, "lamp", "", vshader, fshader);
+        meshLamp = (int)painter->getMeshes().size() - 1;
+        // 灯具包围着光源，投射阴影会挡住整个房间
+        painter->setShadowCaster(meshLamp, SHADOW_CASTER_NONE);
+        roomMeshes.push_back(meshLamp);
+    } else {
+        std::cerr << "无法打开文件: " << lampFile << std::endl;
+    }
+}
+
+// 建立机械臂用到的基本网格，只在初始化时生成一次
+void initRobot() {
+    glm::vec3 gray(0.7f, 0.7f, 0.7f); // 机械臂灰色
+
+    // 底座：半高 0.75 的圆柱，中心在原点、沿 z 轴
+    TriMesh* base = newIndexedMesh();
+    base->generateCylinder(20, 1.0f, 0.75f, gray);
+    meshBase = addPart(base, "base", glm::vec3(0.3f), glm::vec3(0.8f));
+
+    // 底座顶面
+    TriMesh* baseTop = newIndexedMesh();
+    baseTop->generateDisk(20, 1.0f, gray);
+    meshBaseTop = addPart(baseTop, "base_top", glm::vec3(0.3f), glm::vec3(0.8f));
+
+    // 关节球：单位半径，按关节大小缩放
+    TriMesh* joint = newIndexedMesh();
+    joint->generateSphere(16, 1.0f, gray);
+    meshJoint = addPart(joint, "joint", glm::vec3(0.3f), glm::vec3(0.8f));
+
+    // 大臂、小臂、爪子共用一个单位立方体
+    TriMesh* arm = newIndexedMesh();
+    arm->generateCube(gray);
+    meshArm = addPart(arm, "arm", glm::vec3(0.3f), glm::vec3(0.8f));
+
+    // 目标物体：红色立方体
+    TriMesh* target = newIndexedMesh();
+    target->generateCube(glm::vec3(1.0f, 0.0f, 0.0f));
+    meshTarget = addPart(target, "target", glm::vec3(0.3f, 0.0f, 0.0f), glm::vec3(0.8f, 0.1f, 0.1f));
 }
 
-// 阴影矩阵
-void shadowMatrix(GLfloat shadowMat[4][4], GLfloat groundplane[4], GLfloat lightpos[4]) {
-    GLfloat dot;
-    dot = groundplane[0] * lightpos[0] + groundplane[1] * lightpos[1] +
-          groundplane[2] * lightpos[2] + groundplane[3] * lightpos[3];
-    shadowMat[0][0] = dot - lightpos[0] * groundplane[0];
-    shadowMat[1][0] = 0.f - lightpos[0] * groundplane[1];
-    shadowMat[2][0] = 0.f - lightpos[0] * groundplane[2];
-    shadowMat[3][0] = 0.f - lightpos[0] * groundplane[3];
-    shadowMat[0][1] = 0.f - lightpos[1] * groundplane[0];
-    shadowMat[1][1] = dot - lightpos[1] * groundplane[1];
-    shadowMat[2][1] = 0.f - lightpos[1] * groundplane[2];
-    shadowMat[3][1] = 0.f - lightpos[1] * groundplane[3];
-    shadowMat[0][2] = 0.f - lightpos[2] * groundplane[0];
-    shadowMat[1][2] = 0.f - lightpos[2] * groundplane[1];
-    shadowMat[2][2] = dot - lightpos[2] * groundplane[2];
-    shadowMat[3][2] = 0.f - lightpos[2] * groundplane[3];
-    shadowMat[0][3] = 0.f - lightpos[3] * groundplane[0];
-    shadowMat[1][3] = 0.f - lightpos[3] * groundplane[1];
-    shadowMat[2][3] = 0.f - lightpos[3] * groundplane[2];
-    shadowMat[3][3] = dot - lightpos[3] * groundplane[3];
+// 阴影 pass 画进阴影贴图，否则加入本帧的绘制队列
+void drawPart(int index, const glm::mat4& model, bool isShadow) {
+    if (isShadow)
+        painter->drawShadowCaster(index, model);
+    else
+        painter->queueMesh(index, model);
 }
 
 // ================= 机械臂绘制与逻辑 =================
 
-// 计算末端位置 (正运动学) - 简易版
-// 我们需要知道爪子中心现在在哪里，以便做碰撞检测
-void updateClawPosition() {
-    // 这是一个近似计算，因为完全的矩阵变换比较复杂
-    // 这里我们用三角函数手动追踪坐标
-    // 1. 底座旋转影响 x, z
-    // 2. 臂长假设：底座高 1.5, 大臂长 4.0, 小臂长 3.0
-    
-    float radBase = baseRot * PI / 180.0f;
-    float radArm1 = arm1Rot * PI / 180.0f;
-    // 注意：小臂的旋转是基于大臂的坐标系的，所以角度是累加的 (这里简化处理)
-    // 在OpenGL变换中，我们是先转Arm1，再移动，再转Arm2
-    float radArm2 = (arm1Rot + arm2Rot) * PI / 180.0f; // 绝对角度
-
-    float L1 = 4.0f; // 大臂长度
-    float L2 = 3.0f; // 小臂长度
-
-    // 在 Y-R 平面 (垂直切面) 的投影
-    // 起点 (0, 1.5)
-    float r1 = L1 * sin(radArm1); // 大臂水平投影
-    float y1 = L1 * cos(radArm1); // 大臂垂直投影
-    
-    float r2 = L2 * sin(radArm2);
-    float y2 = L2 * cos(radArm2);
-
-    float R_total = r1 + r2; // 总水平距离
-    float Y_total = 1.5f + y1 + y2; // 总高度
-
-    // 转换回 3D 世界坐标
-    clawWorldX = R_total * sin(radBase); // 注意：这里sin/cos取决于你的初始朝向
-    clawWorldZ = R_total * cos(radBase);
-    clawWorldY = Y_total;
-
-    // 修正：上面的数学模型可能和OpenGL的 draw 顺序有出入
-    // 最准确的方法是利用 glGetFloatv(GL_MODELVIEW_MATRIX)
-    // 但为了作业简单，我们可以直接在 Draw 的时候保存坐标
+int addArmPart(const char* name, int mesh, int parent, glm::vec3 translation, glm::vec3 rotation, glm::vec3 scale) {
+    int node = armScene.addNode(parent, translation, rotation, scale);
+    ArmPart part = { mesh, node, name };
+    armParts.push_back(part);
+    return node;
 }
 
-void drawClaw() {
-    // 爪子底座
-    glutSolidCube(0.8);
-
-    // 左指
-    glPushMatrix();
-    glTranslatef(0.3f, -0.4f, 0.0f); // 移到边缘
-    glRotatef(-clawAngle, 0, 0, 1); // 张开
-    glTranslatef(0.0f, -0.4f, 0.0f); // 指长中心
-    glScalef(0.1f, 0.8f, 0.4f);
-    glutSolidCube(1.0);
-    glPopMatrix();
-
-    // 右指
-    glPushMatrix();
-    glTranslatef(-0.3f, -0.4f, 0.0f);
-    glRotatef(clawAngle, 0, 0, 1);
-    glTranslatef(0.0f, -0.4f, 0.0f);
-    glScalef(0.1f, 0.8f, 0.4f);
-    glutSolidCube(1.0);
-    glPopMatrix();
+// 沿 底座 → 肩部 → 肘部 → 手腕 的关节链建立场景图，只在初始化时调用一次
+// 原来模视矩阵栈里 push 出来的分支，变成挂在同一个关节下的部件节点
+void buildArmScene() {
+    const int root = SceneGraph::NO_PARENT;
+    glm::vec3 none(0.0f);
+
+    // 1. 底座：圆柱转到 y 轴向上，底面贴地
+    addArmPart("底座", meshBase, root, glm::vec3(0.0f, 0.75f, 0.0f), glm::vec3(-90.0f, 0.0f, 0.0f), glm::vec3(1.0f));
+    addArmPart("底座顶面", meshBaseTop, root, glm::vec3(0.0f, 1.5f, 0.0f), glm::vec3(-90.0f, 0.0f, 0.0f), glm::vec3(1.0f));
+
+    // --- 关节1：底座旋转 ---
+    nodeBaseJoint = armScene.addNode(root, glm::vec3(0.0f, 1.5f, 0.0f));
+
+    // --- 关节2：肩部，绕Z轴 ---
+    addArmPart("肩关节 (W/S)", meshJoint, nodeBaseJoint, none, none, glm::vec3(0.8f)); // 关节球
+    nodeShoulder = armScene.addNode(nodeBaseJoint);
+    addArmPart("大臂 (W/S)", meshArm, nodeShoulder, glm::vec3(0.0f, 2.0f, 0.0f), none, glm::vec3(0.6f, 4.0f, 0.6f)); // 大臂，往上长
+
+    // --- 关节3：肘部，小臂弯曲 ---
+    nodeElbow = armScene.addNode(nodeShoulder, glm::vec3(0.0f, 4.0f, 0.0f));
+    addArmPart("肘关节 (Q/E)", meshJoint, nodeElbow, none, none, glm::vec3(0.7f));
+    addArmPart("小臂 (Q/E)", meshArm, nodeElbow, glm::vec3(0.0f, 1.5f, 0.0f), none, glm::vec3(0.5f, 3.0f, 0.5f)); // 小臂
+
+    // --- 关节4：手腕与爪子，爪子自旋 ---
+    nodeWrist = armScene.addNode(nodeElbow, glm::vec3(0.0f, 3.0f, 0.0f));
+    addArmPart("爪子 (R)", meshArm, nodeWrist, none, none, glm::vec3(0.8f)); // 爪子底座
+
+    // 左右手指：先移到边缘再张开，部件中心在指长的一半处
+    nodeLeftFinger = armScene.addNode(nodeWrist, glm::vec3(0.3f, -0.4f, 0.0f));
+    addArmPart("左指 (1/2)", meshArm, nodeLeftFinger, glm::vec3(0.0f, -0.4f, 0.0f), none, glm::vec3(0.1f, 0.8f, 0.4f));
+    nodeRightFinger = armScene.addNode(nodeWrist, glm::vec3(-0.3f, -0.4f, 0.0f));
+    addArmPart("右指 (1/2)", meshArm, nodeRightFinger, glm::vec3(0.0f, -0.4f, 0.0f), none, glm::vec3(0.1f, 0.8f, 0.4f));
+
+    // 抓住的物体挂在爪子下面
+    nodeCaught = armScene.addNode(nodeWrist, glm::vec3(0.0f, -1.0f, 0.0f));
+}
+
+// 把当前关节角度写入场景图并更新世界矩阵
+// 角度没有变化的关节不会被标记，没有任何变化时 update 直接返回
+void updateArmScene() {
+    armScene.setRotation(nodeBaseJoint, glm::vec3(0.0f, baseRot, 0.0f));
+    armScene.setRotation(nodeShoulder, glm::vec3(0.0f, 0.0f, arm1Rot));
+    armScene.setRotation(nodeElbow, glm::vec3(0.0f, 0.0f, arm2Rot));
+    armScene.setRotation(nodeWrist, glm::vec3(0.0f, clawRot, 0.0f));
+    armScene.setRotation(nodeLeftFinger, glm::vec3(0.0f, 0.0f, -clawAngle));
+    armScene.setRotation(nodeRightFinger, glm::vec3(0.0f, 0.0f, clawAngle));
+    armScene.update();
+}
+
+// 爪子的世界坐标，即手腕世界矩阵的第4列，用于物理检测
+glm::vec3 getClawPosition() {
+    updateArmScene();
+    return glm::vec3(armScene.getWorldMatrix(nodeWrist)[3]);
+}
+
+// 第 a 台机械臂底座的平移
+glm::mat4 armBaseMatrix(int a) {
+    float half = (armGrid - 1) * 0.5f;
+    float x = (a % armGrid - half) * ARM_SPACING;
+    float z = (a / armGrid - half) * ARM_SPACING;
+    return glm::translate(glm::mat4(1.0f), glm::vec3(x, 0.0f, z));
+}
+
+// 收集本帧所有机械臂部件的实例矩阵，阴影 pass 和正常绘制共用
+// 各台机械臂共用同一套世界矩阵，只差底座的平移
+void queueArmInstances() {
+    const glm::mat4* world = armScene.getWorldMatrices();
+    for (int a = 0; a < armGrid * armGrid; a++) {
+        glm::mat4 base = armBaseMatrix(a);
+        for (size_t i = 0; i < armParts.size(); i++) {
+            painter->queueInstance(armParts[i].mesh, base * world[armParts[i].node]);
+        }
+    }
 }
 
 void drawRobot(bool isShadow) {
-    if(!isShadow) glColor3f(0.7f, 0.7f, 0.7f); // 机械臂灰色
-
-    // 1. 底座
-    glPushMatrix();
-    glTranslatef(0.0f, 0.0f, 0.0f);
-    glRotatef(-90, 1, 0, 0);
-    glutSolidCylinder(1.0, 1.5, 20, 5);
-    glPopMatrix();
-
-    // 变换链开始
-    glPushMatrix();
-    
-    // --- 关节1：底座旋转 ---
-    glTranslatef(0.0f, 1.5f, 0.0f); 
-    glRotatef(baseRot, 0, 1, 0);
-
-        // --- 关节2：肩部 ---
-        glutSolidSphere(0.8, 16, 16); // 关节球
-        glRotatef(arm1Rot, 0, 0, 1); // 绕Z轴
-
-        // 大臂
-        glPushMatrix();
-        glTranslatef(0.0f, 2.0f, 0.0f); // 往上长
-        glScalef(0.6f, 4.0f, 0.6f);
-        glutSolidCube(1.0);
-        glPopMatrix();
-
-        // --- 关节3：肘部 ---
-        glTranslatef(0.0f, 4.0f, 0.0f);
-        glutSolidSphere(0.7, 16, 16);
-        glRotatef(arm2Rot, 0, 0, 1); // 小臂弯曲
-
-        // 小臂
-        glPushMatrix();
-        glTranslatef(0.0f, 1.5f, 0.0f);
-        glScalef(0.5f, 3.0f, 0.5f);
-        glutSolidCube(1.0);
-        glPopMatrix();
-
-        // --- 关节4：手腕与爪子 ---
-        glTranslatef(0.0f, 3.0f, 0.0f);
-        glRotatef(clawRot, 0, 1, 0); // 爪子自旋
-
-        drawClaw();
-
-        // [核心逻辑]：在这里获取爪子的世界坐标用于物理检测
-        if (!isShadow) {
-            float modelview[16];
-            glGetFloatv(GL_MODELVIEW_MATRIX, modelview);
-            // 矩阵第4列就是当前的平移位置 (x, y, z)
-            clawWorldX = modelview[12];
-            clawWorldY = modelview[13];
-            clawWorldZ = modelview[14];
-            
-            // 如果抓住了物体，在这里绘制物体（跟随爪子移动）
-            if (targetObj.isCaught) {
-                glPushMatrix();
-                glTranslatef(0.0f, -1.0f, 0.0f); // 挂在爪子下面
-                glColor3f(1.0f, 0.0f, 0.0f);
-                glutSolidCube(1.0); // 或者 drawObj()
-                glPopMatrix();
+    const glm::mat4* world = armScene.getWorldMatrices();
+    if (useInstancing) {
+        // 实例已经由 queueArmInstances 收集，每种网格一次绘制
+        if (isShadow)
+            painter->drawInstanceShadows();
+        else
+            painter->flushInstances();
+    } else {
+        for (int a = 0; a < armGrid * armGrid; a++) {
+            glm::mat4 base = armBaseMatrix(a);
+            for (size_t i = 0; i < armParts.size(); i++) {
+                drawPart(armParts[i].mesh, base * world[armParts[i].node], isShadow);
             }
         }
-        else if (targetObj.isCaught) {
-            // 阴影Pass也要画
-            glPushMatrix();
-            glTranslatef(0.0f, -1.0f, 0.0f);
-            glutSolidCube(1.0); 
-            glPopMatrix();
-        }
+    }
+
+    // 如果抓住了物体，在这里绘制物体（跟随爪子移动），阴影 pass 也要画
+    if (targetObj.isCaught) {
+        drawPart(meshTarget, world[nodeCaught], isShadow);
+    }
+}
 
-    glPopMatrix();
+glm::mat4 targetMatrix() {
+    return glm::translate(glm::mat4(1.0f), glm::vec3(targetObj.x, targetObj.y, targetObj.z));
 }
 
 // 绘制目标物体
-void drawObject() {
+void drawObject(bool isShadow) {
     if (targetObj.isCaught) return; // 如果被抓住了，在drawRobot里画
 
-    glPushMatrix();
-    glTranslatef(targetObj.x, targetObj.y, targetObj.z);
-    
-    // 红色物体
-    GLfloat mat_ambient[] = { 0.3f, 0.0f, 0.0f, 1.0f };
-    GLfloat mat_diffuse[] = { 0.8f, 0.1f, 0.1f, 1.0f };
-    glMaterialfv(GL_FRONT, GL_AMBIENT, mat_ambient);
-    glMaterialfv(GL_FRONT, GL_DIFFUSE, mat_diffuse);
-    
-    glColor3f(1.0f, 0.0f, 0.0f); 
-    glutSolidCube(1.0); // 后续可替换为 mdlCube.draw()
-    glPopMatrix();
+    drawPart(meshTarget, targetMatrix(), isShadow);
 }
 
 // ================= 主循环 =================
 
 void display() {
+    // 世界矩阵每帧最多更新一次，阴影、绘制和碰撞检测共用，不需要从 GL 读回矩阵
+    updateArmScene();
+    if (useInstancing) queueArmInstances();
+    // 统计从阴影 pass 开始算，按 F 打印的是完整一帧的数据
+    painter->resetFrameStats();
+
+    // 1. 阴影贴图：墙壁在静态缓存中，只有机械臂和目标物体每帧重画
+    painter->beginShadowPass();
+    drawObject(true);
+    drawRobot(true);
+    painter->endShadowPass();
+
+    // 2. 绘制房间、物体和机器人，全部加入绘制队列后按状态排序提交
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    glLoadIdentity();
-    
-    // 相机
-    float radX = camAngleX * PI / 180.0f;
-    float radY = camAngleY * PI / 180.0f;
-    gluLookAt(camDist * cos(radY) * sin(radX), camDist * sin(radY), camDist * cos(radY) * cos(radX),
-              0, 3, 0, 0, 1, 0);
-
-    // 设置光源
-    glLightfv(GL_LIGHT0, GL_POSITION, lightPos);
-
-    // 1. 绘制不透明的房间场景
-    drawRoom();
-
-    // 2. 绘制阴影 (使用平面投影)
-    glDisable(GL_LIGHTING);
-    glDisable(GL_TEXTURE_2D);
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    
-    glPushMatrix();
-    GLfloat shadowMat[4][4];
-    GLfloat ground[4] = {0, 1, 0, 0.01}; // 地面平面
-    shadowMatrix(shadowMat, ground, lightPos);
-    glMultMatrixf((GLfloat*)shadowMat);
-    
-    glColor4f(0.1f, 0.1f, 0.1f, 0.5f); // 黑色半透明
-    drawRobot(true); // 绘制机器人阴影
-    if(!targetObj.isCaught) {
-        glPushMatrix();
-        glTranslatef(targetObj.x, 0.5f, targetObj.z);
-        glutSolidCube(1.0);
-        glPopMatrix();
-    }
-    glPopMatrix();
-    
-    glDisable(GL_BLEND);
-    glEnable(GL_LIGHTING);
+    painter->beginFrame(light, camera);
 
-    // 3. 绘制物体和机器人
-    drawObject();
+    const std::vector<TriMesh*>& meshes = painter->getMeshes();
+    for (size_t i = 0; i < roomMeshes.size(); i++) {
+        painter->queueMesh(roomMeshes[i], meshes[roomMeshes[i]]->getModelMatrix());
+    }
+    drawObject(false);
     drawRobot(false);
 
-    glutSwapBuffers();
+    painter->flushQueue();
 }
 
 // 物理碰撞检测
 void checkCollision() {
     if (targetObj.isCaught) return; // 已经抓着了就不检侧
 
-    // 计算距离
-    float dx = clawWorldX - targetObj.x;
-    float dy = (clawWorldY - 1.0f) - targetObj.y; // 爪子中心比末端高，修正一下
-    float dz = clawWorldZ - targetObj.z;
+    // 计算距离，用当前关节角度下的爪子位置，而不是上一帧绘制时记录的位置
+    glm::vec3 claw = getClawPosition();
+    float dx = claw.x - targetObj.x;
+    float dy = (claw.y - 1.0f) - targetObj.y; // 爪子中心比末端高，修正一下
+    float dz = claw.z - targetObj.z;
     float dist = sqrt(dx*dx + dy*dy + dz*dz);
 
     // 阈值：假设爪子张开且距离小于 1.5
@@ -508,94 +369,239 @@ void checkCollision() {
     }
 }
 
-void keyboard(unsigned char key, int x, int y) {
+// 相机绕 (0, 3, 0) 旋转，角度和距离沿用原来的鼠标控制
+void updateCamera() {
+    camera->rotateAngle = camAngleX;
+    camera->upAngle = camAngleY;
+    camera->radius = camDist;
+    camera->at = glm::vec4(0.0f, 3.0f, 0.0f, 1.0f);
+    camera->markDirty();
+}
+
+void printHelp() {
+    std::cout << "操作说明:\n WASD: 控制手臂\n Q/E: 控制小臂\n R: 旋转爪子\n 1: 张开爪子(放下)\n 2: 闭合爪子(抓取)\n G: 切换机械臂数量\n I: 切换实例化绘制\n C: 切换视锥剔除\n F: 打印上一帧的绘制统计\n 鼠标拖拽: 旋转视角\n 鼠标单击: 选中物体\n H: 帮助\n ESC: 退出" << std::endl;
+}
+
+void printFrameStats() {
+    const RenderStats& stats = painter->getFrameStats();
+    std::cout << "绘制次数: " << stats.drawCalls << "，绘制物体: " << stats.meshesDrawn
+        << "，剔除物体: " << stats.meshesCulled << "，状态切换: " << stats.stateChanges() << std::endl;
+}
+
+void printArmMode() {
+    std::cout << "机械臂数量: " << armGrid * armGrid << "，实例化绘制: " << (useInstancing ? "开" : "关") << std::endl;
+}
+
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mode) {
+    // 按住时连续触发，与 GLUT 的按键重复一致
+    if (action != GLFW_PRESS && action != GLFW_REPEAT) return;
+
     switch (key) {
-    case 'w': if(arm1Rot < 90) arm1Rot += 2.0f; break;
-    case 's': if(arm1Rot > -90) arm1Rot -= 2.0f; break;
-    case 'q': if(arm2Rot < 90) arm2Rot += 2.0f; break;
-    case 'e': if(arm2Rot > -90) arm2Rot -= 2.0f; break;
-    case 'a': baseRot += 2.0f; break;
-    case 'd': baseRot -= 2.0f; break;
-    case 'r': clawRot += 5.0f; break; // 爪子旋转
-    
+    case GLFW_KEY_W: if(arm1Rot < 90) arm1Rot += 2.0f; break;
+    case GLFW_KEY_S: if(arm1Rot > -90) arm1Rot -= 2.0f; break;
+    case GLFW_KEY_Q: if(arm2Rot < 90) arm2Rot += 2.0f; break;
+    case GLFW_KEY_E: if(arm2Rot > -90) arm2Rot -= 2.0f; break;
+    case GLFW_KEY_A: baseRot += 2.0f; break;
+    case GLFW_KEY_D: baseRot -= 2.0f; break;
+    case GLFW_KEY_R: clawRot += 5.0f; break; // 爪子旋转
+
     // 爪子开合 (数字键)
-    case '1': clawAngle = 30.0f; // 张开 (放下)
+    case GLFW_KEY_1: clawAngle = 30.0f; // 张开 (放下)
               if(targetObj.isCaught) {
                   targetObj.isCaught = false;
                   // 放下时更新物体坐标为当前爪子下方
-                  targetObj.x = clawWorldX;
-                  targetObj.z = clawWorldZ;
+                  glm::vec3 claw = getClawPosition();
+                  targetObj.x = claw.x;
+                  targetObj.z = claw.z;
                   targetObj.y = 0.5f; // 落地
               }
-              break; 
-    case '2': clawAngle = 0.0f; // 闭合 (尝试抓取)
+              break;
+    case GLFW_KEY_2: clawAngle = 0.0f; // 闭合 (尝试抓取)
               checkCollision();
               break;
 
-    case 27: exit(0);
+    case GLFW_KEY_G: armGrid = armGrid == 1 ? 5 : (armGrid == 5 ? 11 : 1); printArmMode(); break;
+    case GLFW_KEY_I: useInstancing = !useInstancing; printArmMode(); break;
+    case GLFW_KEY_C:
+        painter->setFrustumCulling(!painter->getFrustumCulling());
+        std::cout << "视锥剔除: " << (painter->getFrustumCulling() ? "开" : "关") << std::endl;
+        break;
+    case GLFW_KEY_F: printFrameStats(); break;
+
+    case GLFW_KEY_H: printHelp(); break;
+    case GLFW_KEY_ESCAPE: glfwSetWindowShouldClose(window, GL_TRUE); break;
     }
-    glutPostRedisplay();
 }
 
-void mouse(int button, int state, int x, int y) {
-    if (button == GLUT_LEFT_BUTTON) {
-        mouseLeftDown = (state == GLUT_DOWN);
-        mouseX = x; mouseY = y;
+// 点击拾取：从鼠标位置发出射线，与房间、目标物体和所有机械臂部件求交，打印最近的物体
+// 每个网格的 BVH 在第一次拾取时建立，部件用绘制时相同的世界矩阵
+void pickAt(GLFWwindow* window, double x, double y) {
+    int width, height;
+    glfwGetWindowSize(window, &width, &height);
+    if (width <= 0 || height <= 0) return;
+
+    Ray ray;
+    camera->getPickRay(x, y, width, height, ray.origin, ray.direction);
+    RayHit hit;
+    std::string picked;
+
+    const std::vector<TriMesh*>& meshes = painter->getMeshes();
+    for (size_t i = 0; i < roomMeshes.size(); i++) {
+        if (painter->intersectMesh(roomMeshes[i], meshes[roomMeshes[i]]->getModelMatrix(), ray, hit))
+            picked = painter->getMeshNames()[roomMeshes[i]];
     }
+
+    updateArmScene();
+    const glm::mat4* world = armScene.getWorldMatrices();
+    glm::mat4 target = targetObj.isCaught ? world[nodeCaught] : targetMatrix();
+    if (painter->intersectMesh(meshTarget, target, ray, hit))
+        picked = "目标物体";
+
+    for (int a = 0; a < armGrid * armGrid; a++) {
+        glm::mat4 base = armBaseMatrix(a);
+        for (size_t i = 0; i < armParts.size(); i++) {
+            if (painter->intersectMesh(armParts[i].mesh, base * world[armParts[i].node], ray, hit)) {
+                picked = armParts[i].name;
+                if (armGrid > 1) picked += " #" + std::to_string(a);
+            }
+        }
+    }
+
+    if (hit.hit())
+        std::cout << "选中: " << picked << "，距离 " << hit.t << std::endl;
+    else
+        std::cout << "没有选中物体" << std::endl;
 }
 
-void motion(int x, int y) {
+void mouse_button_callback(GLFWwindow* window, int button, int action, int mods) {
+    if (button == GLFW_MOUSE_BUTTON_LEFT) {
+        mouseLeftDown = (action == GLFW_PRESS);
+        glfwGetCursorPos(window, &mouseX, &mouseY);
+        if (action == GLFW_PRESS) {
+            pressX = mouseX;
+            pressY = mouseY;
+        } else if (std::fabs(mouseX - pressX) + std::fabs(mouseY - pressY) < 3.0) {
+            pickAt(window, mouseX, mouseY);
+        }
+    }
+}
+
+void cursor_position_callback(GLFWwindow* window, double x, double y) {
     if (mouseLeftDown) {
-        camAngleX -= (x - mouseX) * 0.5f;
-        camAngleY += (y - mouseY) * 0.5f;
+        camAngleX -= (float)(x - mouseX) * 0.5f;
+        camAngleY += (float)(y - mouseY) * 0.5f;
         if(camAngleY > 89) camAngleY = 89;
         if(camAngleY < 5) camAngleY = 5;
         mouseX = x; mouseY = y;
-        glutPostRedisplay();
+        updateCamera();
     }
 }
 
+void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
+    if (width <= 0 || height <= 0) return; // 最小化
+    glViewport(0, 0, width, height);
+    camera->aspect = (float)width / height;
+    camera->markDirty();
+}
+
 void init() {
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_LIGHTING);
-    glEnable(GL_LIGHT0);
-    glEnable(GL_NORMALIZE);
-
-    // 加载纹理 (请确保文件存在 assets/textures 文件夹下)
-    texFloor = loadTexture("assets/textures/floor.jpg");
-    texWall = loadTexture("assets/textures/wall.jpg");
-    
-    // 加载OBJ
-    mdlLamp.load("assets/lamp.obj");
-    mdlCube.load("assets/toy.obj"); 
-
-    // 设置全局环境光
-    GLfloat ambient[] = { 0.3f, 0.3f, 0.3f, 1.0f };
-    glLightModelfv(GL_LIGHT_MODEL_AMBIENT, ambient);
+    // 设置光源：点光源，没有衰减，环境光由 roomAmbient 提供
+    light->setTranslation(lightPos);
+    light->setAmbient(glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+    light->setDiffuse(glm::vec4(1.0f, 1.0f, 1.0f, 1.0f));
+    light->setSpecular(glm::vec4(1.0f, 1.0f, 1.0f, 1.0f));
+    light->setAttenuation(1.0f, 0.0f, 0.0f);
+
+    SceneLighting lighting;
+    lighting.roomAmbient = 0.3f; // 全局环境光
+    painter->setSceneLighting(lighting);
+
+    // 阴影贴图：从灯的位置向下看，视锥覆盖整个地面
+    shadowMap->setLightSpaceMatrix(ShadowMap::spotLightMatrix(lightPos, glm::vec3(0.0f, -1.0f, 0.0f), 55.0f, 0.5f, 25.0f));
+    painter->setShadowMap(shadowMap);
+
+    initRoom();
+    initRobot();
+    buildArmScene();
+
+    // 相机
+    camera->fovy = 45.0f;
+    camera->zNear = 0.1f;
+    camera->zFar = 100.0f;
+    camera->aspect = (float)WIDTH / HEIGHT;
+    updateCamera();
+
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+}
+
+void cleanData() {
+    delete camera;
+    camera = NULL;
+
+    delete light;
+    light = NULL;
+
+    // painter 负责删除加入其中的 TriMesh
+    painter->cleanMeshes();
+
+    delete painter;
+    painter = NULL;
+
+    delete shadowMap;
+    shadowMap = NULL;
 }
 
 int main(int argc, char** argv) {
-    glutInit(&argc, argv);
-    glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGB | GLUT_DEPTH);
-    glutInitWindowSize(1024, 768);
-    glutCreateWindow("Final Project: Robot Arm in Room");
+    // -v：打印模型与着色器的加载统计
+    for (int i = 1; i < argc; i++)
+        if (strcmp(argv[i], "-v") == 0)
+            SetVerbose(true);
+
+    // 初始化GLFW库，必须是应用程序调用的第一个GLFW函数
+    glfwInit();
+
+    // 配置GLFW：3.3 核心模式，不再使用固定管线
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+#ifdef __APPLE__
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+
+    GLFWwindow* window = glfwCreateWindow(WIDTH, HEIGHT, "Final Project: Robot Arm in Room", NULL, NULL);
+    if (window == NULL) {
+        std::cout << "Failed to create GLFW window" << std::endl;
+        glfwTerminate();
+        return -1;
+    }
+    glfwMakeContextCurrent(window);
+    glfwSetKeyCallback(window, key_callback);
+    glfwSetMouseButtonCallback(window, mouse_button_callback);
+    glfwSetCursorPosCallback(window, cursor_position_callback);
+    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+        std::cout << "Failed to initialize GLAD" << std::endl;
+        return -1;
+    }
 
     init();
+    printHelp();
 
-    glutDisplayFunc(display);
-    glutReshapeFunc([](int w, int h) {
-        glViewport(0, 0, w, h);
-        glMatrixMode(GL_PROJECTION);
-        glLoadIdentity();
-        gluPerspective(45, (float)w/h, 0.1, 100);
-        glMatrixMode(GL_MODELVIEW);
-    });
-    glutKeyboardFunc(keyboard);
-    glutMouseFunc(mouse);
-    glutMotionFunc(motion);
-
-    std::cout << "操作说明:\n WASD: 控制手臂\n Q/E: 控制小臂\n 1: 张开爪子(放下)\n 2: 闭合爪子(抓取)\n 鼠标拖拽: 旋转视角" << std::endl;
-
-    glutMainLoop();
+    // 高分屏上帧缓冲比窗口大，按实际大小设置视口
+    int framebufferWidth, framebufferHeight;
+    glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+    framebuffer_size_callback(window, framebufferWidth, framebufferHeight);
+
+    glEnable(GL_DEPTH_TEST);
+    while (!glfwWindowShouldClose(window)) {
+        display();
+        glfwSwapBuffers(window);
+        glfwPollEvents();
+    }
+    cleanData();
+
+    glfwTerminate();
     return 0;
-}
\ No newline at end of file
+}
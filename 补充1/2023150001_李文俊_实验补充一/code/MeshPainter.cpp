@@ -6,9 +6,9 @@
 MeshPainter::MeshPainter(){};
 MeshPainter::~MeshPainter(){};
 
-std::vector<std::string> MeshPainter::getMeshNames(){ return mesh_names;};
-std::vector<TriMesh *> MeshPainter::getMeshes(){ return meshes;};
-std::vector<openGLObject> MeshPainter::getOpenGLObj(){ return opengl_objects;};
+const std::vector<std::string>& MeshPainter::getMeshNames() const { return mesh_names;};
+const std::vector<TriMesh *>& MeshPainter::getMeshes() const { return meshes;};
+const std::vector<openGLObject>& MeshPainter::getOpenGLObj() const { return opengl_objects;};
 
 void MeshPainter::bindObjectAndData(TriMesh *mesh, openGLObject &object, const std::string &texture_image, const std::string &vshader, const std::string &fshader){
     // 初始化各种对象
@@ -49,16 +49,16 @@ TriMesh::TriMesh()
 
 TriMesh::~TriMesh(){}
 
-std::vector<glm::vec3> TriMesh::getVertexPositions() { return vertex_positions; }
-std::vector<glm::vec3> TriMesh::getVertexColors(){ return vertex_colors; }
-std::vector<glm::vec3> TriMesh::getVertexNormals(){ return vertex_normals; }
-std::vector<glm::vec2> TriMesh::getVertexTextures(){ return vertex_textures; }
-
-std::vector<vec3i> TriMesh::getFaces(){ return faces; }
-std::vector<glm::vec3> TriMesh::getPoints(){ return points;}
-std::vector<glm::vec3> TriMesh::getColors(){ return colors; }
-std::vector<glm::vec3> TriMesh::getNormals(){ return normals;}
-std::vector<glm::vec2> TriMesh::getTextures(){ return textures; }
+const std::vector<glm::vec3>& TriMesh::getVertexPositions() const { return vertex_positions; }
+const std::vector<glm::vec3>& TriMesh::getVertexColors() const { return vertex_colors; }
+const std::vector<glm::vec3>& TriMesh::getVertexNormals() const { return vertex_normals; }
+const std::vector<glm::vec2>& TriMesh::getVertexTextures() const { return vertex_textures; }
+
+const std::vector<vec3i>& TriMesh::getFaces() const { return faces; }
+const std::vector<glm::vec3>& TriMesh::getPoints() const { return points;}
+const std::vector<glm::vec3>& TriMesh::getColors() const { return colors; }
+const std::vector<glm::vec3>& TriMesh::getNormals() const { return normals;}
+const std::vector<glm::vec2>& TriMesh::getTextures() const { return textures; }
 
 
 void TriMesh::computeTriangleNormals()
@@ -25,16 +25,16 @@ public:
 	glm::vec3 getConnectPosition();
 	void setConnectPosition(glm::vec3 _connect_position);
 
-	std::vector<glm::vec3> getVertexPositions();
-	std::vector<glm::vec3> getVertexColors();
-	std::vector<glm::vec3> getVertexNormals();
-	std::vector<glm::vec2> getVertexTextures();
-
-	std::vector<vec3i> getFaces();
-	std::vector<glm::vec3> getPoints();
-	std::vector<glm::vec3> getColors();
-	std::vector<glm::vec3> getNormals();
-	std::vector<glm::vec2> getTextures();
+	const std::vector<glm::vec3>& getVertexPositions() const;
+	const std::vector<glm::vec3>& getVertexColors() const;
+	const std::vector<glm::vec3>& getVertexNormals() const;
+	const std::vector<glm::vec2>& getVertexTextures() const;
+
+	const std::vector<vec3i>& getFaces() const;
+	const std::vector<glm::vec3>& getPoints() const;
+	const std::vector<glm::vec3>& getColors() const;
+	const std::vector<glm::vec3>& getNormals() const;
+	const std::vector<glm::vec2>& getTextures() const;
 
 	void computeTriangleNormals();
 	void computeVertexNormals();
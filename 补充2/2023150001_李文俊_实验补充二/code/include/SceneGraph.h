@@ -0,0 +1,61 @@
+#ifndef _SCENE_GRAPH_H_
+#define _SCENE_GRAPH_H_
+
+#include "Angel.h"
+
+#include <vector>
+
+// 层级建模用的场景图
+// 每个节点保存相对父节点的平移、旋转（欧拉角，单位为度）、缩放，以及缓存的世界矩阵。
+// 节点按添加顺序存放在连续数组中，父节点总在子节点之前，update 时顺序扫描一遍即可，
+// 不需要递归或矩阵栈。修改某个节点的变换只会标记它自己，update 时只重算它和它的子树
+class SceneGraph
+{
+public:
+	static const int NO_PARENT = -1;
+
+	SceneGraph();
+
+	// 添加节点，parent 必须是已经存在的节点或 NO_PARENT，返回节点编号
+	// 本地矩阵为 平移 * 绕 z * 绕 y * 绕 x * 缩放，与 TriMesh::getModelMatrix 的顺序一致
+	int addNode(int parent, const glm::vec3& translation = glm::vec3(0.0f),
+		const glm::vec3& rotation = glm::vec3(0.0f), const glm::vec3& scale = glm::vec3(1.0f));
+
+	// 修改本地变换，值没有变化时不标记
+	void setTranslation(int node, const glm::vec3& translation);
+	void setRotation(int node, const glm::vec3& rotation);
+	void setScale(int node, const glm::vec3& scale);
+
+	const glm::vec3& getTranslation(int node) const { return translations[node]; }
+	const glm::vec3& getRotation(int node) const { return rotations[node]; }
+	const glm::vec3& getScale(int node) const { return scales[node]; }
+	int getParent(int node) const { return parents[node]; }
+	int size() const { return (int)parents.size(); }
+
+	// 重新计算被修改的节点及其子树的世界矩阵，返回重算的节点数
+	int update();
+	bool isDirty() const { return first_dirty < size(); }
+
+	// 世界矩阵在 update 之后有效，所有节点的矩阵连续存放
+	const glm::mat4& getWorldMatrix(int node) const { return world_matrices[node]; }
+	const glm::mat4* getWorldMatrices() const { return world_matrices.data(); }
+
+	// 删除所有节点
+	void clear();
+
+private:
+	void markDirty(int node);
+
+	std::vector<int> parents;
+	std::vector<glm::vec3> translations;
+	std::vector<glm::vec3> rotations;
+	std::vector<glm::vec3> scales;
+	std::vector<glm::mat4> local_matrices;
+	std::vector<glm::mat4> world_matrices;
+	// local_dirty：本地变换被修改；world_dirty：update 时自己或某个祖先被修改
+	std::vector<unsigned char> local_dirty;
+	std::vector<unsigned char> world_dirty;
+	int first_dirty;	// 最靠前的被修改节点，update 从这里开始扫描，没有时等于 size()
+};
+
+#endif
@@ -1,11 +1,11 @@
 #include "Angel.h"
 #include "TriMesh.h"
 #include "Camera.h"
+#include "SceneGraph.h"
 
 #include <vector>
 #include <string>
 #include <algorithm>
-#include <assert.h>
 
 
 struct openGLObject
@@ -30,43 +30,22 @@ struct openGLObject
 	GLuint viewLocation;
 	GLuint projectionLocation;
 
-	// 阴影变量
-	GLuint shadowLocation;
+	// 光照、材质变量，绑定着色器时查询一次，绘制时不再按名字查找
+	GLuint eyePositionLocation;
+	GLuint materialAmbientLocation;
+	GLuint materialDiffuseLocation;
+	GLuint materialSpecularLocation;
+	GLuint materialShininessLocation;
+	GLuint lightAmbientLocation;
+	GLuint lightDiffuseLocation;
+	GLuint lightSpecularLocation;
+	GLuint lightPositionLocation;
 };
 
 int WIDTH = 600;
 int HEIGHT = 600;
 int mainWindow;
 
-// 矩阵堆栈，用于层级建模中的矩阵保存和恢复
-// 在遍历层级树时，进入子节点前push保存父节点矩阵，
-// 绘制完子节点及其子树后pop恢复父节点矩阵，以便绘制兄弟节点
-class MatrixStack {
-	int		_index;
-    int		_size;
-    glm::mat4*	_matrices;
-
-public:
-	MatrixStack(int numMatrices = 100):_index(0), _size(numMatrices)
-        { _matrices = new glm::mat4[numMatrices]; }
-
-    ~MatrixStack()
-		{ delete[]_matrices; }
-
-    // 将当前矩阵压入堆栈
-    void push(const glm::mat4& m){
-		assert( _index + 1 < _size );
-		_matrices[_index++] = m;	 
-    }
-
-    // 弹出栈顶矩阵
-	glm::mat4& pop(){
-        assert(_index - 1 >= 0);
-        _index--;
-        return _matrices[_index];
-    }
-};
-
 #define White	glm::vec3(1.0, 1.0, 1.0)
 #define Yellow	glm::vec3(1.0, 1.0, 0.0)
 #define Green	glm::vec3(0.0, 1.0, 0.0)
@@ -152,154 +131,134 @@ openGLObject LeftLowerLegObject;
 
 Camera* camera = new Camera();
 
+// 层级模型的场景图
+// 关节节点按 Robot 中枚举的顺序最先添加，节点编号就是 theta 的下标；
+// 父关节的枚举值总比子关节小，满足场景图父节点在前的要求
+SceneGraph scene;
+
+// 各关节的旋转轴：躯干和头部绕Y轴，手臂绕Z轴，腿绕X轴
+const glm::vec3 jointAxis[10] = {
+	glm::vec3(0.0, 1.0, 0.0), glm::vec3(0.0, 1.0, 0.0),
+	glm::vec3(0.0, 0.0, 1.0), glm::vec3(0.0, 0.0, 1.0), glm::vec3(0.0, 0.0, 1.0), glm::vec3(0.0, 0.0, 1.0),
+	glm::vec3(1.0, 0.0, 0.0), glm::vec3(1.0, 0.0, 0.0), glm::vec3(1.0, 0.0, 0.0), glm::vec3(1.0, 0.0, 0.0)
+};
+
+// 机器人的一个部件：挂在关节下面的形状节点，以及绘制它用的网格和OpenGL对象
+struct RobotPart
+{
+	int node;
+	TriMesh* mesh;
+	openGLObject* object;
+};
+std::vector<RobotPart> robotParts;
+
+// 蒙皮绘制：所有部件合并为一个网格，每个顶点带一个骨骼下标（即部件在 robotParts 中的下标），
+// 顶点着色器按骨骼矩阵变换顶点，整个机器人只需一次绘制；关闭时退回每个部件单独绘制
+// 骨骼数量上限，需与 vshader_skinned.glsl 中的 MAX_BONES 一致
+const int MAX_BONES = 16;
+bool useSkinning = true;
+
+struct SkinnedObject
+{
+	GLuint vao;
+	GLuint vbo;
+	GLuint program;
+
+	GLuint modelLocation;
+	GLuint viewLocation;
+	GLuint projectionLocation;
+	GLuint boneMatricesLocation;
+
+	int vertexCount;
+};
+SkinnedObject skinnedRobot;
+
 // 获取生成的所有模型，用于结束程序时释放内存
 std::vector<TriMesh*> meshList;
 
 // 绘制物体的通用函数
-// modelMatrix: 父节点传下来的变换矩阵（包含旋转平移）
+// modelMatrix: 场景图中缓存的世界矩阵
 // mesh: 物体的网格数据
 // object: OpenGL对象（VAO/Shader等）
-void drawMesh(glm::mat4 modelMatrix, TriMesh* mesh, openGLObject object) {
+void drawMesh(const glm::mat4& modelMatrix, TriMesh* mesh, const openGLObject& object) {
 
 	glBindVertexArray(object.vao);
 
 	glUseProgram(object.program);
  
-    // 父节点矩阵 * 本节点局部变换矩阵
     // 将模型矩阵、视图矩阵、投影矩阵传递给着色器
     glUniformMatrix4fv( object.modelLocation, 1, GL_FALSE, &modelMatrix[0][0]);
 	glUniformMatrix4fv( object.viewLocation, 1, GL_FALSE, &camera->viewMatrix[0][0]);
 	glUniformMatrix4fv( object.projectionLocation, 1, GL_FALSE, &camera->projMatrix[0][0]);
-	glUniform1f( object.shadowLocation, 0);
 	// 绘制
 	glDrawArrays(GL_TRIANGLES, 0, mesh->getPoints().size());
 }
 
-// 躯体绘制函数
-void torso(glm::mat4 modelMatrix)
-{
-	// 本节点局部变换矩阵：先平移再缩放
-    // 1. 将立方体中心移动到(0, 0.5*Height, 0)，使得底部中心位于原点
-	glm::mat4 instance = glm::mat4(1.0);
-	instance = glm::translate(instance, glm::vec3(0.0, 0.5 * robot.TORSO_HEIGHT, 0.0));
-    // 2. 缩放到指定大小
-	instance = glm::scale(instance, glm::vec3(robot.TORSO_WIDTH, robot.TORSO_HEIGHT, robot.TORSO_WIDTH));
-
-	// 乘以来自父物体的模型变换矩阵，绘制当前物体
-	drawMesh(modelMatrix * instance, Torso, TorsoObject);
-}
-
-// 头部绘制函数
-void head(glm::mat4 modelMatrix)
-{
-	// 本节点局部变换矩阵
-	glm::mat4 instance = glm::mat4(1.0);
-	instance = glm::translate(instance, glm::vec3(0.0, 0.5 * robot.HEAD_HEIGHT, 0.0));
-	instance = glm::scale(instance, glm::vec3(robot.HEAD_WIDTH, robot.HEAD_HEIGHT, robot.HEAD_WIDTH));
-
-	// 乘以来自父物体的模型变换矩阵，绘制当前物体
-	drawMesh(modelMatrix * instance, Head, HeadObject);
-}
-
-
-// 左大臂绘制函数
-void left_upper_arm(glm::mat4 modelMatrix)
-{
-    // 本节点局部变换矩阵
-    // 1. 平移：将中心移动到(0, -0.5*Height, 0)，使得顶部中心位于原点（关节位置）
-	glm::mat4 instance = glm::mat4(1.0);
-	instance = glm::translate(instance, glm::vec3(0.0, -0.5 * robot.UPPER_ARM_HEIGHT, 0.0));
-    // 2. 缩放
-	instance = glm::scale(instance, glm::vec3(robot.UPPER_ARM_WIDTH, robot.UPPER_ARM_HEIGHT, robot.UPPER_ARM_WIDTH));
-
-	// 乘以来自父物体的模型变换矩阵，绘制当前物体
-	drawMesh( modelMatrix * instance, LeftUpperArm, LeftUpperArmObject);	
-}
-
-
-// @TODO: Task-1 左小臂
-void left_lower_arm(glm::mat4 modelMatrix)
-{
-	// 本节点局部变换矩阵
-    // 顶部中心对齐关节
-	glm::mat4 instance = glm::mat4(1.0);
-	instance = glm::translate(instance, glm::vec3(0.0, -0.5 * robot.LOWER_ARM_HEIGHT, 0.0));
-	instance = glm::scale(instance, glm::vec3(robot.LOWER_ARM_WIDTH, robot.LOWER_ARM_HEIGHT, robot.LOWER_ARM_WIDTH));
-
-	// 乘以来自父物体的模型变换矩阵，绘制当前物体
-	drawMesh(modelMatrix * instance, LeftLowerArm, LeftLowerArmObject);
-}
-
-// @TODO: Task-1 右大臂
-void right_upper_arm(glm::mat4 modelMatrix)
-{
-	// 本节点局部变换矩阵
-	glm::mat4 instance = glm::mat4(1.0);
-	instance = glm::translate(instance, glm::vec3(0.0, -0.5 * robot.UPPER_ARM_HEIGHT, 0.0));
-	instance = glm::scale(instance, glm::vec3(robot.UPPER_ARM_WIDTH, robot.UPPER_ARM_HEIGHT, robot.UPPER_ARM_WIDTH));
-
-	// 乘以来自父物体的模型变换矩阵，绘制当前物体
-	drawMesh(modelMatrix * instance, RightUpperArm, RightUpperArmObject);
-}
-
-// @TODO: Task-1 右小臂
-void right_lower_arm(glm::mat4 modelMatrix)
+// 添加部件：在关节 joint 下挂一个形状节点
+// 立方体中心移动到 (0, offsetY, 0)，再缩放到 width * height * width
+// 躯干和头部 offsetY = 0.5*Height，底部中心位于关节；四肢 offsetY = -0.5*Height，顶部中心位于关节
+void addPart(int joint, float offsetY, float width, float height, TriMesh* mesh, openGLObject* object)
 {
-	// 本节点局部变换矩阵
-	glm::mat4 instance = glm::mat4(1.0);
-	instance = glm::translate(instance, glm::vec3(0.0, -0.5 * robot.LOWER_ARM_HEIGHT, 0.0));
-	instance = glm::scale(instance, glm::vec3(robot.LOWER_ARM_WIDTH, robot.LOWER_ARM_HEIGHT, robot.LOWER_ARM_WIDTH));
-
-	// 乘以来自父物体的模型变换矩阵，绘制当前物体
-	drawMesh(modelMatrix * instance, RightLowerArm, RightLowerArmObject);
-}
-
-// @TODO: Task-1 左大腿
-void left_upper_leg(glm::mat4 modelMatrix)
-{
-	// 本节点局部变换矩阵
-	glm::mat4 instance = glm::mat4(1.0);
-	instance = glm::translate(instance, glm::vec3(0.0, -0.5 * robot.UPPER_LEG_HEIGHT, 0.0));
-	instance = glm::scale(instance, glm::vec3(robot.UPPER_LEG_WIDTH, robot.UPPER_LEG_HEIGHT, robot.UPPER_LEG_WIDTH));
-
-	// 乘以来自父物体的模型变换矩阵，绘制当前物体
-	drawMesh(modelMatrix * instance, LeftUpperLeg, LeftUpperLegObject);
+	RobotPart part;
+	part.node = scene.addNode(joint, glm::vec3(0.0, offsetY, 0.0), glm::vec3(0.0), glm::vec3(width, height, width));
+	part.mesh = mesh;
+	part.object = object;
+	robotParts.push_back(part);
 }
 
-// @TODO: Task-1 左小腿
-void left_lower_leg(glm::mat4 modelMatrix)
-{
-	// 本节点局部变换矩阵
-	glm::mat4 instance = glm::mat4(1.0);
-	instance = glm::translate(instance, glm::vec3(0.0, -0.5 * robot.LOWER_LEG_HEIGHT, 0.0));
-	instance = glm::scale(instance, glm::vec3(robot.LOWER_LEG_WIDTH, robot.LOWER_LEG_HEIGHT, robot.LOWER_LEG_WIDTH));
+// 蒙皮绘制整个机器人：一次上传所有骨骼矩阵，一次绘制
+// modelMatrix 为整个机器人的变换，绘制多个机器人时每个只需改这一个矩阵
+void drawSkinned(const glm::mat4& modelMatrix, const SkinnedObject& object) {
 
-	// 乘以来自父物体的模型变换矩阵，绘制当前物体
-	drawMesh(modelMatrix * instance, LeftLowerLeg, LeftLowerLegObject);
-}
+	glm::mat4 bones[MAX_BONES];
+	const glm::mat4* world = scene.getWorldMatrices();
+	int count = std::min((int)robotParts.size(), MAX_BONES);
+	for (int i = 0; i < count; i++)
+		bones[i] = world[robotParts[i].node];
 
-// @TODO: Task-1 右大腿
-void right_upper_leg(glm::mat4 modelMatrix)
-{
-	// 本节点局部变换矩阵
-	glm::mat4 instance = glm::mat4(1.0);
-	instance = glm::translate(instance, glm::vec3(0.0, -0.5 * robot.UPPER_LEG_HEIGHT, 0.0));
-	instance = glm::scale(instance, glm::vec3(robot.UPPER_LEG_WIDTH, robot.UPPER_LEG_HEIGHT, robot.UPPER_LEG_WIDTH));
+	glBindVertexArray(object.vao);
+	glUseProgram(object.program);
 
-	// 乘以来自父物体的模型变换矩阵，绘制当前物体
-	drawMesh(modelMatrix * instance, RightUpperLeg, RightUpperLegObject);
+	glUniformMatrix4fv(object.boneMatricesLocation, count, GL_FALSE, &bones[0][0][0]);
+	glUniformMatrix4fv(object.modelLocation, 1, GL_FALSE, &modelMatrix[0][0]);
+	glUniformMatrix4fv(object.viewLocation, 1, GL_FALSE, &camera->viewMatrix[0][0]);
+	glUniformMatrix4fv(object.projectionLocation, 1, GL_FALSE, &camera->projMatrix[0][0]);
+	glDrawArrays(GL_TRIANGLES, 0, object.vertexCount);
 }
 
-// @TODO: Task-1 右小腿
-void right_lower_leg(glm::mat4 modelMatrix)
+// 建立机器人的场景图，只在初始化时调用一次
+void buildRobot()
 {
-	// 本节点局部变换矩阵
-	glm::mat4 instance = glm::mat4(1.0);
-	instance = glm::translate(instance, glm::vec3(0.0, -0.5 * robot.LOWER_LEG_HEIGHT, 0.0));
-	instance = glm::scale(instance, glm::vec3(robot.LOWER_LEG_WIDTH, robot.LOWER_LEG_HEIGHT, robot.LOWER_LEG_WIDTH));
-
-	// 乘以来自父物体的模型变换矩阵，绘制当前物体
-	drawMesh(modelMatrix * instance, RightLowerLeg, RightLowerLegObject);
+	const int root = SceneGraph::NO_PARENT;
+
+	// 1. 关节节点，平移为关节相对父关节的位置
+	// 躯干是根节点；头部位于躯干顶部
+	scene.addNode(root);
+	scene.addNode(robot.Torso, glm::vec3(0.0, robot.TORSO_HEIGHT, 0.0));
+	// 右臂：大臂在躯干右上角，小臂在大臂底部
+	scene.addNode(robot.Torso, glm::vec3(0.5 * robot.TORSO_WIDTH + 0.5 * robot.UPPER_ARM_WIDTH, robot.TORSO_HEIGHT, 0.0));
+	scene.addNode(robot.RightUpperArm, glm::vec3(0.0, -robot.UPPER_ARM_HEIGHT, 0.0));
+	// 左臂
+	scene.addNode(robot.Torso, glm::vec3(-0.5 * robot.TORSO_WIDTH - 0.5 * robot.UPPER_ARM_WIDTH, robot.TORSO_HEIGHT, 0.0));
+	scene.addNode(robot.LeftUpperArm, glm::vec3(0.0, -robot.UPPER_ARM_HEIGHT, 0.0));
+	// 右腿：大腿在躯干右下角，小腿在大腿底部
+	scene.addNode(robot.Torso, glm::vec3(0.5 * robot.TORSO_WIDTH - 0.5 * robot.UPPER_LEG_WIDTH, 0.0, 0.0));
+	scene.addNode(robot.RightUpperLeg, glm::vec3(0.0, -robot.UPPER_LEG_HEIGHT, 0.0));
+	// 左腿
+	scene.addNode(robot.Torso, glm::vec3(-0.5 * robot.TORSO_WIDTH + 0.5 * robot.UPPER_LEG_WIDTH, 0.0, 0.0));
+	scene.addNode(robot.LeftUpperLeg, glm::vec3(0.0, -robot.UPPER_LEG_HEIGHT, 0.0));
+
+	// 2. 各部件的形状节点
+	addPart(robot.Torso, 0.5 * robot.TORSO_HEIGHT, robot.TORSO_WIDTH, robot.TORSO_HEIGHT, Torso, &TorsoObject);
+	addPart(robot.Head, 0.5 * robot.HEAD_HEIGHT, robot.HEAD_WIDTH, robot.HEAD_HEIGHT, Head, &HeadObject);
+	addPart(robot.RightUpperArm, -0.5 * robot.UPPER_ARM_HEIGHT, robot.UPPER_ARM_WIDTH, robot.UPPER_ARM_HEIGHT, RightUpperArm, &RightUpperArmObject);
+	addPart(robot.RightLowerArm, -0.5 * robot.LOWER_ARM_HEIGHT, robot.LOWER_ARM_WIDTH, robot.LOWER_ARM_HEIGHT, RightLowerArm, &RightLowerArmObject);
+	addPart(robot.LeftUpperArm, -0.5 * robot.UPPER_ARM_HEIGHT, robot.UPPER_ARM_WIDTH, robot.UPPER_ARM_HEIGHT, LeftUpperArm, &LeftUpperArmObject);
+	addPart(robot.LeftLowerArm, -0.5 * robot.LOWER_ARM_HEIGHT, robot.LOWER_ARM_WIDTH, robot.LOWER_ARM_HEIGHT, LeftLowerArm, &LeftLowerArmObject);
+	addPart(robot.RightUpperLeg, -0.5 * robot.UPPER_LEG_HEIGHT, robot.UPPER_LEG_WIDTH, robot.UPPER_LEG_HEIGHT, RightUpperLeg, &RightUpperLegObject);
+	addPart(robot.RightLowerLeg, -0.5 * robot.LOWER_LEG_HEIGHT, robot.LOWER_LEG_WIDTH, robot.LOWER_LEG_HEIGHT, RightLowerLeg, &RightLowerLegObject);
+	addPart(robot.LeftUpperLeg, -0.5 * robot.UPPER_LEG_HEIGHT, robot.UPPER_LEG_WIDTH, robot.UPPER_LEG_HEIGHT, LeftUpperLeg, &LeftUpperLegObject);
+	addPart(robot.LeftLowerLeg, -0.5 * robot.LOWER_LEG_HEIGHT, robot.LOWER_LEG_WIDTH, robot.LOWER_LEG_HEIGHT, LeftLowerLeg, &LeftLowerLegObject);
 }
 
 
@@ -347,24 +306,90 @@ void bindObjectAndData(TriMesh* mesh, openGLObject& object, const std::string &v
 	object.modelLocation = glGetUniformLocation(object.program, "model");
 	object.viewLocation = glGetUniformLocation(object.program, "view");
 	object.projectionLocation = glGetUniformLocation(object.program, "projection");
-	object.shadowLocation = glGetUniformLocation(object.program, "isShadow");
+
+	object.eyePositionLocation = glGetUniformLocation(object.program, "eye_position");
+	object.materialAmbientLocation = glGetUniformLocation(object.program, "material.ambient");
+	object.materialDiffuseLocation = glGetUniformLocation(object.program, "material.diffuse");
+	object.materialSpecularLocation = glGetUniformLocation(object.program, "material.specular");
+	object.materialShininessLocation = glGetUniformLocation(object.program, "material.shininess");
+	object.lightAmbientLocation = glGetUniformLocation(object.program, "light.ambient");
+	object.lightDiffuseLocation = glGetUniformLocation(object.program, "light.diffuse");
+	object.lightSpecularLocation = glGetUniformLocation(object.program, "light.specular");
+	object.lightPositionLocation = glGetUniformLocation(object.program, "light.position");
+}
+
+
+// 把所有部件的顶点合并到一个 VBO 中：坐标 | 颜色 | 法向量 | 骨骼下标
+// 部件网格仍在自身的物体坐标系中，骨骼矩阵就是部件形状节点的世界矩阵
+void bindSkinnedObject(SkinnedObject& object, const std::string &vshader, const std::string &fshader) {
+
+	if (robotParts.size() > MAX_BONES)
+		std::cerr << "Too many robot parts for skinning: " << robotParts.size() << " > " << MAX_BONES << std::endl;
+
+	std::vector<glm::vec3> points, colors, normals;
+	std::vector<GLfloat> bones;
+	for (int i = 0; i < robotParts.size() && i < MAX_BONES; i++) {
+		TriMesh* mesh = robotParts[i].mesh;
+		points.insert(points.end(), mesh->getPoints().begin(), mesh->getPoints().end());
+		colors.insert(colors.end(), mesh->getColors().begin(), mesh->getColors().end());
+		normals.insert(normals.end(), mesh->getNormals().begin(), mesh->getNormals().end());
+		bones.insert(bones.end(), mesh->getPoints().size(), (GLfloat)i);
+	}
+	object.vertexCount = points.size();
+
+	size_t vec3Size = points.size() * sizeof(glm::vec3);
+
+	glGenVertexArrays(1, &object.vao);
+	glBindVertexArray(object.vao);
+
+	glGenBuffers(1, &object.vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, object.vbo);
+	glBufferData(GL_ARRAY_BUFFER, 3 * vec3Size + bones.size() * sizeof(GLfloat), NULL, GL_STATIC_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, vec3Size, &points[0]);
+	glBufferSubData(GL_ARRAY_BUFFER, vec3Size, vec3Size, &colors[0]);
+	glBufferSubData(GL_ARRAY_BUFFER, 2 * vec3Size, vec3Size, &normals[0]);
+	glBufferSubData(GL_ARRAY_BUFFER, 3 * vec3Size, bones.size() * sizeof(GLfloat), &bones[0]);
+
+	object.program = InitShader(vshader.c_str(), fshader.c_str());
+
+	GLuint location = glGetAttribLocation(object.program, "vPosition");
+	glEnableVertexAttribArray(location);
+	glVertexAttribPointer(location, 3, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(0));
+
+	location = glGetAttribLocation(object.program, "vColor");
+	glEnableVertexAttribArray(location);
+	glVertexAttribPointer(location, 3, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(vec3Size));
+
+	location = glGetAttribLocation(object.program, "vNormal");
+	glEnableVertexAttribArray(location);
+	glVertexAttribPointer(location, 3, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(2 * vec3Size));
+
+	// 骨骼下标以浮点数传入，着色器中取整
+	location = glGetAttribLocation(object.program, "vBone");
+	glEnableVertexAttribArray(location);
+	glVertexAttribPointer(location, 1, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(3 * vec3Size));
+
+	object.modelLocation = glGetUniformLocation(object.program, "model");
+	object.viewLocation = glGetUniformLocation(object.program, "view");
+	object.projectionLocation = glGetUniformLocation(object.program, "projection");
+	object.boneMatricesLocation = glGetUniformLocation(object.program, "boneMatrices");
 }
 
 
 void bindLightAndMaterial(TriMesh* mesh, openGLObject& object, Light* light, Camera* camera) {
 
 	// 传递相机的位置
-	glUniform3fv(glGetUniformLocation(object.program, "eye_position"), 1, &camera->eye[0]);
+	glUniform3fv(object.eyePositionLocation, 1, &camera->eye[0]);
 
 	// 传递物体的材质
 	glm::vec4 meshAmbient = mesh->getAmbient();
 	glm::vec4 meshDiffuse = mesh->getDiffuse();
 	glm::vec4 meshSpecular = mesh->getSpecular();
 	float meshShininess = mesh->getShininess();
-	glUniform4fv(glGetUniformLocation(object.program, "material.ambient"), 1, &meshAmbient[0]);
-	glUniform4fv(glGetUniformLocation(object.program, "material.diffuse"), 1, &meshDiffuse[0]);
-	glUniform4fv(glGetUniformLocation(object.program, "material.specular"), 1, &meshSpecular[0]);
-	glUniform1f(glGetUniformLocation(object.program, "material.shininess"), meshShininess);
+	glUniform4fv(object.materialAmbientLocation, 1, &meshAmbient[0]);
+	glUniform4fv(object.materialDiffuseLocation, 1, &meshDiffuse[0]);
+	glUniform4fv(object.materialSpecularLocation, 1, &meshSpecular[0]);
+	glUniform1f(object.materialShininessLocation, meshShininess);
 
 	// 传递光源信息
 	glm::vec4 lightAmbient = light->getAmbient();
@@ -372,10 +397,10 @@ void bindLightAndMaterial(TriMesh* mesh, openGLObject& object, Light* light, Cam
 	glm::vec4 lightSpecular = light->getSpecular();
 	glm::vec3 lightPosition = light->getTranslation();
 
-	glUniform4fv(glGetUniformLocation(object.program, "light.ambient"), 1, &lightAmbient[0]);
-	glUniform4fv(glGetUniformLocation(object.program, "light.diffuse"), 1, &lightDiffuse[0]);
-	glUniform4fv(glGetUniformLocation(object.program, "light.specular"), 1, &lightSpecular[0]);
-	glUniform3fv(glGetUniformLocation(object.program, "light.position"), 1, &lightPosition[0]);
+	glUniform4fv(object.lightAmbientLocation, 1, &lightAmbient[0]);
+	glUniform4fv(object.lightDiffuseLocation, 1, &lightDiffuse[0]);
+	glUniform4fv(object.lightSpecularLocation, 1, &lightSpecular[0]);
+	glUniform3fv(object.lightPositionLocation, 1, &lightPosition[0]);
 
 }
 
@@ -413,6 +438,9 @@ void init()
 	bindObjectAndData(RightLowerLeg, RightLowerLegObject, vshader, fshader);
 	bindObjectAndData(LeftLowerLeg, LeftLowerLegObject, vshader, fshader);	
 	
+	buildRobot();
+	bindSkinnedObject(skinnedRobot, "shaders/vshader_skinned.glsl", fshader);
+
 	glClearColor(1.0, 1.0, 1.0, 1.0);
 }
 
@@ -428,111 +456,22 @@ void display()
 	camera->projMatrix = camera->getProjectionMatrix(false);
 
 
-	// 物体的变换矩阵，初始化为单位矩阵
-	glm::mat4 modelMatrix = glm::mat4(1.0);
-
-	// 保持变换矩阵的栈，用于层级遍历
-	MatrixStack mstack;
-
-    // 1. 绘制躯干（Root Node）
-    // 躯干作为根节点，只进行自身的旋转（Y轴）
-    // （这里我们希望机器人的躯干只绕Y轴旋转，所以只计算了RotateY）
-	modelMatrix = glm::translate(modelMatrix, glm::vec3(0.0, 0.0, 0.0));
-	modelMatrix = glm::rotate(modelMatrix, glm::radians(robot.theta[robot.Torso]), glm::vec3(0.0, 1.0, 0.0));
-	torso(modelMatrix);
-
-    // 保存躯干变换矩阵，准备绘制子节点（头部、四肢）
-	mstack.push(modelMatrix); 
-    
-    // 2. 绘制头部（Child of Torso）
-    // 头部相对于躯干顶部位置(0, TORSO_HEIGHT, 0)
-    // （这里我们希望机器人的头部只绕Y轴旋转，所以只计算了RotateY）
-	modelMatrix = glm::translate(modelMatrix, glm::vec3(0.0, robot.TORSO_HEIGHT, 0.0));
-	modelMatrix = glm::rotate(modelMatrix, glm::radians(robot.theta[robot.Head]), glm::vec3(0.0, 1.0, 0.0));
-	head(modelMatrix);
-    
-    // 恢复躯干变换矩阵，准备绘制下一个兄弟节点（左臂）
-	modelMatrix = mstack.pop(); 
-
-
-    // =========== 3. 绘制左臂 (Child of Torso) ===========
-	mstack.push(modelMatrix);   // 保存躯干变换矩阵
-    
-    // 3.1 左大臂
-    // 相对于躯干左上角位置
-    // 左大臂（这里我们希望机器人的左大臂只绕Z轴旋转，所以只计算了RotateZ，后面同理）
-	modelMatrix = glm::translate(modelMatrix, glm::vec3(-0.5 * robot.TORSO_WIDTH - 0.5 * robot.UPPER_ARM_WIDTH, robot.TORSO_HEIGHT, 0.0));
-	modelMatrix = glm::rotate(modelMatrix, glm::radians(robot.theta[robot.LeftUpperArm]), glm::vec3(0.0, 0.0, 1.0));
-	left_upper_arm(modelMatrix);
-
-    // @TODO: Task-2 左小臂
-    // 3.2 左小臂 (Child of LeftUpperArm)
-    // 相对于左大臂底部位置(0, -UPPER_ARM_HEIGHT, 0)
-    // 注意：这里没有push/pop，因为小臂是大臂的子节点，需要继承大臂的变换
-	modelMatrix = glm::translate(modelMatrix, glm::vec3(0.0, -robot.UPPER_ARM_HEIGHT, 0.0));
-	modelMatrix = glm::rotate(modelMatrix, glm::radians(robot.theta[robot.LeftLowerArm]), glm::vec3(0.0, 0.0, 1.0));
-	left_lower_arm(modelMatrix);
-	
-	modelMatrix = mstack.pop(); // 恢复躯干变换矩阵，准备绘制右臂
-
-    // =========== 4. 绘制右臂 (Child of Torso) ===========
-	mstack.push(modelMatrix);   // 保存躯干变换矩阵
-    
-	// @TODO: Task-2 右大臂
-    // 4.1 右大臂
-    // 相对于躯干右上角位置
-	modelMatrix = glm::translate(modelMatrix, glm::vec3(0.5 * robot.TORSO_WIDTH + 0.5 * robot.UPPER_ARM_WIDTH, robot.TORSO_HEIGHT, 0.0));
-	modelMatrix = glm::rotate(modelMatrix, glm::radians(robot.theta[robot.RightUpperArm]), glm::vec3(0.0, 0.0, 1.0));
-	right_upper_arm(modelMatrix);
-
-    // @TODO: Task-2 右小臂
-    // 4.2 右小臂 (Child of RightUpperArm)
-    // 相对于右大臂底部位置
-	modelMatrix = glm::translate(modelMatrix, glm::vec3(0.0, -robot.UPPER_ARM_HEIGHT, 0.0));
-	modelMatrix = glm::rotate(modelMatrix, glm::radians(robot.theta[robot.RightLowerArm]), glm::vec3(0.0, 0.0, 1.0));
-	right_lower_arm(modelMatrix);
-
-	modelMatrix = mstack.pop(); // 恢复躯干变换矩阵，准备绘制左腿
-
-    // =========== 5. 绘制左腿 (Child of Torso) ===========
-	mstack.push(modelMatrix);   // 保存躯干变换矩阵
-    
-    // @TODO: Task-2 左大腿
-    // 5.1 左大腿
-    // 相对于躯干左下角位置
-	modelMatrix = glm::translate(modelMatrix, glm::vec3(-0.5 * robot.TORSO_WIDTH + 0.5 * robot.UPPER_LEG_WIDTH, 0.0, 0.0));
-	modelMatrix = glm::rotate(modelMatrix, glm::radians(robot.theta[robot.LeftUpperLeg]), glm::vec3(1.0, 0.0, 0.0));
-	left_upper_leg(modelMatrix);
-
-	// @TODO: Task-2 左小腿
-    // 5.2 左小腿 (Child of LeftUpperLeg)
-    // 相对于左大腿底部位置
-	modelMatrix = glm::translate(modelMatrix, glm::vec3(0.0, -robot.UPPER_LEG_HEIGHT, 0.0));
-	modelMatrix = glm::rotate(modelMatrix, glm::radians(robot.theta[robot.LeftLowerLeg]), glm::vec3(1.0, 0.0, 0.0));
-	left_lower_leg(modelMatrix);
-
-	modelMatrix = mstack.pop(); // 恢复躯干变换矩阵，准备绘制右腿
-
-    // =========== 6. 绘制右腿 (Child of Torso) ===========
-	mstack.push(modelMatrix);   // 保存躯干变换矩阵
-    
-    // @TODO: Task-2 右大腿
-    // 6.1 右大腿
-    // 相对于躯干右下角位置
-	modelMatrix = glm::translate(modelMatrix, glm::vec3(0.5 * robot.TORSO_WIDTH - 0.5 * robot.UPPER_LEG_WIDTH, 0.0, 0.0));
-	modelMatrix = glm::rotate(modelMatrix, glm::radians(robot.theta[robot.RightUpperLeg]), glm::vec3(1.0, 0.0, 0.0));
-	right_upper_leg(modelMatrix);
-
-    // @TODO: Task-2 右小腿
-    // 6.2 右小腿 (Child of RightUpperLeg)
-    // 相对于右大腿底部位置
-	modelMatrix = glm::translate(modelMatrix, glm::vec3(0.0, -robot.UPPER_LEG_HEIGHT, 0.0));
-	modelMatrix = glm::rotate(modelMatrix, glm::radians(robot.theta[robot.RightLowerLeg]), glm::vec3(1.0, 0.0, 0.0));
-	right_lower_leg(modelMatrix);
-
-	modelMatrix = mstack.pop(); // 恢复躯干变换矩阵（其实这里可以不pop，因为已经是最后一个了，但为了对称性建议pop）
-
+	// 把关节角写入场景图，角度没有变化的关节不会被标记
+	for (int i = 0; i < 10; i++)
+		scene.setRotation(i, robot.theta[i] * jointAxis[i]);
+	// 只重新计算被修改的关节及其子树的世界矩阵
+	scene.update();
 
+	if (useSkinning) {
+		// 整个机器人一次绘制
+		drawSkinned(glm::mat4(1.0), skinnedRobot);
+	}
+	else {
+		// 世界矩阵连续存放，按部件顺序逐个绘制
+		const glm::mat4* world = scene.getWorldMatrices();
+		for (int i = 0; i < robotParts.size(); i++)
+			drawMesh(world[robotParts[i].node], robotParts[i].mesh, *robotParts[i].object);
+	}
 }
 
 
@@ -561,6 +500,7 @@ void printHelp()
 		"[Model]" << std::endl <<
 		"a/A:	Increase rotate angle" << std::endl <<
 		"s/S:	Decrease rotate angle" << std::endl <<
+		"k/K:	Toggle GPU skinning (one draw call)" << std::endl <<
 
 		std::endl <<
 		"[Camera]" << std::endl <<
@@ -603,6 +543,10 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
 			if (robot.theta[Selected_mesh] < 0.0)
 				robot.theta[Selected_mesh] += 360.0;
 			break;
+		case GLFW_KEY_K:
+			useSkinning = !useSkinning;
+			std::cout << "GPU skinning: " << (useSkinning ? "on, 1 draw call" : "off, 1 draw call per part") << std::endl;
+			break;
 		default:
 			camera->keyboard(key, action, mode);
 			break;
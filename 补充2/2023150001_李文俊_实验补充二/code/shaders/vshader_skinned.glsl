@@ -0,0 +1,35 @@
+#version 330 core
+
+// 蒙皮顶点着色器：整个机器人合并为一个网格，一次绘制
+// 每个部件都是刚体，顶点只属于一根骨骼，不需要权重
+in vec3 vPosition;
+in vec3 vColor;
+in vec3 vNormal;
+in float vBone;
+
+// 传给片元着色器的变量，与 vshader.glsl 相同
+out vec3 position;
+out vec3 normal;
+out vec3 color;
+
+// 骨骼数量上限，需与 main.cpp 中的 MAX_BONES 一致
+const int MAX_BONES = 16;
+
+// 每根骨骼（部件）的世界矩阵，由场景图给出
+uniform mat4 boneMatrices[MAX_BONES];
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+void main() 
+{
+	mat4 skin = model * boneMatrices[int(vBone + 0.5)];
+
+	vec4 v1 = skin * vec4(vPosition, 1.0);
+	vec4 v2 = vec4(v1.xyz / v1.w, 1.0);
+	gl_Position = projection * view * v2;
+
+    position = vec3(v2.xyz);
+    normal = vec3( skin * vec4(vNormal, 0.0) );
+    color = vColor;
+}